@@ -0,0 +1,95 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+// Throughput of the raw imu count conversion for offline replay of long logs.
+// Compares the per axis double divide used by ParseImu with the batch
+// conversion in svis/imu_convert.h.
+//
+// usage: imu_convert_bench [sample_count] [repeat_count]
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "svis/imu_convert.h"
+#include "svis/imu_packet.h"
+
+namespace {
+
+double Seconds(std::chrono::high_resolution_clock::time_point t0) {
+  std::chrono::duration<double> d = std::chrono::high_resolution_clock::now() - t0;
+  return d.count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::size_t sample_count = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  int repeat_count = (argc > 2) ? std::atoi(argv[2]) : 20;
+
+  const double g = 9.80665;
+  const double rad_per_deg = 0.0174533;
+  const double gyro_sens_arr[4] = {131, 65.5, 32.8, 16.4};
+  const double acc_sens_arr[4] = {16384, 8192, 4096, 2048};
+  const int acc_sens = 1;
+  const int gyro_sens = 1;
+
+  // synthetic raw log
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> dist(-32768, 32767);
+  std::vector<svis::ImuPacket> packets(sample_count);
+  svis::ImuBatch batch;
+  batch.Resize(sample_count);
+  for (std::size_t i = 0; i < sample_count; i++) {
+    packets[i].timestamp_teensy_raw = static_cast<uint32_t>(i * 1000);
+    batch.timestamp_teensy_raw[i] = packets[i].timestamp_teensy_raw;
+    for (int j = 0; j < 3; j++) {
+      packets[i].acc_raw[j] = batch.acc_raw[j][i] = static_cast<int16_t>(dist(gen));
+      packets[i].gyro_raw[j] = batch.gyro_raw[j][i] = static_cast<int16_t>(dist(gen));
+    }
+  }
+
+  // per sample, per axis double divide
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < repeat_count; r++) {
+    for (std::size_t i = 0; i < sample_count; i++) {
+      svis::ImuPacket& imu = packets[i];
+      for (int j = 0; j < 3; j++) {
+        imu.acc[j] = static_cast<float>(imu.acc_raw[j]) / acc_sens_arr[acc_sens] * g;
+        imu.gyro[j] = static_cast<float>(imu.gyro_raw[j]) / gyro_sens_arr[gyro_sens] * rad_per_deg;
+      }
+    }
+  }
+  double t_scalar = Seconds(t0);
+
+  // batch with reciprocal scales
+  float acc_scale = svis::AccScale(acc_sens);
+  float gyro_scale = svis::GyroScale(gyro_sens);
+  t0 = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < repeat_count; r++) {
+    svis::ConvertImuBatch(acc_scale, gyro_scale, &batch);
+  }
+  double t_batch = Seconds(t0);
+
+  // check agreement
+  double err_max = 0.0;
+  for (std::size_t i = 0; i < sample_count; i++) {
+    for (int j = 0; j < 3; j++) {
+      err_max = std::max(err_max, std::abs(static_cast<double>(packets[i].acc[j] - batch.acc[j][i])));
+      err_max = std::max(err_max, std::abs(static_cast<double>(packets[i].gyro[j] - batch.gyro[j][i])));
+    }
+  }
+
+  double total = static_cast<double>(sample_count) * repeat_count;
+  printf("samples: %lu x %i\n", sample_count, repeat_count);
+  printf("per axis divide: %8.1f Msamples/s\n", total / t_scalar / 1.0e6);
+  printf("batch (%s): %8.1f Msamples/s\n", svis::ConvertCountsPath(), total / t_batch / 1.0e6);
+  printf("max abs difference: %g\n", err_max);
+
+  return 0;
+}
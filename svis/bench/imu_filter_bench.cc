@@ -0,0 +1,145 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+// Throughput and aliasing of the imu decimation modes selected by
+// imu_filter_mode: box averaging (FilterImu), plain decimation (DecimateImu)
+// and the anti-aliasing FIR in svis/imu_decimator.h.  Aliasing is the gain of
+// a tone just above the output nyquist, which folds into the output band.
+//
+// usage: imu_filter_bench [ratio] [taps] [sample_count]
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "svis/imu_decimator.h"
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+const int kAxes = svis::ImuDecimator::kAxes;
+
+double Seconds(std::chrono::high_resolution_clock::time_point t0) {
+  std::chrono::duration<double> d = std::chrono::high_resolution_clock::now() - t0;
+  return d.count();
+}
+
+// sinusoid on every axis, interleaved as [ax, ay, az, gx, gy, gz]
+std::vector<float> Tone(double freq, double rate, std::size_t sample_count) {
+  std::vector<float> x(sample_count * kAxes);
+  for (std::size_t i = 0; i < sample_count; i++) {
+    for (int j = 0; j < kAxes; j++) {
+      x[i * kAxes + j] = static_cast<float>(std::sin(2.0 * pi * freq * i / rate + j));
+    }
+  }
+  return x;
+}
+
+// same as FilterImu, mean of each block of ratio samples
+void Box(const std::vector<float>& x, int ratio, std::vector<float>* y) {
+  std::size_t n = x.size() / kAxes;
+  double inv_ratio = 1.0 / ratio;
+  y->clear();
+  for (std::size_t i = 0; i + ratio <= n; i += ratio) {
+    for (int j = 0; j < kAxes; j++) {
+      double mean = 0.0;
+      for (int k = 0; k < ratio; k++) {
+        mean += x[(i + k) * kAxes + j] * inv_ratio;
+      }
+      y->push_back(static_cast<float>(mean));
+    }
+  }
+}
+
+// same as DecimateImu, first sample of each block
+void Decimate(const std::vector<float>& x, int ratio, std::vector<float>* y) {
+  std::size_t n = x.size() / kAxes;
+  y->clear();
+  for (std::size_t i = 0; i + ratio <= n; i += ratio) {
+    for (int j = 0; j < kAxes; j++) {
+      y->push_back(x[i * kAxes + j]);
+    }
+  }
+}
+
+void Fir(const std::vector<float>& x, svis::ImuDecimator* decimator, std::vector<float>* y) {
+  std::size_t n = x.size() / kAxes;
+  y->clear();
+  decimator->Reset();
+  float out[kAxes];
+  uint64_t stamp = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    if (decimator->Push(i * 1000, &x[i * kAxes], &stamp, out)) {
+      y->insert(y->end(), out, out + kAxes);
+    }
+  }
+}
+
+// peak output amplitude after the first tenth to skip the fir warm up
+double Peak(const std::vector<float>& y) {
+  double peak = 0.0;
+  for (std::size_t i = y.size() / 10; i < y.size(); i++) {
+    peak = std::max(peak, std::abs(static_cast<double>(y[i])));
+  }
+  return peak;
+}
+
+double Db(double gain) {
+  return 20.0 * std::log10(std::max(gain, 1.0e-12));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int ratio = (argc > 1) ? std::atoi(argv[1]) : 5;
+  int taps = (argc > 2) ? std::atoi(argv[2]) : 63;
+  std::size_t sample_count = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 1000000;
+
+  const double rate = 1000.0;  // [Hz]
+  double nyquist_out = 0.5 * rate / ratio;
+
+  svis::ImuDecimator decimator;
+  decimator.Configure(ratio, 0.8 * nyquist_out / rate, taps);
+
+  // throughput on a broadband signal
+  std::vector<float> x = Tone(0.37 * rate, rate, sample_count);
+  std::vector<float> y;
+  y.reserve(x.size());
+
+  auto t0 = std::chrono::high_resolution_clock::now();
+  Box(x, ratio, &y);
+  double t_box = Seconds(t0);
+
+  t0 = std::chrono::high_resolution_clock::now();
+  Decimate(x, ratio, &y);
+  double t_decimate = Seconds(t0);
+
+  t0 = std::chrono::high_resolution_clock::now();
+  Fir(x, &decimator, &y);
+  double t_fir = Seconds(t0);
+
+  printf("ratio: %i, taps: %i, samples: %lu\n", ratio, taps, sample_count);
+  printf("box:      %8.1f Msamples/s\n", sample_count / t_box / 1.0e6);
+  printf("decimate: %8.1f Msamples/s\n", sample_count / t_decimate / 1.0e6);
+  printf("fir:      %8.1f Msamples/s\n", sample_count / t_fir / 1.0e6);
+
+  // gain of tones in and above the output band
+  const double freqs[4] = {0.25 * nyquist_out, 0.75 * nyquist_out, 1.25 * nyquist_out, 2.5 * nyquist_out};
+  printf("\n%10s %10s %10s %10s\n", "freq [Hz]", "box [dB]", "dec [dB]", "fir [dB]");
+  for (int f = 0; f < 4; f++) {
+    x = Tone(freqs[f], rate, 20000);
+    Box(x, ratio, &y);
+    double g_box = Peak(y);
+    Decimate(x, ratio, &y);
+    double g_decimate = Peak(y);
+    Fir(x, &decimator, &y);
+    double g_fir = Peak(y);
+    printf("%10.1f %10.1f %10.1f %10.1f\n", freqs[f], Db(g_box), Db(g_decimate), Db(g_fir));
+  }
+
+  return 0;
+}
@@ -0,0 +1,45 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include <cstddef>
+
+namespace svis {
+
+// fill and loss counters for one buffer, cumulative since Open()
+struct BufferStat {
+  std::size_t size = 0;
+  std::size_t capacity = 0;
+  std::size_t high_water = 0;  // largest size seen
+  uint64_t overflow_count = 0;  // entries lost to a full buffer or camera ingest queue
+  uint64_t stale_count = 0;  // entries dropped unmatched after stale_timeout
+
+  void Update(std::size_t new_size, std::size_t new_capacity) {
+    size = new_size;
+    capacity = new_capacity;
+    if (size > high_water) {
+      high_water = size;
+    }
+  }
+};
+
+struct BufferStats {
+  BufferStat imu;
+  BufferStat strobe;
+  BufferStat camera;
+
+  // teensy rings from its status reports, size is not reported
+  BufferStat teensy_imu;
+  BufferStat teensy_strobe;
+  uint64_t teensy_sof_overflow_count = 0;  // usb start of frame pairs lost
+  uint64_t teensy_send_errors = 0;  // reports the teensy dropped without a usb host
+  uint64_t teensy_journal_drops = 0;  // data reports the teensy journal could not keep
+
+  // reports lost on the way to the host and replayed from the teensy journal
+  uint64_t backfill_requested = 0;
+  uint64_t backfill_count = 0;
+};
+
+}  // namespace svis
@@ -2,7 +2,11 @@
 
 #pragma once
 
+#include <stdint.h>
+
+#include <array>
 #include <string>
+#include <vector>
 
 #include "svis/header.h"
 
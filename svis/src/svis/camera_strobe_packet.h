@@ -3,6 +3,7 @@
 #pragma once
 
 #include "svis/camera_packet.h"
+#include "svis/imu_preintegration.h"
 #include "svis/strobe_packet.h"
 
 namespace svis {
@@ -10,6 +11,7 @@ namespace svis {
 struct CameraStrobePacket {
   CameraPacket camera;
   StrobePacket strobe;
+  PreintegratedImu imu;  // since the previous frame, if preintegrate_imu_ is set
 };
 
 }  // namespace svis_ros
@@ -0,0 +1,278 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+#include "svis/clock_estimator.h"
+
+namespace svis {
+
+namespace {
+
+// least squares line y = a + b*x over the points selected by keep
+bool FitLine(const std::vector<double>& x, const std::vector<double>& y,
+             const std::vector<bool>& keep, double* a, double* b) {
+  double n = 0.0;
+  double sx = 0.0;
+  double sy = 0.0;
+  double sxx = 0.0;
+  double sxy = 0.0;
+  for (std::size_t i = 0; i < x.size(); i++) {
+    if (!keep[i]) {
+      continue;
+    }
+    n += 1.0;
+    sx += x[i];
+    sy += y[i];
+    sxx += x[i] * x[i];
+    sxy += x[i] * y[i];
+  }
+
+  double det = n * sxx - sx * sx;
+  if (n < 2.0 || det <= 0.0) {
+    return false;
+  }
+
+  *b = (n * sxy - sx * sy) / det;
+  *a = (sy - *b * sx) / n;
+  return true;
+}
+
+// fit a line to the lower envelope of the points
+// latency only ever makes y late, so points more than threshold above the
+// earliest residual are dropped and the line is refit to the rest
+// returns the number of points kept
+std::size_t FitLowerEnvelope(const std::vector<double>& x,
+                             const std::vector<double>& y,
+                             double threshold, double* a, double* b) {
+  std::vector<bool> keep(x.size(), true);
+  std::size_t kept = x.size();
+
+  for (int iter = 0; iter < 3; iter++) {
+    if (!FitLine(x, y, keep, a, b)) {
+      return 0;
+    }
+
+    // shift the line down to the earliest point
+    double r_min = std::numeric_limits<double>::infinity();
+    for (std::size_t i = 0; i < x.size(); i++) {
+      r_min = std::min(r_min, y[i] - (*a + *b * x[i]));
+    }
+    *a += r_min;
+
+    // keep points near the envelope
+    std::size_t kept_next = 0;
+    for (std::size_t i = 0; i < x.size(); i++) {
+      keep[i] = (y[i] - (*a + *b * x[i])) <= threshold;
+      if (keep[i]) {
+        kept_next++;
+      }
+    }
+
+    if (kept_next == kept || kept_next < 2) {
+      break;
+    }
+    kept = kept_next;
+  }
+
+  return kept;
+}
+
+}  // namespace
+
+ClockEstimator::ClockEstimator() {
+}
+
+void ClockEstimator::Reset() {
+  bus_samples_.clear();
+  host_samples_.clear();
+  has_last_ = false;
+  frame_total_ = 0;
+  stamp_total_ = 0;
+  bus_ref_ = 0;
+  bus_stamp_ref_ = 0;
+  bus_a_ = 0.0;
+  bus_b_ = 1000.0;
+  bus_jitter_ = 0.0;
+  has_ref_ = false;
+  host_a_ = 0.0;
+  host_b_ = 1.0e-6;
+  report_count_ = 0;
+}
+
+void ClockEstimator::AddReport(const uint16_t* frames, const uint32_t* stamps,
+                               int count, double host_rx) {
+  int added = 0;
+  for (int i = 0; i < count; i++) {
+    if (AddSof(frames[i], stamps[i])) {
+      added++;
+    }
+  }
+
+  if (added == 0 || bus_samples_.size() < 2) {
+    return;
+  }
+
+  if (!FitBus(added)) {
+    return;
+  }
+
+  // clean teensy time of the newest frame in this report
+  double teensy = bus_a_ + bus_b_ * static_cast<double>(frame_total_ - bus_ref_);
+  if (!has_ref_) {
+    teensy_ref_ = bus_stamp_ref_;
+    host_ref_ = host_rx;
+    has_ref_ = true;
+  }
+
+  HostSample sample;
+  sample.teensy = teensy + static_cast<double>(bus_stamp_ref_ - teensy_ref_);
+  sample.host = host_rx - host_ref_;
+  host_samples_.push_back(sample);
+  while (host_samples_.size() > host_window_size_) {
+    host_samples_.pop_front();
+  }
+  report_count_++;
+
+  FitHost();
+}
+
+bool ClockEstimator::AddSof(uint16_t frame, uint32_t stamp) {
+  frame &= frame_mask_;
+
+  if (has_last_) {
+    int32_t dstamp = static_cast<int32_t>(stamp - last_stamp_);
+
+    // repeated or slightly out of order pair
+    if (dstamp < 500 && dstamp > -1000000) {
+      return false;
+    }
+
+    // the teensy restarted or we lost the device for a long time
+    if (dstamp < 0 || dstamp > 60000000) {
+      printf("(svis) Clock estimator reset\n");
+      Reset();
+    }
+  }
+
+  if (!has_last_) {
+    frame_total_ = frame;
+    stamp_total_ = stamp;
+  } else {
+    uint32_t dstamp = stamp - last_stamp_;
+    int dframe = (frame - last_frame_) & frame_mask_;
+
+    // resolve whole frame number wraps from the elapsed teensy time
+    int64_t wraps = std::llround((dstamp / 1000.0 - dframe) / frame_period_);
+    if (wraps < 0) {
+      wraps = 0;
+    }
+
+    frame_total_ += dframe + wraps * frame_period_;
+    stamp_total_ += dstamp;
+  }
+
+  has_last_ = true;
+  last_frame_ = frame;
+  last_stamp_ = stamp;
+
+  BusSample sample;
+  sample.frame = frame_total_;
+  sample.stamp = stamp_total_;
+  bus_samples_.push_back(sample);
+  while (bus_samples_.size() > bus_window_size_) {
+    bus_samples_.pop_front();
+  }
+
+  return true;
+}
+
+bool ClockEstimator::FitBus(int added) {
+  // fit relative to the oldest sample to keep the doubles small, the
+  // references only move along with a fit that succeeds
+  int64_t frame_ref = bus_samples_.front().frame;
+  int64_t stamp_ref = bus_samples_.front().stamp;
+
+  std::vector<double> x(bus_samples_.size());
+  std::vector<double> y(bus_samples_.size());
+  for (std::size_t i = 0; i < bus_samples_.size(); i++) {
+    x[i] = static_cast<double>(bus_samples_[i].frame - frame_ref);
+    y[i] = static_cast<double>(bus_samples_[i].stamp - stamp_ref);
+  }
+
+  double a = 0.0;
+  double b = 1000.0;
+  std::size_t kept = FitLowerEnvelope(x, y, bus_reject_threshold_, &a, &b);
+  if (kept < 2) {
+    return false;
+  }
+
+  // residual statistics, late stamps from the newest report are counted
+  double sum = 0.0;
+  for (std::size_t i = 0; i < x.size(); i++) {
+    double r = y[i] - (a + b * x[i]);
+    if (r <= bus_reject_threshold_) {
+      sum += r * r;
+    } else if (i + added >= x.size()) {
+      reject_count_++;
+    }
+  }
+  bus_jitter_ = std::sqrt(sum / static_cast<double>(kept));
+
+  // the stamps are relative to the oldest sample, see AddReport
+  bus_ref_ = frame_ref;
+  bus_stamp_ref_ = stamp_ref;
+  bus_a_ = a;
+  bus_b_ = b;
+  return true;
+}
+
+void ClockEstimator::FitHost() {
+  if (host_samples_.size() < 2) {
+    return;
+  }
+
+  std::vector<double> x(host_samples_.size());
+  std::vector<double> y(host_samples_.size());
+  for (std::size_t i = 0; i < host_samples_.size(); i++) {
+    x[i] = host_samples_[i].teensy;
+    y[i] = host_samples_[i].host;
+  }
+
+  double a = 0.0;
+  double b = 1.0e-6;
+  if (FitLowerEnvelope(x, y, host_reject_threshold_ * 1.0e-6, &a, &b) < 2) {
+    return;
+  }
+
+  host_a_ = a;
+  host_b_ = b;
+}
+
+bool ClockEstimator::IsValid() const {
+  return report_count_ >= min_report_count_;
+}
+
+double ClockEstimator::TeensyToHost(uint32_t stamp) const {
+  // unwrap against the newest sof stamp, samples may be slightly before or after
+  int64_t teensy = stamp_total_ + static_cast<int32_t>(stamp - last_stamp_);
+  double x = static_cast<double>(teensy - teensy_ref_);
+  return host_ref_ + host_a_ + host_b_ * x;
+}
+
+double ClockEstimator::GetSkew() const {
+  return host_b_ * 1.0e6;
+}
+
+double ClockEstimator::GetBusJitter() const {
+  return bus_jitter_;
+}
+
+uint32_t ClockEstimator::GetRejectCount() const {
+  return reject_count_;
+}
+
+}  // namespace svis
@@ -0,0 +1,93 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include <deque>
+
+namespace svis {
+
+// Maps teensy micros() stamps into host time using the USB start of frame
+// (SOF) pairs from the teensy clock reports.
+//
+// The teensy latches micros() in the SOF interrupt together with the 11 bit
+// frame number.  SOFs are exactly 1 ms apart on the bus, so a line fit of
+// stamp against frame gives a clean teensy time for each frame, and stamps
+// delayed by higher priority interrupts show up as late outliers.  The clean
+// times are then paired with the host receive time of each report and the
+// lower envelope of those pairs gives the host/teensy skew and offset, which
+// drops the usb and scheduling latency without any camera round trips.
+class ClockEstimator {
+ public:
+  ClockEstimator();
+  void Reset();
+
+  // add the sof pairs from one clock report, oldest first
+  // host_rx is the host time the report was received [s]
+  void AddReport(const uint16_t* frames, const uint32_t* stamps, int count,
+                 double host_rx);
+
+  bool IsValid() const;
+
+  // teensy micros() stamp to host time [s]
+  double TeensyToHost(uint32_t stamp) const;
+
+  double GetSkew() const;  // host seconds per teensy second
+  double GetBusJitter() const;  // rms of the accepted sof stamps above the fit [us]
+  uint32_t GetRejectCount() const;  // sof stamps rejected as late
+
+  // params
+  std::size_t bus_window_size_ = 1024;  // sof pairs
+  std::size_t host_window_size_ = 1024;  // clock reports
+  std::size_t min_report_count_ = 64;
+  double bus_reject_threshold_ = 10.0;  // [us] past the earliest residual
+  double host_reject_threshold_ = 200.0;  // [us] past the earliest residual
+
+ private:
+  struct BusSample {
+    int64_t frame;  // unwrapped usb frame number [ms]
+    int64_t stamp;  // unwrapped teensy stamp [us]
+  };
+
+  struct HostSample {
+    double teensy;  // clean teensy time relative to teensy_ref_ [us]
+    double host;  // host receive time relative to host_ref_ [s]
+  };
+
+  bool AddSof(uint16_t frame, uint32_t stamp);
+  bool FitBus(int added);
+  void FitHost();
+
+  std::deque<BusSample> bus_samples_;
+  std::deque<HostSample> host_samples_;
+
+  // unwrapping
+  bool has_last_ = false;
+  uint16_t last_frame_ = 0;
+  uint32_t last_stamp_ = 0;
+  int64_t frame_total_ = 0;
+  int64_t stamp_total_ = 0;
+
+  // stamp = bus_stamp_ref_ + bus_a_ + bus_b_*(frame - bus_ref_)
+  int64_t bus_ref_ = 0;
+  int64_t bus_stamp_ref_ = 0;
+  double bus_a_ = 0.0;
+  double bus_b_ = 1000.0;
+  double bus_jitter_ = 0.0;
+  uint32_t reject_count_ = 0;
+
+  // host = host_ref_ + host_a_ + host_b_*(teensy - teensy_ref_)
+  bool has_ref_ = false;
+  int64_t teensy_ref_ = 0;
+  double host_ref_ = 0.0;
+  double host_a_ = 0.0;
+  double host_b_ = 1.0e-6;
+  std::size_t report_count_ = 0;
+
+  // frame numbers wrap at 2048
+  const int frame_mask_ = 0x7FF;
+  const int frame_period_ = 2048;
+};
+
+}  // namespace svis
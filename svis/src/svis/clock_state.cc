@@ -0,0 +1,128 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include <stdio.h>
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "svis/clock_state.h"
+
+namespace svis {
+
+namespace {
+
+bool ParseLine(const std::string& line, ClockState* state) {
+  std::istringstream stream(line);
+  stream >> state->device >> state->camera >> state->camera_rate >> state->time_offset_bias
+         >> state->strobe_count_offset >> state->saved_time;
+  return !stream.fail() && state->camera_rate > 0;
+}
+
+bool ParseLine(const std::string& line, LinkState* state) {
+  std::istringstream stream(line);
+  stream >> state->device >> state->session >> state->send_count >> state->saved_time;
+  return !stream.fail();
+}
+
+// writes a temporary file and renames it so a crash never leaves a partial file
+bool ReplaceFile(const std::string& path, const std::vector<std::string>& lines) {
+  std::string tmp_path = path + ".tmp";
+  std::ofstream out(tmp_path);
+  if (!out) {
+    return false;
+  }
+  for (std::size_t i = 0; i < lines.size(); i++) {
+    out << lines[i] << "\n";
+  }
+  out.close();
+  if (!out) {
+    return false;
+  }
+
+  return rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+}  // namespace
+
+bool ReadClockState(const std::string& path, const std::string& device,
+                    const std::string& camera, int camera_rate, ClockState* state) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(file, line)) {
+    ClockState entry;
+    if (ParseLine(line, &entry) && entry.device == device && entry.camera == camera &&
+        entry.camera_rate == camera_rate) {
+      *state = entry;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool WriteClockState(const std::string& path, const ClockState& state) {
+  // keep the entries of other devices, cameras and rates
+  std::vector<std::string> lines;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    ClockState entry;
+    if (ParseLine(line, &entry) && !(entry.device == state.device && entry.camera == state.camera &&
+                                     entry.camera_rate == state.camera_rate)) {
+      lines.push_back(line);
+    }
+  }
+  in.close();
+
+  std::ostringstream entry;
+  entry.precision(17);
+  entry << state.device << " " << state.camera << " " << state.camera_rate << " "
+        << state.time_offset_bias << " " << state.strobe_count_offset << " " << state.saved_time;
+  lines.push_back(entry.str());
+  return ReplaceFile(path, lines);
+}
+
+bool ReadLinkState(const std::string& path, const std::string& device, LinkState* state) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(file, line)) {
+    LinkState entry;
+    if (ParseLine(line, &entry) && entry.device == device) {
+      *state = entry;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool WriteLinkState(const std::string& path, const LinkState& state) {
+  // keep the entries of other devices
+  std::vector<std::string> lines;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    LinkState entry;
+    if (ParseLine(line, &entry) && entry.device != state.device) {
+      lines.push_back(line);
+    }
+  }
+  in.close();
+
+  std::ostringstream entry;
+  entry.precision(17);
+  entry << state.device << " " << state.session << " " << state.send_count << " " << state.saved_time;
+  lines.push_back(entry.str());
+  return ReplaceFile(path, lines);
+}
+
+}  // namespace svis
@@ -0,0 +1,54 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+namespace svis {
+
+// Clock calibration kept between runs, keyed by teensy, camera and trigger
+// rate, so a restart can publish right away instead of redoing the pulse
+// calibration.
+//
+// The time offset is stored relative to the lower envelope of the report
+// receive offsets, host_rx - teensy stamp, which is measured again on every
+// start.  What carries over is then only the camera and usb latency, which
+// survives teensy resets, micros() wraps and clock drift between runs.  The
+// latency moves with the trigger rate and the exposure, so another rate keeps
+// its own entry and the exposure is left to the validation of each start.
+struct ClockState {
+  std::string device;
+  std::string camera;
+  int camera_rate = 0;  // [Hz]
+  double time_offset_bias = 0.0;  // [s] time offset minus the receive offset envelope
+  unsigned int strobe_count_offset = 0;
+  double saved_time = 0.0;  // [s] host time of the save
+};
+
+// one line per key,
+// "device camera camera_rate time_offset_bias strobe_count_offset saved_time"
+// returns false if the file or the key does not exist
+bool ReadClockState(const std::string& path, const std::string& device,
+                    const std::string& camera, int camera_rate, ClockState* state);
+
+// replaces the line with the same key and keeps the others, lines from before
+// the rate was part of the key are dropped
+bool WriteClockState(const std::string& path, const ClockState& state);
+
+// Where the host left off in the teensy send counts, keyed by teensy, so a
+// host that restarts or reconnects asks the teensy journal for the reports it
+// missed in between.  The session tells whether the teensy kept its send count.
+struct LinkState {
+  std::string device;
+  uint32_t session = 0;  // 0 before the first status report
+  uint16_t send_count = 0;  // last report received
+  double saved_time = 0.0;  // [s] host time of the save
+};
+
+// one line per key, "device session send_count saved_time"
+bool ReadLinkState(const std::string& path, const std::string& device, LinkState* state);
+bool WriteLinkState(const std::string& path, const LinkState& state);
+
+}  // namespace svis
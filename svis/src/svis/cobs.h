@@ -0,0 +1,121 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Consistent overhead byte stuffing (COBS) and CRC helpers for the bulk
+// (USB serial) transport.  This header is shared by the host library and the
+// teensy firmware, so it must stay free of any STL or OS dependencies.
+//
+// A frame on the wire is COBS(payload + crc16) followed by a zero delimiter.
+
+namespace svis {
+
+const uint8_t kCobsDelimiter = 0x00;
+
+// worst case encoded size of len bytes, not including the delimiter
+inline size_t CobsMaxEncodedSize(size_t len) {
+  return len + len / 254 + 1;
+}
+
+// encode len bytes from src into dst and return the number of bytes written
+// dst must hold at least CobsMaxEncodedSize(len) bytes
+inline size_t CobsEncode(const uint8_t* src, size_t len, uint8_t* dst) {
+  size_t code_index = 0;
+  size_t write_index = 1;
+  uint8_t code = 1;
+
+  for (size_t read_index = 0; read_index < len; read_index++) {
+    if (src[read_index] == kCobsDelimiter) {
+      dst[code_index] = code;
+      code_index = write_index++;
+      code = 1;
+    } else {
+      dst[write_index++] = src[read_index];
+      code++;
+      if (code == 0xFF) {
+        dst[code_index] = code;
+        code_index = write_index++;
+        code = 1;
+      }
+    }
+  }
+  dst[code_index] = code;
+
+  return write_index;
+}
+
+// decode len bytes (delimiter excluded) from src into dst and return the number
+// of bytes written, or 0 if the input is malformed
+// decoding never grows the data, so src and dst may be the same buffer
+inline size_t CobsDecode(const uint8_t* src, size_t len, uint8_t* dst) {
+  size_t read_index = 0;
+  size_t write_index = 0;
+
+  while (read_index < len) {
+    uint8_t code = src[read_index];
+    if (code == kCobsDelimiter || read_index + code > len) {
+      return 0;
+    }
+    read_index++;
+
+    for (uint8_t i = 1; i < code; i++) {
+      dst[write_index++] = src[read_index++];
+    }
+
+    if (code != 0xFF && read_index != len) {
+      dst[write_index++] = kCobsDelimiter;
+    }
+  }
+
+  return write_index;
+}
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) using a nibble table
+inline uint16_t Crc16(const uint8_t* data, size_t len) {
+  static const uint16_t table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF};
+
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc = (crc << 4) ^ table[((crc >> 12) ^ (data[i] >> 4)) & 0x0F];
+    crc = (crc << 4) ^ table[((crc >> 12) ^ (data[i] & 0x0F)) & 0x0F];
+  }
+
+  return crc;
+}
+
+// append crc to payload, cobs encode into dst and terminate with a delimiter
+// dst must hold at least CobsMaxEncodedSize(len + 2) + 1 bytes
+// payload must have two spare bytes after len for the crc
+inline size_t CobsFrameEncode(uint8_t* payload, size_t len, uint8_t* dst) {
+  uint16_t crc = Crc16(payload, len);
+  payload[len] = crc & 0xFF;
+  payload[len + 1] = crc >> 8;
+
+  size_t n = CobsEncode(payload, len + 2, dst);
+  dst[n++] = kCobsDelimiter;
+
+  return n;
+}
+
+// decode a frame (delimiter excluded) in place and check its crc
+// returns the payload length with the crc stripped, or 0 on failure
+inline size_t CobsFrameDecode(uint8_t* frame, size_t len) {
+  size_t n = CobsDecode(frame, len, frame);
+  if (n < 3) {
+    return 0;
+  }
+
+  uint16_t crc = frame[n - 2] | (frame[n - 1] << 8);
+  if (Crc16(frame, n - 2) != crc) {
+    return 0;
+  }
+
+  return n - 2;
+}
+
+}  // namespace svis
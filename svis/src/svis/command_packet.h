@@ -0,0 +1,19 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+namespace svis {
+
+struct CommandPacket {
+  uint8_t request_id = 0;  // echoed back by the teensy in the ack
+  uint8_t command = 0;  // command code
+  int32_t arg[2] = {0};  // command arguments applied on the host after the ack
+  std::vector<char> buf;  // raw packet for retries
+  int retries = 0;  // number of times this has been resent
+  std::chrono::time_point<std::chrono::high_resolution_clock> t_sent;
+};
+
+}  // namespace svis
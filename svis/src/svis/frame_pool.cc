@@ -0,0 +1,205 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <utility>
+
+#include "svis/frame_pool.h"
+
+namespace svis {
+
+namespace {
+
+const std::size_t huge_page_size = 2 * 1024 * 1024;
+
+}  // namespace
+
+FramePool& FramePool::Default() {
+  static FramePool pool;
+  return pool;
+}
+
+FramePool::~FramePool() {
+  for (auto& entry : free_) {
+    for (uint8_t* block : entry.second) {
+      Free(block);
+    }
+  }
+}
+
+void FramePool::SetBacking(Backing backing) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  backing_ = backing;
+}
+
+void FramePool::SetMaxFree(std::size_t max_free) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_free_ = max_free;
+}
+
+uint64_t FramePool::GetAllocCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return alloc_count_;
+}
+
+uint8_t* FramePool::Acquire(std::size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = free_.find(size);
+    if (it != free_.end() && !it->second.empty()) {
+      uint8_t* block = it->second.back();
+      it->second.pop_back();
+      return block;
+    }
+    alloc_count_++;
+  }
+
+  return Allocate(size);
+}
+
+void FramePool::Release(uint8_t* block, std::size_t size) {
+  if (block == nullptr) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<uint8_t*>& blocks = free_[size];
+    if (blocks.size() < max_free_) {
+      blocks.push_back(block);
+      return;
+    }
+  }
+
+  Free(block);
+}
+
+uint8_t* FramePool::Allocate(std::size_t size) {
+  Backing backing;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    backing = backing_;
+  }
+
+  std::size_t total = size + kHeaderSize;
+  uint8_t* base = nullptr;
+  BlockHeader header = {0, 0};
+
+#ifdef MAP_HUGETLB
+  if (backing == kHugePage) {
+    std::size_t mapped = (total + huge_page_size - 1) / huge_page_size * huge_page_size;
+    void* p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+      base = static_cast<uint8_t*>(p);
+      header.mapped = mapped;
+    } else {
+      printf("(svis) No huge pages available for a %zu byte frame, using locked memory\n", size);
+      backing = kLocked;
+    }
+  }
+#else
+  if (backing == kHugePage) {
+    backing = kLocked;
+  }
+#endif
+
+  if (base == nullptr) {
+    void* p = nullptr;
+    if (posix_memalign(&p, kHeaderSize, total) != 0) {
+      printf("(svis) Failed to allocate a %zu byte frame\n", size);
+      exit(1);
+    }
+    base = static_cast<uint8_t*>(p);
+  }
+
+  // pin the pages, huge pages are never swapped anyway
+  if (backing == kLocked) {
+    if (mlock(base, total) == 0) {
+      header.locked = total;
+    } else {
+      printf("(svis) mlock of a %zu byte frame failed, check RLIMIT_MEMLOCK\n", size);
+    }
+  }
+
+  memcpy(base, &header, sizeof(header));
+  return base + kHeaderSize;
+}
+
+void FramePool::Free(uint8_t* block) {
+  uint8_t* base = block - kHeaderSize;
+  BlockHeader header;
+  memcpy(&header, base, sizeof(header));
+
+  if (header.mapped > 0) {
+    munmap(base, header.mapped);
+    return;
+  }
+
+  if (header.locked > 0) {
+    munlock(base, header.locked);
+  }
+  free(base);
+}
+
+FrameBuffer::FrameBuffer(const FrameBuffer& other) : pool_(other.pool_) {
+  assign(other.begin(), other.end());
+}
+
+FrameBuffer::FrameBuffer(FrameBuffer&& other) noexcept
+    : pool_(other.pool_), data_(other.data_), size_(other.size_) {
+  other.data_ = nullptr;
+  other.size_ = 0;
+}
+
+FrameBuffer& FrameBuffer::operator=(const FrameBuffer& other) {
+  if (this != &other) {
+    assign(other.begin(), other.end());
+  }
+  return *this;
+}
+
+FrameBuffer& FrameBuffer::operator=(FrameBuffer&& other) noexcept {
+  if (this != &other) {
+    clear();
+    pool_ = other.pool_;
+    data_ = other.data_;
+    size_ = other.size_;
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+void FrameBuffer::resize(std::size_t size) {
+  if (size == size_) {
+    return;
+  }
+
+  clear();
+  data_ = pool_->Acquire(size);
+  size_ = size;
+}
+
+void FrameBuffer::assign(const uint8_t* first, const uint8_t* last) {
+  std::size_t size = static_cast<std::size_t>(last - first);
+  resize(size);
+  if (size > 0) {
+    memcpy(data_, first, size);
+  }
+}
+
+void FrameBuffer::clear() {
+  pool_->Release(data_, size_);
+  data_ = nullptr;
+  size_ = 0;
+}
+
+}  // namespace svis
@@ -0,0 +1,94 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace svis {
+
+// Recycles image storage by byte size.  Camera frames are the same size every
+// time, so after the first few frames every Acquire is served from the free
+// list and Release returns the block instead of freeing it.  Thread safe, the
+// camera callback acquires while the sync thread releases.
+class FramePool {
+ public:
+  enum Backing {
+    kHeap,  // 64 byte aligned heap blocks
+    kLocked,  // heap blocks pinned with mlock so frames never page out
+    kHugePage,  // 2 MB huge pages, falls back to kLocked if none are reserved
+  };
+
+  // shared by every FrameBuffer that is not given a pool
+  static FramePool& Default();
+
+  FramePool() = default;
+  ~FramePool();
+  FramePool(const FramePool&) = delete;
+  FramePool& operator=(const FramePool&) = delete;
+
+  // applies to blocks allocated from now on
+  void SetBacking(Backing backing);
+  void SetMaxFree(std::size_t max_free);  // free blocks kept per size
+
+  uint8_t* Acquire(std::size_t size);
+  void Release(uint8_t* block, std::size_t size);
+
+  uint64_t GetAllocCount() const;  // blocks allocated from the os so far
+
+ private:
+  // stored in front of each block so Release knows how to free it
+  struct BlockHeader {
+    std::size_t mapped;  // mmap length, 0 for heap blocks
+    std::size_t locked;  // mlock length, 0 if not locked
+  };
+  static const std::size_t kHeaderSize = 64;  // keeps the data 64 byte aligned
+
+  uint8_t* Allocate(std::size_t size);
+  static void Free(uint8_t* block);
+
+  mutable std::mutex mutex_;
+  Backing backing_ = kHeap;
+  std::size_t max_free_ = 16;
+  std::map<std::size_t, std::vector<uint8_t*>> free_;  // keyed by byte size
+  uint64_t alloc_count_ = 0;
+};
+
+// Pooled, vector like byte buffer used for image data.  Copies take a new
+// block from the same pool, moves hand the block over.
+class FrameBuffer {
+ public:
+  explicit FrameBuffer(FramePool* pool = &FramePool::Default()) : pool_(pool) {}
+  FrameBuffer(const FrameBuffer& other);
+  FrameBuffer(FrameBuffer&& other) noexcept;
+  FrameBuffer& operator=(const FrameBuffer& other);
+  FrameBuffer& operator=(FrameBuffer&& other) noexcept;
+  ~FrameBuffer() { clear(); }
+
+  // contents are unspecified after a resize to a different size
+  void resize(std::size_t size);
+  void assign(const uint8_t* first, const uint8_t* last);
+  void clear();
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  uint8_t* data() { return data_; }
+  const uint8_t* data() const { return data_; }
+  uint8_t& operator[](std::size_t i) { return data_[i]; }
+  const uint8_t& operator[](std::size_t i) const { return data_[i]; }
+  uint8_t* begin() { return data_; }
+  uint8_t* end() { return data_ + size_; }
+  const uint8_t* begin() const { return data_; }
+  const uint8_t* end() const { return data_ + size_; }
+
+ private:
+  FramePool* pool_;
+  uint8_t* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+}  // namespace svis
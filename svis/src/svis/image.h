@@ -2,9 +2,11 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include <string>
-#include <vector>
 
+#include "svis/frame_pool.h"
 #include "svis/header.h"
 
 namespace svis {
@@ -16,7 +18,7 @@ struct Image {
   std::string encoding = "";
   uint8_t is_bigendian = 0;
   uint32_t step = 0;
-  std::vector<uint8_t> data;
+  FrameBuffer data;  // pooled, frames of the same size reuse storage
 };
 
 }  // namespace svis
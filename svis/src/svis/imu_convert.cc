@@ -0,0 +1,111 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "svis/imu_convert.h"
+
+namespace svis {
+
+namespace {
+
+const double g = 9.80665;
+const double rad_per_deg = 0.0174533;
+
+// sensitivities from the MPU6050/ICM20689 datasheets
+const double gyro_sens_arr[4] = {131, 65.5, 32.8, 16.4};  // LSB/(deg/s)
+const double acc_sens_arr[4] = {16384, 8192, 4096, 2048};  // LSB/g
+
+int ClampSens(int sens) {
+  return sens < 0 ? 0 : (sens > 3 ? 3 : sens);
+}
+
+}  // namespace
+
+void ImuBatch::Resize(std::size_t n) {
+  timestamp_teensy_raw.resize(n);
+  for (int j = 0; j < 3; j++) {
+    acc_raw[j].resize(n);
+    gyro_raw[j].resize(n);
+    acc[j].resize(n);
+    gyro[j].resize(n);
+  }
+}
+
+void ImuBatch::Clear() {
+  Resize(0);
+}
+
+float AccScale(int acc_sens) {
+  return static_cast<float>(g / acc_sens_arr[ClampSens(acc_sens)]);
+}
+
+float GyroScale(int gyro_sens) {
+  return static_cast<float>(rad_per_deg / gyro_sens_arr[ClampSens(gyro_sens)]);
+}
+
+void ConvertCounts(const int16_t* src, std::size_t n, float scale, float* dst) {
+  std::size_t i = 0;
+
+#if defined(__AVX2__)
+  const __m256 s = _mm256_set1_ps(scale);
+  for (; i + 8 <= n; i += 8) {
+    __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+    __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(raw));
+    _mm256_storeu_ps(&dst[i], _mm256_mul_ps(f, s));
+  }
+#elif defined(__SSE2__)
+  const __m128 s = _mm_set1_ps(scale);
+  for (; i + 8 <= n; i += 8) {
+    __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+    // sign extend by unpacking into the high half and shifting back down
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(raw, raw), 16);
+    _mm_storeu_ps(&dst[i], _mm_mul_ps(_mm_cvtepi32_ps(lo), s));
+    _mm_storeu_ps(&dst[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), s));
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const float32x4_t s = vdupq_n_f32(scale);
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t raw = vld1q_s16(&src[i]);
+    float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(raw)));
+    float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(raw)));
+    vst1q_f32(&dst[i], vmulq_f32(lo, s));
+    vst1q_f32(&dst[i + 4], vmulq_f32(hi, s));
+  }
+#endif
+
+  // remainder
+  for (; i < n; i++) {
+    dst[i] = static_cast<float>(src[i]) * scale;
+  }
+}
+
+void ConvertImuBatch(float acc_scale, float gyro_scale, ImuBatch* batch) {
+  std::size_t n = batch->size();
+  for (int j = 0; j < 3; j++) {
+    batch->acc[j].resize(n);
+    batch->gyro[j].resize(n);
+    ConvertCounts(batch->acc_raw[j].data(), n, acc_scale, batch->acc[j].data());
+    ConvertCounts(batch->gyro_raw[j].data(), n, gyro_scale, batch->gyro[j].data());
+  }
+}
+
+const char* ConvertCountsPath() {
+#if defined(__AVX2__)
+  return "avx2";
+#elif defined(__SSE2__)
+  return "sse2";
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+}  // namespace svis
@@ -0,0 +1,39 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace svis {
+
+// imu samples in structure of arrays form for batch conversion
+struct ImuBatch {
+  std::vector<uint32_t> timestamp_teensy_raw;  // [microseconds]
+  std::vector<int16_t> acc_raw[3];  // counts
+  std::vector<int16_t> gyro_raw[3];  // counts
+  std::vector<float> acc[3];  // m/s^2
+  std::vector<float> gyro[3];  // rad/sec
+
+  std::size_t size() const { return timestamp_teensy_raw.size(); }
+  void Resize(std::size_t n);
+  void Clear();
+};
+
+// reciprocal scales from counts to SI units for a sensitivity selection [0,3]
+float AccScale(int acc_sens);  // (m/s^2)/LSB
+float GyroScale(int gyro_sens);  // (rad/s)/LSB
+
+// dst[i] = src[i]*scale using the widest simd available at compile time
+// (avx2, sse2, neon or scalar)
+void ConvertCounts(const int16_t* src, std::size_t n, float scale, float* dst);
+
+// convert all raw axes of the batch into the float arrays
+void ConvertImuBatch(float acc_scale, float gyro_scale, ImuBatch* batch);
+
+// name of the compiled conversion path for logging
+const char* ConvertCountsPath();
+
+}  // namespace svis
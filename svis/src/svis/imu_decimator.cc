@@ -0,0 +1,148 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include <cmath>
+#include <cstring>
+
+#include "svis/imu_decimator.h"
+
+namespace svis {
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+static_assert(ImuDecimator::kLanes == 8, "Dot8 assumes 8 lanes per sample");
+
+// out[l] = sum_i taps[i]*window[i*kLanes + l]
+void Dot8(const float* taps, const float* window, int n, float* out) {
+#if defined(__AVX__)
+  // two accumulators to hide the add latency
+  __m256 acc_even = _mm256_setzero_ps();
+  __m256 acc_odd = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 1 < n; i += 2) {
+    acc_even = _mm256_add_ps(acc_even, _mm256_mul_ps(_mm256_set1_ps(taps[i]), _mm256_loadu_ps(window + 8*i)));
+    acc_odd = _mm256_add_ps(acc_odd, _mm256_mul_ps(_mm256_set1_ps(taps[i + 1]), _mm256_loadu_ps(window + 8*i + 8)));
+  }
+  for (; i < n; i++) {
+    acc_even = _mm256_add_ps(acc_even, _mm256_mul_ps(_mm256_set1_ps(taps[i]), _mm256_loadu_ps(window + 8*i)));
+  }
+  _mm256_storeu_ps(out, _mm256_add_ps(acc_even, acc_odd));
+#elif defined(__SSE__)
+  __m128 acc_lo = _mm_setzero_ps();
+  __m128 acc_hi = _mm_setzero_ps();
+  for (int i = 0; i < n; i++) {
+    __m128 h = _mm_set1_ps(taps[i]);
+    acc_lo = _mm_add_ps(acc_lo, _mm_mul_ps(h, _mm_loadu_ps(window + 8*i)));
+    acc_hi = _mm_add_ps(acc_hi, _mm_mul_ps(h, _mm_loadu_ps(window + 8*i + 4)));
+  }
+  _mm_storeu_ps(out, acc_lo);
+  _mm_storeu_ps(out + 4, acc_hi);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  float32x4_t acc_lo = vdupq_n_f32(0.0f);
+  float32x4_t acc_hi = vdupq_n_f32(0.0f);
+  for (int i = 0; i < n; i++) {
+    acc_lo = vmlaq_n_f32(acc_lo, vld1q_f32(window + 8*i), taps[i]);
+    acc_hi = vmlaq_n_f32(acc_hi, vld1q_f32(window + 8*i + 4), taps[i]);
+  }
+  vst1q_f32(out, acc_lo);
+  vst1q_f32(out + 4, acc_hi);
+#else
+  for (int l = 0; l < 8; l++) {
+    out[l] = 0.0f;
+  }
+  for (int i = 0; i < n; i++) {
+    for (int l = 0; l < 8; l++) {
+      out[l] += taps[i] * window[8*i + l];
+    }
+  }
+#endif
+}
+
+}  // namespace
+
+void ImuDecimator::Configure(int ratio, double cutoff, int taps) {
+  ratio_ = ratio < 1 ? 1 : ratio;
+  taps_count_ = taps < 1 ? 1 : (taps | 1);
+  if (cutoff <= 0.0 || cutoff > 0.5) {
+    cutoff = 0.5;
+  }
+
+  // blackman windowed sinc with unity dc gain
+  taps_.assign(taps_count_, 0.0f);
+  double center = 0.5 * (taps_count_ - 1);
+  double sum = 0.0;
+  std::vector<double> h(taps_count_);
+  for (int i = 0; i < taps_count_; i++) {
+    double x = i - center;
+    double sinc = (x == 0.0) ? 2.0 * cutoff : std::sin(2.0 * pi * cutoff * x) / (pi * x);
+    double window = 1.0;
+    if (taps_count_ > 1) {
+      double r = static_cast<double>(i) / (taps_count_ - 1);
+      window = 0.42 - 0.5 * std::cos(2.0 * pi * r) + 0.08 * std::cos(4.0 * pi * r);
+    }
+    h[i] = sinc * window;
+    sum += h[i];
+  }
+
+  // stored reversed so the oldest sample in the window meets the last tap
+  for (int i = 0; i < taps_count_; i++) {
+    taps_[taps_count_ - 1 - i] = static_cast<float>(h[i] / sum);
+  }
+
+  delay_.assign(2 * taps_count_ * kLanes, 0.0f);
+  stamps_.assign(taps_count_, 0);
+  Reset();
+}
+
+void ImuDecimator::Reset() {
+  pos_ = 0;
+  fill_ = 0;
+  phase_ = 0;
+}
+
+bool ImuDecimator::Push(uint64_t timestamp, const float axes[kAxes],
+                        uint64_t* timestamp_out, float axes_out[kAxes]) {
+  if (taps_.empty()) {
+    Configure(ratio_, 0.5, taps_count_);
+  }
+
+  // overwrite the oldest sample in both copies, the window then starts one later
+  float* a = &delay_[pos_ * kLanes];
+  float* b = &delay_[(pos_ + taps_count_) * kLanes];
+  std::memcpy(a, axes, kAxes * sizeof(float));
+  std::memcpy(b, axes, kAxes * sizeof(float));
+  stamps_[pos_] = timestamp;
+  pos_ = (pos_ + 1 == taps_count_) ? 0 : pos_ + 1;
+
+  if (fill_ < taps_count_) {
+    fill_++;
+  }
+
+  // keep one output in ratio once the window is full
+  if (fill_ < taps_count_) {
+    return false;
+  }
+  bool due = (phase_ == 0);
+  phase_ = (phase_ + 1 == ratio_) ? 0 : phase_ + 1;
+  if (!due) {
+    return false;
+  }
+
+  float out[kLanes];
+  Dot8(taps_.data(), &delay_[pos_ * kLanes], taps_count_, out);
+  std::memcpy(axes_out, out, kAxes * sizeof(float));
+  *timestamp_out = stamps_[(pos_ + GetDelay()) % taps_count_];
+
+  return true;
+}
+
+}  // namespace svis
@@ -0,0 +1,52 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace svis {
+
+// Streaming anti-aliasing decimator for the six imu axes.  A linear phase
+// windowed sinc FIR is evaluated only at the retained outputs, which is the
+// polyphase cost of taps multiply-adds per output instead of per input.  The
+// delay line persists across reports, so outputs do not depend on how the
+// samples were split into reports.
+//
+// The axes are stored as 8 float lanes per sample (6 axes and 2 padding) so
+// every tap is one 8 wide multiply-add across all axes.
+class ImuDecimator {
+ public:
+  static const int kAxes = 6;  // [ax, ay, az, gx, gy, gz]
+  static const int kLanes = 8;
+
+  // ratio: inputs per output, >= 1
+  // cutoff: ideal low pass corner as a fraction of the input rate, (0, 0.5)
+  // taps: filter length, rounded up to odd so the delay is a whole sample
+  void Configure(int ratio, double cutoff, int taps);
+
+  // clears the delay line, the next output needs a full window
+  void Reset();
+
+  // returns true when an output is due, stamped at the center of the window
+  bool Push(uint64_t timestamp, const float axes[kAxes],
+            uint64_t* timestamp_out, float axes_out[kAxes]);
+
+  int GetRatio() const { return ratio_; }
+  int GetDelay() const { return (taps_count_ - 1) / 2; }  // [samples]
+  const std::vector<float>& GetTaps() const { return taps_; }
+
+ private:
+  int ratio_ = 1;
+  int taps_count_ = 1;
+  std::vector<float> taps_;
+  std::vector<float> delay_;  // 2*taps x kLanes, written twice so the window is contiguous
+  std::vector<uint64_t> stamps_;  // [microseconds]
+  int pos_ = 0;  // oldest sample in the window
+  int fill_ = 0;
+  int phase_ = 0;
+};
+
+}  // namespace svis
@@ -0,0 +1,240 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include <cmath>
+
+#include "svis/imu_history.h"
+
+namespace svis {
+
+ImuHistory::ImuHistory(std::size_t capacity) {
+  SetCapacity(capacity);
+}
+
+void ImuHistory::SetCapacity(std::size_t capacity) {
+  std::size_t n = 1;
+  while (n < capacity) {
+    n <<= 1;
+  }
+
+  samples_.assign(n, Sample());
+  mask_ = n - 1;
+  Clear();
+}
+
+void ImuHistory::Clear() {
+  head_ = 0;
+  size_ = 0;
+}
+
+bool ImuHistory::Push(const ImuPacket& imu) {
+  if (size_ > 0 && imu.timestamp_ros <= GetEndTime()) {
+    return false;
+  }
+
+  if (size_ == capacity()) {
+    head_ = Index(1);
+    size_--;
+  }
+
+  Sample& sample = samples_[Index(size_)];
+  sample.t = imu.timestamp_ros;
+  for (int j = 0; j < 3; j++) {
+    sample.acc[j] = imu.acc[j];
+    sample.gyro[j] = imu.gyro[j];
+  }
+  size_++;
+
+  return true;
+}
+
+bool ImuHistory::Merge(const ImuPacket& imu) {
+  if (size_ == 0 || imu.timestamp_ros > GetEndTime()) {
+    return Push(imu);
+  }
+
+  std::size_t i = UpperBound(imu.timestamp_ros);
+  if (i > 0 && At(i - 1).t == imu.timestamp_ros) {
+    return false;
+  }
+
+  // older than everything a full history keeps
+  if (size_ == capacity()) {
+    if (i == 0) {
+      return false;
+    }
+    head_ = Index(1);
+    size_--;
+    i--;
+  }
+
+  for (std::size_t k = size_; k > i; k--) {
+    samples_[Index(k)] = samples_[Index(k - 1)];
+  }
+
+  Sample& sample = samples_[Index(i)];
+  sample.t = imu.timestamp_ros;
+  for (int j = 0; j < 3; j++) {
+    sample.acc[j] = imu.acc[j];
+    sample.gyro[j] = imu.gyro[j];
+  }
+  size_++;
+
+  return true;
+}
+
+double ImuHistory::GetStartTime() const {
+  return size_ > 0 ? At(0).t : 0.0;
+}
+
+double ImuHistory::GetEndTime() const {
+  return size_ > 0 ? At(size_ - 1).t : 0.0;
+}
+
+std::size_t ImuHistory::UpperBound(double t) const {
+  std::size_t lo = 0;
+  std::size_t hi = size_;
+  while (lo < hi) {
+    std::size_t mid = lo + (hi - lo) / 2;
+    if (At(mid).t <= t) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+void ImuHistory::SampleAt(double t, Sample* out) const {
+  std::size_t i = UpperBound(t);
+
+  // exactly at or past the newest sample
+  if (i >= size_) {
+    *out = At(size_ - 1);
+    out->t = t;
+    return;
+  }
+
+  const Sample& a = At(i - 1);
+  const Sample& b = At(i);
+  float alpha = static_cast<float>((t - a.t) / (b.t - a.t));
+  out->t = t;
+  for (int j = 0; j < 3; j++) {
+    out->acc[j] = a.acc[j] + alpha * (b.acc[j] - a.acc[j]);
+    out->gyro[j] = a.gyro[j] + alpha * (b.gyro[j] - a.gyro[j]);
+  }
+}
+
+bool ImuHistory::Interpolate(double t, ImuPacket* imu) const {
+  if (size_ == 0 || t < GetStartTime() || t > GetEndTime()) {
+    return false;
+  }
+
+  Sample sample;
+  SampleAt(t, &sample);
+
+  imu->timestamp_ros = t;
+  for (int j = 0; j < 3; j++) {
+    imu->acc[j] = sample.acc[j];
+    imu->gyro[j] = sample.gyro[j];
+  }
+
+  return true;
+}
+
+std::size_t ImuHistory::GetRange(double t0, double t1, std::vector<ImuPacket>* imu_packets) const {
+  if (size_ == 0 || t1 < t0) {
+    return 0;
+  }
+
+  // first sample with t >= t0
+  std::size_t lo = 0;
+  std::size_t hi = size_;
+  while (lo < hi) {
+    std::size_t mid = lo + (hi - lo) / 2;
+    if (At(mid).t < t0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  std::size_t end = UpperBound(t1);
+
+  for (std::size_t i = lo; i < end; i++) {
+    const Sample& sample = At(i);
+    ImuPacket imu;
+    imu.timestamp_ros = sample.t;
+    for (int j = 0; j < 3; j++) {
+      imu.acc[j] = sample.acc[j];
+      imu.gyro[j] = sample.gyro[j];
+    }
+    imu_packets->push_back(imu);
+  }
+
+  return end > lo ? end - lo : 0;
+}
+
+bool ImuHistory::IntegrateGyro(double t0, double t1, double q[4]) const {
+  if (size_ < 2 || t1 < t0 || t0 < GetStartTime() || t1 > GetEndTime()) {
+    return false;
+  }
+
+  q[0] = 1.0;
+  q[1] = 0.0;
+  q[2] = 0.0;
+  q[3] = 0.0;
+
+  // walk from t0 through the samples inside the interval to t1
+  Sample prev;
+  SampleAt(t0, &prev);
+  std::size_t i = UpperBound(t0);
+  bool done = false;
+  while (!done) {
+    Sample next;
+    if (i < size_ && At(i).t < t1) {
+      next = At(i);
+      i++;
+    } else {
+      SampleAt(t1, &next);
+      done = true;
+    }
+
+    // midpoint rotation vector over the step
+    double dt = next.t - prev.t;
+    double w[3];
+    for (int j = 0; j < 3; j++) {
+      w[j] = 0.5 * (prev.gyro[j] + next.gyro[j]) * dt;
+    }
+    double angle = std::sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+
+    // exponential map, small angle safe
+    double dq[4];
+    double half = 0.5 * angle;
+    double k = (angle > 1.0e-12) ? std::sin(half) / angle : 0.5;
+    dq[0] = std::cos(half);
+    dq[1] = k * w[0];
+    dq[2] = k * w[1];
+    dq[3] = k * w[2];
+
+    // q = q * dq
+    double r[4];
+    r[0] = q[0] * dq[0] - q[1] * dq[1] - q[2] * dq[2] - q[3] * dq[3];
+    r[1] = q[0] * dq[1] + q[1] * dq[0] + q[2] * dq[3] - q[3] * dq[2];
+    r[2] = q[0] * dq[2] - q[1] * dq[3] + q[2] * dq[0] + q[3] * dq[1];
+    r[3] = q[0] * dq[3] + q[1] * dq[2] - q[2] * dq[1] + q[3] * dq[0];
+    for (int j = 0; j < 4; j++) {
+      q[j] = r[j];
+    }
+
+    prev = next;
+  }
+
+  // renormalize
+  double norm = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+  for (int j = 0; j < 4; j++) {
+    q[j] /= norm;
+  }
+
+  return true;
+}
+
+}  // namespace svis
@@ -0,0 +1,72 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "svis/imu_packet.h"
+
+namespace svis {
+
+// Bounded, time sorted history of full rate imu samples in ros time.  Queries
+// locate their bounds by binary search, so they cost O(log n) plus the number
+// of samples returned.
+class ImuHistory {
+ public:
+  explicit ImuHistory(std::size_t capacity = 0);
+
+  // rounds up to a power of two and clears the history
+  void SetCapacity(std::size_t capacity);
+
+  std::size_t capacity() const { return mask_ + 1; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  void Clear();
+
+  // samples must arrive in time order, older ones are rejected
+  // the oldest sample is dropped when full
+  bool Push(const ImuPacket& imu);
+
+  // inserts a sample that arrives late, e.g. replayed from the teensy journal,
+  // in time order, moving the newer samples up, duplicates are rejected
+  bool Merge(const ImuPacket& imu);
+
+  double GetStartTime() const;  // [seconds] oldest sample
+  double GetEndTime() const;  // [seconds] newest sample
+
+  // linear interpolation of acc and gyro at t
+  // fails if t is outside the history
+  bool Interpolate(double t, ImuPacket* imu) const;
+
+  // all samples with t0 <= t <= t1, returns the number appended
+  std::size_t GetRange(double t0, double t1, std::vector<ImuPacket>* imu_packets) const;
+
+  // rotation from the body frame at t1 to the body frame at t0 from
+  // midpoint integration of the gyro, q = [w, x, y, z]
+  // fails if [t0, t1] is not covered by the history
+  bool IntegrateGyro(double t0, double t1, double q[4]) const;
+
+ private:
+  struct Sample {
+    double t;  // [seconds] ros time
+    float acc[3];  // m/s^2
+    float gyro[3];  // rad/sec
+  };
+
+  std::size_t Index(std::size_t i) const { return (head_ + i) & mask_; }
+  const Sample& At(std::size_t i) const { return samples_[Index(i)]; }
+
+  // first sample with time > t, in [0, size]
+  std::size_t UpperBound(double t) const;
+
+  // sample values at t, with t inside the history
+  void SampleAt(double t, Sample* out) const;
+
+  std::vector<Sample> samples_;
+  std::size_t head_ = 0;  // oldest sample
+  std::size_t size_ = 0;
+  std::size_t mask_ = 0;
+};
+
+}  // namespace svis
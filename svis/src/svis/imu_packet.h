@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 namespace svis {
 
 struct ImuPacket {
@@ -0,0 +1,136 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include <cmath>
+
+#include "svis/imu_preintegration.h"
+
+namespace svis {
+
+namespace {
+
+// c = a * b
+void Mul(const double a[9], const double b[9], double c[9]) {
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      c[3*i + j] = a[3*i] * b[j] + a[3*i + 1] * b[3 + j] + a[3*i + 2] * b[6 + j];
+    }
+  }
+}
+
+// c = a^T * b
+void MulTransposed(const double a[9], const double b[9], double c[9]) {
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      c[3*i + j] = a[i] * b[j] + a[3 + i] * b[3 + j] + a[6 + i] * b[6 + j];
+    }
+  }
+}
+
+// y = a * x
+void MulVec(const double a[9], const double x[3], double y[3]) {
+  for (int i = 0; i < 3; i++) {
+    y[i] = a[3*i] * x[0] + a[3*i + 1] * x[1] + a[3*i + 2] * x[2];
+  }
+}
+
+void Skew(const double v[3], double s[9]) {
+  s[0] = 0.0;   s[1] = -v[2]; s[2] = v[1];
+  s[3] = v[2];  s[4] = 0.0;   s[5] = -v[0];
+  s[6] = -v[1]; s[7] = v[0];  s[8] = 0.0;
+}
+
+// so(3) exponential and right jacobian of phi
+// R = I + a [phi]x + b [phi]x^2
+// Jr = I - b [phi]x + c [phi]x^2
+void ExpAndRightJacobian(const double phi[3], double R[9], double Jr[9]) {
+  double theta2 = phi[0] * phi[0] + phi[1] * phi[1] + phi[2] * phi[2];
+  double theta = std::sqrt(theta2);
+
+  // series expansions below 1e-4 rad keep full precision
+  double a, b, c;
+  if (theta < 1.0e-4) {
+    a = 1.0 - theta2 / 6.0;
+    b = 0.5 - theta2 / 24.0;
+    c = 1.0 / 6.0 - theta2 / 120.0;
+  } else {
+    a = std::sin(theta) / theta;
+    b = (1.0 - std::cos(theta)) / theta2;
+    c = (theta - std::sin(theta)) / (theta2 * theta);
+  }
+
+  double S[9];
+  double S2[9];
+  Skew(phi, S);
+  Mul(S, S, S2);
+
+  for (int k = 0; k < 9; k++) {
+    double eye = (k % 4 == 0) ? 1.0 : 0.0;
+    R[k] = eye + a * S[k] + b * S2[k];
+    Jr[k] = eye - b * S[k] + c * S2[k];
+  }
+}
+
+}  // namespace
+
+void ImuPreintegrator::Reset(double t0) {
+  preint_ = PreintegratedImu();
+  preint_.t0 = t0;
+  preint_.t1 = t0;
+}
+
+void ImuPreintegrator::Integrate(const double acc[3], const double gyro[3], double dt) {
+  if (dt <= 0.0) {
+    return;
+  }
+
+  PreintegratedImu& p = preint_;
+  double dt2 = dt * dt;
+
+  // rotated acceleration and its skew, using the rotation at the start of the step
+  double R_acc[3];
+  MulVec(p.delta_R, acc, R_acc);
+
+  double acc_skew[9];
+  double R_acc_skew[9];
+  double R_acc_skew_J[9];
+  Skew(acc, acc_skew);
+  Mul(p.delta_R, acc_skew, R_acc_skew);
+  Mul(R_acc_skew, p.d_R_d_bg, R_acc_skew_J);
+
+  // jacobians, position first since it uses the velocity jacobians of the previous step
+  for (int k = 0; k < 9; k++) {
+    p.d_p_d_ba[k] += p.d_v_d_ba[k] * dt - 0.5 * p.delta_R[k] * dt2;
+    p.d_p_d_bg[k] += p.d_v_d_bg[k] * dt - 0.5 * R_acc_skew_J[k] * dt2;
+    p.d_v_d_ba[k] -= p.delta_R[k] * dt;
+    p.d_v_d_bg[k] -= R_acc_skew_J[k] * dt;
+  }
+
+  // position and velocity
+  for (int j = 0; j < 3; j++) {
+    p.delta_p[j] += p.delta_v[j] * dt + 0.5 * R_acc[j] * dt2;
+    p.delta_v[j] += R_acc[j] * dt;
+  }
+
+  // rotation step
+  double phi[3] = {gyro[0] * dt, gyro[1] * dt, gyro[2] * dt};
+  double dR[9];
+  double Jr[9];
+  ExpAndRightJacobian(phi, dR, Jr);
+
+  // d_R_d_bg = dR^T * d_R_d_bg - Jr * dt
+  double tmp[9];
+  MulTransposed(dR, p.d_R_d_bg, tmp);
+  for (int k = 0; k < 9; k++) {
+    p.d_R_d_bg[k] = tmp[k] - Jr[k] * dt;
+  }
+
+  // delta_R = delta_R * dR
+  Mul(p.delta_R, dR, tmp);
+  for (int k = 0; k < 9; k++) {
+    p.delta_R[k] = tmp[k];
+  }
+
+  p.t1 += dt;
+}
+
+}  // namespace svis
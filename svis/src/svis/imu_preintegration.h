@@ -0,0 +1,46 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+namespace svis {
+
+// Imu preintegrated between two camera frames, following Forster et al.,
+// "On-Manifold Preintegration for Real-Time Visual-Inertial Odometry".
+// Deltas are expressed in the body frame at t0 and computed with zero bias.
+// Jacobians give the first order correction for a bias estimate, e.g.
+// delta_v(b) ~= delta_v + d_v_d_ba * ba + d_v_d_bg * bg.
+// 3x3 matrices are row major.
+struct PreintegratedImu {
+  bool valid = false;  // false if the imu history did not cover [t0, t1]
+  double t0 = 0.0;  // [seconds] previous frame in ros epoch
+  double t1 = 0.0;  // [seconds] this frame in ros epoch
+  int sample_count = 0;  // full rate imu samples inside [t0, t1]
+
+  double delta_R[9] = {1.0, 0.0, 0.0,
+                       0.0, 1.0, 0.0,
+                       0.0, 0.0, 1.0};  // rotation from body at t1 to body at t0
+  double delta_v[3] = {0.0};  // [m/s]
+  double delta_p[3] = {0.0};  // [m]
+
+  double d_R_d_bg[9] = {0.0};  // [rad / (rad/s)]
+  double d_v_d_ba[9] = {0.0};  // [(m/s) / (m/s^2)]
+  double d_v_d_bg[9] = {0.0};  // [(m/s) / (rad/s)]
+  double d_p_d_ba[9] = {0.0};  // [m / (m/s^2)]
+  double d_p_d_bg[9] = {0.0};  // [m / (rad/s)]
+};
+
+// accumulates piecewise constant imu steps into a PreintegratedImu
+class ImuPreintegrator {
+ public:
+  void Reset(double t0);
+
+  // acc [m/s^2] and gyro [rad/s] held over dt [seconds]
+  void Integrate(const double acc[3], const double gyro[3], double dt);
+
+  const PreintegratedImu& Get() const { return preint_; }
+
+ private:
+  PreintegratedImu preint_;
+};
+
+}  // namespace svis
@@ -0,0 +1,160 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include <algorithm>
+#include <cmath>
+
+#include "svis/imu_resampler.h"
+
+namespace svis {
+
+namespace {
+
+// alpha beta gains of the period tracker, beta = alpha^2/(2 - alpha) is critically damped
+// alpha = 0.02 cuts uniform stamp jitter by about 10x and settles the period in a few seconds
+const double alpha = 0.02;
+const double beta = alpha * alpha / (2.0 - alpha);
+
+// more missed samples than this, or a stamp this far off the nearest whole period, restarts
+// the grid, the error is at most half a period so the tolerance widens with the tracked
+// jitter only up to just short of that
+const double max_gap = 10.0;
+const double max_error = 0.25;  // [periods]
+const double max_error_jitter = 4.0;  // [tracked jitter]
+const double max_error_limit = 0.4;  // [periods]
+
+}  // namespace
+
+void ImuResampler::Configure(double rate, double input_rate, Method method) {
+  rate_ = rate;
+  input_rate_ = input_rate > 0.0 ? input_rate : 1000.0;
+  method_ = method;
+  Reset();
+}
+
+void ImuResampler::Reset() {
+  tracking_ = false;
+  period_est_ = 1.0 / input_rate_;
+  jitter_ = 0.0;
+  head_ = 0;
+  count_ = 0;
+}
+
+double ImuResampler::Dejitter(double t_raw) {
+  if (!tracking_) {
+    tracking_ = true;
+    t_est_ = t_raw;
+    return t_est_;
+  }
+
+  // missed samples show up as whole periods
+  double n = std::floor((t_raw - t_est_) / period_est_ + 0.5);
+  if (n < 1.0) {
+    n = 1.0;
+  }
+
+  double predicted = t_est_ + n * period_est_;
+  double error = t_raw - predicted;
+
+  t_est_ = predicted + alpha * error;
+  period_est_ += beta * error / n;
+  jitter_ += 0.01 * (std::abs(alpha * error - error) - jitter_);
+
+  return t_est_;
+}
+
+int ImuResampler::Push(const ImuPacket& imu, std::vector<ImuPacket>* imu_resampled) {
+  if (rate_ <= 0.0) {
+    return 0;
+  }
+
+  double t_raw = imu.timestamp_ros;
+
+  // restart across gaps, resets and clock model jumps instead of interpolating over them
+  if (tracking_) {
+    double steps = (t_raw - t_est_) / period_est_;
+    double error = steps - std::floor(steps + 0.5);
+    double tolerance = std::min(max_error_limit,
+                                std::max(max_error, max_error_jitter * jitter_ / period_est_));
+    if (steps < 0.5 || steps > max_gap || std::abs(error) > tolerance) {
+      Reset();
+    }
+  }
+
+  Sample sample;
+  sample.t = Dejitter(t_raw);
+  for (int j = 0; j < 3; j++) {
+    sample.v[j] = imu.acc[j];
+    sample.v[3 + j] = imu.gyro[j];
+  }
+
+  if (count_ < 4) {
+    window_[(head_ + count_) & 3] = sample;
+    count_++;
+  } else {
+    window_[head_] = sample;
+    head_ = (head_ + 1) & 3;
+  }
+  t_rx_ = imu.timestamp_ros_rx;
+
+  // first grid point at or after the first sample
+  if (count_ == 1) {
+    k_next_ = static_cast<int64_t>(std::ceil(sample.t * rate_));
+    return 0;
+  }
+
+  // interval [a, b] to fill, cubic waits one sample for the tangent at b
+  int ia = count_ - 2;
+  if (method_ == kCubic) {
+    if (count_ < 3) {
+      return 0;
+    }
+    ia = count_ - 3;
+  }
+  const Sample& a = At(ia);
+  const Sample& b = At(ia + 1);
+
+  int emitted = 0;
+  while (static_cast<double>(k_next_) / rate_ <= b.t) {
+    double t = static_cast<double>(k_next_) / rate_;
+    double s = (t - a.t) / (b.t - a.t);
+
+    ImuPacket out;
+    out.timestamp_ros_rx = t_rx_;
+    out.timestamp_ros = t;
+    float v[6];
+    if (method_ == kCubic) {
+      // one sided tangent at the first interval after a restart
+      const Sample& p0 = (ia > 0) ? At(ia - 1) : a;
+      const Sample& p3 = At(ia + 2);
+      double h = b.t - a.t;
+      double s2 = s * s;
+      double s3 = s2 * s;
+      double h00 = 2.0 * s3 - 3.0 * s2 + 1.0;
+      double h10 = s3 - 2.0 * s2 + s;
+      double h01 = -2.0 * s3 + 3.0 * s2;
+      double h11 = s3 - s2;
+      for (int j = 0; j < 6; j++) {
+        double m0 = (b.v[j] - p0.v[j]) / (b.t - p0.t);
+        double m1 = (p3.v[j] - a.v[j]) / (p3.t - a.t);
+        v[j] = static_cast<float>(h00 * a.v[j] + h10 * h * m0 + h01 * b.v[j] + h11 * h * m1);
+      }
+    } else {
+      for (int j = 0; j < 6; j++) {
+        v[j] = static_cast<float>(a.v[j] + s * (b.v[j] - a.v[j]));
+      }
+    }
+
+    for (int j = 0; j < 3; j++) {
+      out.acc[j] = v[j];
+      out.gyro[j] = v[3 + j];
+    }
+    imu_resampled->push_back(out);
+
+    k_next_++;
+    emitted++;
+  }
+
+  return emitted;
+}
+
+}  // namespace svis
@@ -0,0 +1,69 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "svis/imu_packet.h"
+
+namespace svis {
+
+// Streaming resampler from the full rate imu onto an exact grid in ros time,
+// t = k / rate.  Input stamps come from micros() in the teensy sample isr and
+// jitter by tens of microseconds, so they are first smoothed with an alpha
+// beta tracker of the sample period before interpolating.
+//
+// Only the last four input samples are kept, and outputs are appended to a
+// caller owned vector, so steady state operation does not allocate.
+class ImuResampler {
+ public:
+  enum Method {
+    kLinear,
+    kCubic,  // hermite with finite difference tangents, one sample more latency
+  };
+
+  // rate [Hz] of the output grid
+  // input_rate [Hz] nominal imu rate, used to start the period tracker
+  void Configure(double rate, double input_rate, Method method);
+  void Reset();
+
+  // appends every grid sample that is now bracketed by the input
+  // returns the number appended
+  int Push(const ImuPacket& imu, std::vector<ImuPacket>* imu_resampled);
+
+  double GetPeriod() const { return period_est_; }  // [seconds] tracked input period
+  double GetJitter() const { return jitter_; }  // [seconds] mean abs stamp correction
+
+ private:
+  struct Sample {
+    double t;  // [seconds] smoothed ros time
+    float v[6];  // [ax, ay, az, gx, gy, gz]
+  };
+
+  double Dejitter(double t_raw);
+
+  const Sample& At(int i) const { return window_[(head_ + i) & 3]; }  // i = 0 is oldest
+
+  double rate_ = 0.0;
+  double input_rate_ = 1000.0;
+  Method method_ = kLinear;
+
+  // period tracker
+  bool tracking_ = false;
+  double t_est_ = 0.0;  // [seconds] smoothed stamp of the last input
+  double period_est_ = 0.001;  // [seconds]
+  double jitter_ = 0.0;
+
+  // last four smoothed inputs
+  Sample window_[4];
+  int head_ = 0;
+  int count_ = 0;
+  double t_rx_ = 0.0;  // [seconds] receive time of the last input
+
+  // next grid index, t = k / rate
+  int64_t k_next_ = 0;
+};
+
+}  // namespace svis
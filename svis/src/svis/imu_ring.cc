@@ -0,0 +1,72 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include "svis/imu_ring.h"
+
+namespace svis {
+
+ImuRing::ImuRing(std::size_t capacity) {
+  SetCapacity(capacity);
+}
+
+void ImuRing::SetCapacity(std::size_t capacity) {
+  std::size_t n = 1;
+  while (n < capacity) {
+    n <<= 1;
+  }
+
+  timestamp_.assign(n, 0);
+  for (int j = 0; j < 3; j++) {
+    acc_raw_[j].assign(n, 0);
+    gyro_raw_[j].assign(n, 0);
+  }
+  sens_.assign(n, 0);
+
+  mask_ = n - 1;
+  Clear();
+}
+
+void ImuRing::Clear() {
+  head_ = 0;
+  size_ = 0;
+}
+
+bool ImuRing::PushBack(const ImuSample& sample) {
+  bool overwrite = full();
+  if (overwrite) {
+    PopFront();
+  }
+
+  std::size_t k = Index(size_);
+  timestamp_[k] = sample.timestamp_teensy;
+  for (int j = 0; j < 3; j++) {
+    acc_raw_[j][k] = sample.acc_raw[j];
+    gyro_raw_[j][k] = sample.gyro_raw[j];
+  }
+  sens_[k] = static_cast<uint8_t>((sample.acc_sens << 4) | (sample.gyro_sens & 0x0F));
+  size_++;
+
+  return !overwrite;
+}
+
+void ImuRing::PopFront(std::size_t n) {
+  if (n > size_) {
+    n = size_;
+  }
+  head_ = (head_ + n) & mask_;
+  size_ -= n;
+}
+
+ImuSample ImuRing::Get(std::size_t i) const {
+  std::size_t k = Index(i);
+  ImuSample sample;
+  sample.timestamp_teensy = timestamp_[k];
+  for (int j = 0; j < 3; j++) {
+    sample.acc_raw[j] = acc_raw_[j][k];
+    sample.gyro_raw[j] = gyro_raw_[j][k];
+  }
+  sample.acc_sens = sens_[k] >> 4;
+  sample.gyro_sens = sens_[k] & 0x0F;
+  return sample;
+}
+
+}  // namespace svis
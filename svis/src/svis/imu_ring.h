@@ -0,0 +1,58 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "svis/imu_sample.h"
+
+namespace svis {
+
+// Fixed capacity ring of ImuSample stored as structure of arrays.  The
+// capacity is rounded up to a power of two so indexing is a mask, and a full
+// ring overwrites its oldest sample like boost::circular_buffer.
+class ImuRing {
+ public:
+  explicit ImuRing(std::size_t capacity = 0);
+
+  // rounds up to a power of two and clears the ring
+  void SetCapacity(std::size_t capacity);
+
+  std::size_t capacity() const { return mask_ + 1; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  bool full() const { return size_ == capacity(); }
+  void Clear();
+
+  // returns false if the oldest sample was overwritten
+  bool PushBack(const ImuSample& sample);
+  void PopFront(std::size_t n = 1);
+
+  // i = 0 is the oldest sample
+  ImuSample Get(std::size_t i) const;
+  ImuSample front() const { return Get(0); }
+  ImuSample back() const { return Get(size_ - 1); }
+
+  uint64_t GetTimestamp(std::size_t i) const { return timestamp_[Index(i)]; }
+  int16_t GetAccRaw(std::size_t i, int axis) const { return acc_raw_[axis][Index(i)]; }
+  int16_t GetGyroRaw(std::size_t i, int axis) const { return gyro_raw_[axis][Index(i)]; }
+  uint8_t GetAccSens(std::size_t i) const { return sens_[Index(i)] >> 4; }
+  uint8_t GetGyroSens(std::size_t i) const { return sens_[Index(i)] & 0x0F; }
+
+ private:
+  std::size_t Index(std::size_t i) const { return (head_ + i) & mask_; }
+
+  std::vector<uint64_t> timestamp_;  // [microseconds]
+  std::vector<int16_t> acc_raw_[3];
+  std::vector<int16_t> gyro_raw_[3];
+  std::vector<uint8_t> sens_;  // (acc_sens << 4) | gyro_sens
+
+  std::size_t head_ = 0;  // oldest sample
+  std::size_t size_ = 0;
+  std::size_t mask_ = 0;
+};
+
+}  // namespace svis
@@ -0,0 +1,55 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+namespace svis {
+
+// Compact raw imu sample used for internal storage.  Conversion to SI units
+// and ros time happens only when an ImuPacket is published.
+struct ImuSample {
+  uint64_t timestamp_teensy = 0;  // [microseconds] unwrapped teensy epoch
+  int16_t acc_raw[3] = {0};  // counts
+  int16_t gyro_raw[3] = {0};  // counts
+  uint8_t acc_sens = 0;  // acc sensitivity selection [0,3] when sampled
+  uint8_t gyro_sens = 0;  // gyro sensitivity selection [0,3] when sampled
+};
+
+static_assert(sizeof(ImuSample) <= 24, "ImuSample should stay compact");
+
+// extends the 32 bit teensy micros() stamps (71 minute wrap) to 64 bits
+// stamps may arrive slightly out of order, e.g. strobes and imu samples
+class StampUnwrapper {
+ public:
+  uint64_t Unwrap(uint32_t stamp) {
+    if (!has_last_) {
+      has_last_ = true;
+      last_raw_ = stamp;
+      last_ = stamp;
+      return last_;
+    }
+
+    int64_t unwrapped = static_cast<int64_t>(last_) + static_cast<int32_t>(stamp - last_raw_);
+    if (unwrapped < 0) {
+      unwrapped = 0;
+    }
+    if (static_cast<uint64_t>(unwrapped) > last_) {
+      last_raw_ = stamp;
+      last_ = unwrapped;
+    }
+
+    return static_cast<uint64_t>(unwrapped);
+  }
+
+  void Reset() {
+    has_last_ = false;
+  }
+
+ private:
+  bool has_last_ = false;
+  uint32_t last_raw_ = 0;
+  uint64_t last_ = 0;
+};
+
+}  // namespace svis
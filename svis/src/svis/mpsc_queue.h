@@ -0,0 +1,105 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace svis {
+
+// Bounded lock-free queue for many producers and a single consumer, after
+// Dmitry Vyukov's bounded MPMC queue.  Each cell carries a sequence number
+// that tells producers and the consumer whose turn it is, so a push or pop is
+// one compare and swap at most and never blocks on the other side.
+//
+// Producers may call TryPush from any thread.  TryPop must only be called
+// from one thread.  SetCapacity is not thread safe and must happen before
+// any producer starts.
+template <typename T>
+class MpscQueue {
+ public:
+  explicit MpscQueue(std::size_t capacity = 2) {
+    SetCapacity(capacity);
+  }
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  // rounds up to a power of two and drops any queued values
+  void SetCapacity(std::size_t capacity) {
+    std::size_t n = 2;
+    while (n < capacity) {
+      n <<= 1;
+    }
+
+    cells_.reset(new Cell[n]);
+    for (std::size_t i = 0; i < n; i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    mask_ = n - 1;
+    enqueue_pos_.store(0, std::memory_order_relaxed);
+    dequeue_pos_ = 0;
+  }
+
+  std::size_t capacity() const { return mask_ + 1; }
+
+  // returns false and leaves value untouched if the queue is full
+  bool TryPush(T&& value) {
+    Cell* cell = nullptr;
+    std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[pos & mask_];
+      std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        // cell is free for this position, claim it
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // consumer has not freed the cell a lap ago
+        return false;
+      } else {
+        // another producer claimed it first
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->value = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // returns false if the queue is empty, consumer thread only
+  bool TryPop(T* value) {
+    Cell* cell = &cells_[dequeue_pos_ & mask_];
+    std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    if (sequence != dequeue_pos_ + 1) {
+      return false;
+    }
+
+    *value = std::move(cell->value);
+    cell->sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+    dequeue_pos_++;
+    return true;
+  }
+
+ private:
+  struct Cell {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<Cell[]> cells_;
+  std::size_t mask_ = 0;
+
+  // producers and the consumer write different cache lines
+  alignas(64) std::atomic<std::size_t> enqueue_pos_{0};
+  alignas(64) std::size_t dequeue_pos_ = 0;  // consumer only
+};
+
+}  // namespace svis
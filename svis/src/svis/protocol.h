@@ -0,0 +1,388 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Report and command layouts shared by the teensy firmware and the host.
+// This header is compiled by both toolchains (gcc 4.8 for the teensy), so it
+// is limited to C++11 constexpr and must stay free of STL or OS dependencies.
+//
+// Offsets are compile time constants and fields are read and written with
+// fixed size memcpy, which the compiler turns into single unaligned loads and
+// stores.  All multi-byte fields are little endian on both ends.
+
+namespace svis {
+namespace protocol {
+
+template <typename T>
+inline T Load(const uint8_t* buf, int index) {
+  T value;
+  memcpy(&value, &buf[index], sizeof(T));
+  return value;
+}
+
+template <typename T>
+inline void Store(uint8_t* buf, int index, T value) {
+  memcpy(&buf[index], &value, sizeof(T));
+}
+
+/* data report structure
+[0-1]: send_count
+[2]: imu_count, or a marker for the special reports below
+[3]: strobe_count
+[4-...]: imu packets (imu_stamp[0-3], ax, ay, az, gx, gy, gz)
+[...]: strobe packets (strobe_stamp[0-3], strobe_count)
+[report_size - 2, report_size - 1]: checksum
+*/
+template <int ReportSize, int ImuSlots, int StrobeSlots>
+struct ReportLayout {
+  static constexpr int report_size = ReportSize;  // (int8_t)
+  static constexpr int imu_slots = ImuSlots;
+  static constexpr int strobe_slots = StrobeSlots;
+
+  // header
+  static constexpr int send_count_index = 0;  // (uint16_t)
+  static constexpr int imu_count_index = 2;  // (uint8_t)
+  static constexpr int strobe_count_index = 3;  // (uint8_t)
+  static constexpr int header_size = 4;
+
+  // imu packet
+  static constexpr int imu_axis_count = 6;  // (int16_t) [ax, ay, az, gx, gy, gz]
+  static constexpr int imu_packet_size = sizeof(uint32_t) + imu_axis_count*sizeof(int16_t);
+  static constexpr int imu_offset = header_size;
+
+  // strobe packet
+  static constexpr int strobe_packet_size = sizeof(uint32_t) + sizeof(uint8_t);
+  static constexpr int strobe_offset = imu_offset + imu_slots*imu_packet_size;
+
+  // checksum
+  static constexpr int checksum_index = report_size - sizeof(uint16_t);
+
+  static_assert(strobe_offset + strobe_slots*strobe_packet_size <= checksum_index,
+                "report data overlaps the checksum");
+  static_assert(imu_slots < 0xAB, "imu_count collides with the report markers");
+
+  static constexpr int ImuIndex(int i) {
+    return imu_offset + i*imu_packet_size;
+  }
+
+  static constexpr int ImuAxisIndex(int i, int axis) {
+    return ImuIndex(i) + sizeof(uint32_t) + axis*sizeof(int16_t);
+  }
+
+  static constexpr int StrobeIndex(int i) {
+    return strobe_offset + i*strobe_packet_size;
+  }
+
+  static constexpr int StrobeCountIndex(int i) {
+    return StrobeIndex(i) + sizeof(uint32_t);
+  }
+};
+
+// 64 byte rawhid report
+typedef ReportLayout<64, 3, 2> HidReport;
+static_assert(HidReport::ImuIndex(1) == 20 && HidReport::StrobeIndex(0) == 52 &&
+              HidReport::StrobeIndex(1) == 57 && HidReport::checksum_index == 62,
+              "hid report layout changed");
+
+// serial report, the cdc bulk endpoint is not limited to 64 bytes so each
+// report carries enough imu slots for 8 kHz at one report per usb frame
+typedef ReportLayout<256, 15, 2> SerialReport;
+
+// reports go out at most once per 1 ms usb frame
+const int kReportRate = 1000;  // [Hz]
+
+// markers sent in place of imu_count
+const uint8_t kAckMarker = 0xAC;
+const uint8_t kClockMarker = 0xAD;
+const uint8_t kStatusMarker = 0xAE;
+
+// ack report
+// [send_count[0], send_count[1], 0xAC, request_id, command, status, stamp[0], ... , stamp[3]]
+struct AckReport {
+  static constexpr int request_id_index = 3;  // (uint8_t)
+  static constexpr int command_index = 4;  // (uint8_t)
+  static constexpr int status_index = 5;  // (uint8_t)
+  static constexpr int stamp_index = 6;  // (uint32_t) [microseconds] when the command took effect
+};
+
+// clock report
+// [send_count[0], send_count[1], 0xAD, sof_count, (frame[0], frame[1], stamp[0], ... , stamp[3]) x sof_count]
+struct ClockReport {
+  static constexpr int count_index = 3;  // (uint8_t)
+  static constexpr int pair_offset = 4;
+  static constexpr int pair_size = sizeof(uint16_t) + sizeof(uint32_t);
+  static constexpr int pair_slots = 8;
+
+  static constexpr int FrameIndex(int i) {
+    return pair_offset + i*pair_size;
+  }
+
+  static constexpr int StampIndex(int i) {
+    return FrameIndex(i) + sizeof(uint16_t);
+  }
+};
+static_assert(ClockReport::pair_offset + ClockReport::pair_slots*ClockReport::pair_size <=
+              HidReport::checksum_index, "clock report overlaps the checksum");
+
+// status report, once a second
+// [send_count[0], send_count[1], 0xAE, 0, imu_overflow[0-3], strobe_overflow[0-3], sof_overflow[0-3],
+//  imu_capacity[0-1], imu_high_water[0-1], strobe_capacity[0-1], strobe_high_water[0-1], send_errors[0-3],
+//  journal_drops[0-3], session[0-3]]
+// counters are cumulative since setup, the session changes whenever the send
+// count and the journal start over
+struct StatusReport {
+  static constexpr int imu_overflow_index = 4;  // (uint32_t) samples dropped by a full imu ring
+  static constexpr int strobe_overflow_index = 8;  // (uint32_t)
+  static constexpr int sof_overflow_index = 12;  // (uint32_t)
+  static constexpr int imu_capacity_index = 16;  // (uint16_t)
+  static constexpr int imu_high_water_index = 18;  // (uint16_t)
+  static constexpr int strobe_capacity_index = 20;  // (uint16_t)
+  static constexpr int strobe_high_water_index = 22;  // (uint16_t)
+  static constexpr int send_errors_index = 24;  // (uint32_t) reports dropped without a usb host
+  static constexpr int journal_drops_index = 28;  // (uint32_t) data reports the journal could not keep
+  static constexpr int session_index = 32;  // (uint32_t) never zero
+  static constexpr int size = 36;
+};
+static_assert(StatusReport::size <= HidReport::checksum_index, "status report overlaps the checksum");
+
+// host to teensy packets
+// setup: [0xAB, type, ...]
+// command: [0xAC, request_id, command, payload...]
+const uint8_t kSetupHeader = 0xAB;
+// resets if already setup, the send count and journal carry on unless the ranges change
+const uint8_t kSetupConfigure = 0;  // [0xAB, 0, camera_rate, fs_sel, afs_sel]
+const uint8_t kSetupPulse = 2;
+const uint8_t kSetupDisablePulse = 3;
+const uint8_t kSetupBurst = 4;  // [0xAB, 4, count, gap[0], ..., gap[count - 2]], gaps in trigger periods
+const int kBurstCountIndex = 2;
+const int kBurstGapIndex = 3;
+const int kBurstMaxCount = 8;
+
+const uint8_t kCommandHeader = 0xAC;
+const int kCommandRequestIdIndex = 1;
+const int kCommandIndex = 2;
+const int kCommandPayloadIndex = 3;
+const uint8_t kCommandCameraRate = 1;  // (uint16_t) [Hz]
+const uint8_t kCommandImuRange = 2;  // (uint8_t) [fs_sel, afs_sel]
+const uint8_t kCommandImuRate = 3;  // (uint16_t) [Hz] up to 1 kHz on i2c, 8 kHz on spi
+const uint8_t kCommandImuDlpf = 4;  // (uint8_t) dlpf_cfg, 0 and 7 run at 8 kHz and are decimated to the rate
+const uint8_t kCommandTriggerDuration = 5;  // (uint32_t) [microseconds]
+const uint8_t kCommandBackfill = 6;  // (uint16_t, uint16_t) [first send_count, report count] replay from the journal
+const uint8_t kCommandResume = 7;  // (uint32_t, uint16_t) [session, last send_count] acked ok if the journal still follows it
+
+const uint8_t kAckOk = 0;
+const uint8_t kAckBadCommand = 1;
+const uint8_t kAckBadArgument = 2;
+const uint8_t kAckNotSetup = 3;
+const uint8_t kAckNoJournal = 4;  // backfill or resume without a journal
+
+// additive checksum of every byte before the checksum field
+template <typename Layout>
+inline uint16_t Checksum(const uint8_t* buf) {
+  uint16_t checksum = 0;
+  for (int i = 0; i < Layout::checksum_index; i++) {
+    checksum += buf[i];
+  }
+  return checksum;
+}
+
+// firmware side report writer
+template <typename Layout>
+class ReportEncoder {
+ public:
+  explicit ReportEncoder(uint8_t* buf) : buf_(buf) {}
+
+  // the firmware assembles each report in whichever buffer is free
+  void SetBuffer(uint8_t* buf) {
+    buf_ = buf;
+  }
+
+  void Clear() {
+    memset(buf_, 0, Layout::report_size);
+  }
+
+  void SetSendCount(uint16_t send_count) {
+    Store<uint16_t>(buf_, Layout::send_count_index, send_count);
+  }
+
+  void SetImuCount(uint8_t imu_count) {
+    buf_[Layout::imu_count_index] = imu_count;
+  }
+
+  void SetMarker(uint8_t marker) {
+    buf_[Layout::imu_count_index] = marker;
+  }
+
+  void SetStrobeCount(uint8_t strobe_count) {
+    buf_[Layout::strobe_count_index] = strobe_count;
+  }
+
+  // packet is the stamp followed by the axes, as stored in the imu ring
+  void SetImuPacket(int i, const void* packet) {
+    memcpy(&buf_[Layout::ImuIndex(i)], packet, Layout::imu_packet_size);
+  }
+
+  void SetImu(int i, uint32_t stamp, const int16_t* axes) {
+    Store<uint32_t>(buf_, Layout::ImuIndex(i), stamp);
+    memcpy(&buf_[Layout::ImuAxisIndex(i, 0)], axes, Layout::imu_axis_count*sizeof(int16_t));
+  }
+
+  void SetStrobe(int i, uint32_t stamp, uint8_t count) {
+    Store<uint32_t>(buf_, Layout::StrobeIndex(i), stamp);
+    buf_[Layout::StrobeCountIndex(i)] = count;
+  }
+
+  void SetAck(uint8_t request_id, uint8_t command, uint8_t status, uint32_t stamp) {
+    SetMarker(kAckMarker);
+    buf_[AckReport::request_id_index] = request_id;
+    buf_[AckReport::command_index] = command;
+    buf_[AckReport::status_index] = status;
+    Store<uint32_t>(buf_, AckReport::stamp_index, stamp);
+  }
+
+  void SetClockCount(uint8_t count) {
+    SetMarker(kClockMarker);
+    buf_[ClockReport::count_index] = count;
+  }
+
+  void SetClockPair(int i, uint16_t frame, uint32_t stamp) {
+    Store<uint16_t>(buf_, ClockReport::FrameIndex(i), frame);
+    Store<uint32_t>(buf_, ClockReport::StampIndex(i), stamp);
+  }
+
+  void SetStatus(uint32_t imu_overflow, uint32_t strobe_overflow, uint32_t sof_overflow,
+                 uint16_t imu_capacity, uint16_t imu_high_water,
+                 uint16_t strobe_capacity, uint16_t strobe_high_water, uint32_t send_errors,
+                 uint32_t journal_drops, uint32_t session) {
+    SetMarker(kStatusMarker);
+    Store<uint32_t>(buf_, StatusReport::imu_overflow_index, imu_overflow);
+    Store<uint32_t>(buf_, StatusReport::strobe_overflow_index, strobe_overflow);
+    Store<uint32_t>(buf_, StatusReport::sof_overflow_index, sof_overflow);
+    Store<uint16_t>(buf_, StatusReport::imu_capacity_index, imu_capacity);
+    Store<uint16_t>(buf_, StatusReport::imu_high_water_index, imu_high_water);
+    Store<uint16_t>(buf_, StatusReport::strobe_capacity_index, strobe_capacity);
+    Store<uint16_t>(buf_, StatusReport::strobe_high_water_index, strobe_high_water);
+    Store<uint32_t>(buf_, StatusReport::send_errors_index, send_errors);
+    Store<uint32_t>(buf_, StatusReport::journal_drops_index, journal_drops);
+    Store<uint32_t>(buf_, StatusReport::session_index, session);
+  }
+
+  // call last
+  void Finish() {
+    Store<uint16_t>(buf_, Layout::checksum_index, Checksum<Layout>(buf_));
+  }
+
+  uint8_t* data() { return buf_; }
+
+ private:
+  uint8_t* buf_;
+};
+
+// host side report reader
+template <typename Layout>
+class ReportDecoder {
+ public:
+  explicit ReportDecoder(const uint8_t* buf) : buf_(buf) {}
+
+  bool ChecksumOk() const {
+    return Checksum<Layout>(buf_) == GetChecksum();
+  }
+
+  uint16_t GetChecksum() const {
+    return Load<uint16_t>(buf_, Layout::checksum_index);
+  }
+
+  uint16_t GetSendCount() const {
+    return Load<uint16_t>(buf_, Layout::send_count_index);
+  }
+
+  uint8_t GetMarker() const {
+    return buf_[Layout::imu_count_index];
+  }
+
+  bool IsAck() const {
+    return GetMarker() == kAckMarker;
+  }
+
+  bool IsClock() const {
+    return GetMarker() == kClockMarker;
+  }
+
+  bool IsStatus() const {
+    return GetMarker() == kStatusMarker;
+  }
+
+  // clamped to the slots in the layout
+  int GetImuCount() const {
+    int count = buf_[Layout::imu_count_index];
+    if (count > Layout::imu_slots) {
+      count = Layout::imu_slots;
+    }
+    return count;
+  }
+
+  int GetStrobeCount() const {
+    int count = buf_[Layout::strobe_count_index];
+    if (count > Layout::strobe_slots) {
+      count = Layout::strobe_slots;
+    }
+    return count;
+  }
+
+  uint32_t GetImuStamp(int i) const {
+    return Load<uint32_t>(buf_, Layout::ImuIndex(i));
+  }
+
+  int16_t GetImuAxis(int i, int axis) const {
+    return Load<int16_t>(buf_, Layout::ImuAxisIndex(i, axis));
+  }
+
+  uint32_t GetStrobeStamp(int i) const {
+    return Load<uint32_t>(buf_, Layout::StrobeIndex(i));
+  }
+
+  uint8_t GetStrobeCountValue(int i) const {
+    return buf_[Layout::StrobeCountIndex(i)];
+  }
+
+  uint8_t GetAckRequestId() const { return buf_[AckReport::request_id_index]; }
+  uint8_t GetAckCommand() const { return buf_[AckReport::command_index]; }
+  uint8_t GetAckStatus() const { return buf_[AckReport::status_index]; }
+  uint32_t GetAckStamp() const { return Load<uint32_t>(buf_, AckReport::stamp_index); }
+
+  int GetClockCount() const {
+    int count = buf_[ClockReport::count_index];
+    if (count > ClockReport::pair_slots) {
+      count = ClockReport::pair_slots;
+    }
+    return count;
+  }
+
+  uint16_t GetClockFrame(int i) const {
+    return Load<uint16_t>(buf_, ClockReport::FrameIndex(i));
+  }
+
+  uint32_t GetClockStamp(int i) const {
+    return Load<uint32_t>(buf_, ClockReport::StampIndex(i));
+  }
+
+  uint32_t GetImuOverflow() const { return Load<uint32_t>(buf_, StatusReport::imu_overflow_index); }
+  uint32_t GetStrobeOverflow() const { return Load<uint32_t>(buf_, StatusReport::strobe_overflow_index); }
+  uint32_t GetSofOverflow() const { return Load<uint32_t>(buf_, StatusReport::sof_overflow_index); }
+  uint16_t GetImuCapacity() const { return Load<uint16_t>(buf_, StatusReport::imu_capacity_index); }
+  uint16_t GetImuHighWater() const { return Load<uint16_t>(buf_, StatusReport::imu_high_water_index); }
+  uint16_t GetStrobeCapacity() const { return Load<uint16_t>(buf_, StatusReport::strobe_capacity_index); }
+  uint16_t GetStrobeHighWater() const { return Load<uint16_t>(buf_, StatusReport::strobe_high_water_index); }
+  uint32_t GetSendErrors() const { return Load<uint32_t>(buf_, StatusReport::send_errors_index); }
+  uint32_t GetJournalDrops() const { return Load<uint32_t>(buf_, StatusReport::journal_drops_index); }
+  uint32_t GetSession() const { return Load<uint32_t>(buf_, StatusReport::session_index); }
+
+ private:
+  const uint8_t* buf_;
+};
+
+}  // namespace protocol
+}  // namespace svis
@@ -0,0 +1,108 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include "svis/report_sequencer.h"
+
+namespace svis {
+
+ReportSequencer::ReportSequencer()
+  : backfill_pending_(65536, false) {
+}
+
+void ReportSequencer::Reset() {
+  has_send_count_ = false;
+  backfill_enabled_ = true;
+  backfill_ranges_.clear();
+  backfill_pending_.assign(backfill_pending_.size(), false);
+}
+
+void ReportSequencer::Resume(uint16_t send_count) {
+  if (!has_send_count_) {
+    has_send_count_ = true;
+    first_send_count_ = send_count;
+    last_send_count_ = send_count;
+    return;
+  }
+
+  int16_t step = static_cast<int16_t>(first_send_count_ - send_count);
+  if (step > 1) {
+    RequestBackfill(send_count + 1, step - 1);
+  }
+}
+
+void ReportSequencer::DisableBackfill() {
+  backfill_enabled_ = false;
+  backfill_ranges_.clear();
+}
+
+ReportSequencer::Order ReportSequencer::Sequence(uint16_t send_count) {
+  // reports at or before the last send count are replays from the journal,
+  // merged ranges also replay reports that arrived live
+  int16_t step = static_cast<int16_t>(send_count - last_send_count_);
+  if (has_send_count_ && step <= 0) {
+    if (!backfill_pending_[send_count]) {
+      return kDuplicate;
+    }
+    backfill_pending_[send_count] = false;
+    return kReplay;
+  }
+
+  // reports past the next one mean the ones between were lost
+  if (has_send_count_ && step > 1) {
+    RequestBackfill(last_send_count_ + 1, step - 1);
+  }
+  if (!has_send_count_) {
+    first_send_count_ = send_count;
+  }
+  has_send_count_ = true;
+  last_send_count_ = send_count;
+  backfill_pending_[send_count] = false;
+  return kLive;
+}
+
+void ReportSequencer::RequestBackfill(uint16_t first, uint16_t count) {
+  lost_count_ += count;
+  if (!backfill_enabled_) {
+    return;
+  }
+
+  requested_count_ += count;
+  for (uint16_t i = 0; i < count; i++) {
+    backfill_pending_[static_cast<uint16_t>(first + i)] = true;
+  }
+
+  // the oldest gaps are the first the journal forgets
+  backfill_ranges_.push_back(std::make_pair(first, count));
+  if (backfill_ranges_.size() > backfill_ranges_max_) {
+    backfill_ranges_.pop_front();
+  }
+}
+
+bool ReportSequencer::NextBackfill(double t_now, uint16_t* first, uint16_t* count) {
+  if (backfill_ranges_.empty() || t_now - t_backfill_ < backfill_period_) {
+    return false;
+  }
+
+  *first = backfill_ranges_.front().first;
+  *count = backfill_ranges_.front().second;
+  backfill_ranges_.pop_front();
+  t_backfill_ = t_now;
+  return true;
+}
+
+bool ReportSequencer::HasSendCount() const {
+  return has_send_count_;
+}
+
+uint16_t ReportSequencer::GetLastSendCount() const {
+  return last_send_count_;
+}
+
+uint64_t ReportSequencer::GetLostCount() const {
+  return lost_count_;
+}
+
+uint64_t ReportSequencer::GetRequestedCount() const {
+  return requested_count_;
+}
+
+}  // namespace svis
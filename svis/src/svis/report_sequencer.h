@@ -0,0 +1,74 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace svis {
+
+// Orders teensy reports by their 16 bit send count and requests the ones lost
+// on the way from the teensy journal.
+//
+// The teensy never drops a report once it is queued, so a report past the
+// next send count means the ones between only went to its journal.  Those
+// gaps are requested again, one range per backfill period so the acks never
+// crowd out the live reports, and the replays arrive at or behind the last
+// send count.  The teensy merges requests it has no room for into wider
+// ranges, so a replay is only kept while its send count is still missing.
+//
+// No usb here, so the firmware simulation runs the same sequencing.
+class ReportSequencer {
+ public:
+  enum Order {
+    kLive,  // the next report, possibly after a gap
+    kReplay,  // a missing report replayed from the journal
+    kDuplicate,  // a replay of a report already received
+  };
+
+  ReportSequencer();
+
+  // the teensy starts its send count over
+  void Reset();
+
+  // the reports after send_count, from before a reset or a host restart, are
+  // still in the teensy journal, the ones missing up to the first report since
+  // the reset are requested
+  void Resume(uint16_t send_count);
+
+  // the teensy has no journal, stop requesting gaps
+  void DisableBackfill();
+
+  Order Sequence(uint16_t send_count);
+
+  // the next range to request, at most one per backfill period
+  // t_now is host time [s]
+  bool NextBackfill(double t_now, uint16_t* first, uint16_t* count);
+
+  bool HasSendCount() const;
+  uint16_t GetLastSendCount() const;
+  uint64_t GetLostCount() const;  // reports missing from the sequence
+  uint64_t GetRequestedCount() const;  // reports requested from the journal
+
+  // params
+  std::size_t backfill_ranges_max_ = 16;
+  double backfill_period_ = 0.05;  // [s]
+
+ private:
+  void RequestBackfill(uint16_t first, uint16_t count);
+
+  bool has_send_count_ = false;
+  uint16_t first_send_count_ = 0;  // since the reset
+  uint16_t last_send_count_ = 0;
+  bool backfill_enabled_ = true;
+  std::deque<std::pair<uint16_t, uint16_t>> backfill_ranges_;  // [first send_count, count]
+  std::vector<bool> backfill_pending_;  // requested send counts not yet replayed
+  double t_backfill_ = 0.0;  // [s]
+  uint64_t lost_count_ = 0;
+  uint64_t requested_count_ = 0;
+};
+
+}  // namespace svis
@@ -0,0 +1,183 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "svis/cobs.h"
+#include "svis/serial_port.h"
+
+namespace svis {
+
+SerialPort::SerialPort()
+  : rx_buffer_(rx_buffer_size_, 0),
+    tx_payload_(max_frame_size_ + 2, 0),
+    tx_buffer_(CobsMaxEncodedSize(max_frame_size_ + 2) + 2, 0) {
+}
+
+SerialPort::~SerialPort() {
+  Close();
+}
+
+bool SerialPort::Open(const std::string& device) {
+  Close();
+
+  fd_ = open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd_ < 0) {
+    printf("(svis) Failed to open %s: %s\n", device.c_str(), strerror(errno));
+    return false;
+  }
+
+  // raw mode, the baud rate is ignored by the cdc acm driver
+  struct termios tty;
+  if (tcgetattr(fd_, &tty) != 0) {
+    printf("(svis) Failed to get attributes for %s\n", device.c_str());
+    Close();
+    return false;
+  }
+  cfmakeraw(&tty);
+  tty.c_cflag |= (CLOCAL | CREAD);
+  tty.c_cc[VMIN] = 0;
+  tty.c_cc[VTIME] = 0;
+  if (tcsetattr(fd_, TCSANOW, &tty) != 0) {
+    printf("(svis) Failed to set attributes for %s\n", device.c_str());
+    Close();
+    return false;
+  }
+  tcflush(fd_, TCIOFLUSH);
+
+  rx_head_ = 0;
+  rx_tail_ = 0;
+  frame_errors_ = 0;
+
+  return true;
+}
+
+void SerialPort::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool SerialPort::IsOpen() const {
+  return fd_ >= 0;
+}
+
+int SerialPort::Read(int timeout) {
+  if (fd_ < 0) {
+    return -1;
+  }
+
+  // move any partial frame to the front of the buffer
+  if (rx_head_ > 0) {
+    std::memmove(&rx_buffer_[0], &rx_buffer_[rx_head_], rx_tail_ - rx_head_);
+    rx_tail_ -= rx_head_;
+    rx_head_ = 0;
+  }
+
+  // drop garbage that never terminated
+  if (rx_tail_ == rx_buffer_.size()) {
+    frame_errors_++;
+    rx_tail_ = 0;
+  }
+
+  struct pollfd pfd;
+  pfd.fd = fd_;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  int r = poll(&pfd, 1, timeout);
+  if (r < 0) {
+    return (errno == EINTR) ? 0 : -1;
+  } else if (r == 0) {
+    return 0;
+  } else if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+    return -1;
+  }
+
+  ssize_t num = read(fd_, &rx_buffer_[rx_tail_], rx_buffer_.size() - rx_tail_);
+  if (num < 0) {
+    return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+  } else if (num == 0) {
+    // readable with no data means the device went away
+    return -1;
+  }
+  rx_tail_ += num;
+
+  return static_cast<int>(num);
+}
+
+bool SerialPort::NextFrame(const uint8_t** frame, std::size_t* len) {
+  while (rx_head_ < rx_tail_) {
+    uint8_t* start = &rx_buffer_[rx_head_];
+    uint8_t* end = static_cast<uint8_t*>(
+      std::memchr(start, kCobsDelimiter, rx_tail_ - rx_head_));
+    if (end == nullptr) {
+      // incomplete frame
+      return false;
+    }
+
+    std::size_t encoded_len = end - start;
+    rx_head_ += encoded_len + 1;
+
+    // skip empty frames between back to back delimiters
+    if (encoded_len == 0) {
+      continue;
+    }
+
+    std::size_t n = CobsFrameDecode(start, encoded_len);
+    if (n == 0) {
+      frame_errors_++;
+      continue;
+    }
+
+    *frame = start;
+    *len = n;
+    return true;
+  }
+
+  return false;
+}
+
+int SerialPort::Write(const uint8_t* payload, std::size_t len) {
+  if (fd_ < 0 || len > max_frame_size_) {
+    return -1;
+  }
+
+  // leading delimiter flushes any partial frame on the device side
+  std::memcpy(&tx_payload_[0], payload, len);
+  tx_buffer_[0] = kCobsDelimiter;
+  std::size_t n = CobsFrameEncode(&tx_payload_[0], len, &tx_buffer_[1]) + 1;
+
+  std::size_t written = 0;
+  while (written < n) {
+    ssize_t r = write(fd_, &tx_buffer_[written], n - written);
+    if (r < 0) {
+      if (errno == EAGAIN || errno == EINTR) {
+        struct pollfd pfd;
+        pfd.fd = fd_;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 100) <= 0) {
+          return -1;
+        }
+        continue;
+      }
+      return -1;
+    }
+    written += r;
+  }
+
+  return static_cast<int>(len);
+}
+
+uint32_t SerialPort::GetFrameErrors() const {
+  return frame_errors_;
+}
+
+}  // namespace svis
@@ -0,0 +1,53 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace svis {
+
+// USB CDC (/dev/ttyACM*) backend that carries COBS framed, CRC protected
+// packets over the teensy bulk endpoint.  Bytes are read in large chunks into
+// a single receive buffer and frames are decoded in place, so NextFrame hands
+// out pointers into that buffer without copying.
+class SerialPort {
+ public:
+  SerialPort();
+  ~SerialPort();
+
+  bool Open(const std::string& device);
+  void Close();
+  bool IsOpen() const;
+
+  // read whatever is available, waiting at most timeout milliseconds
+  // returns the number of bytes read, 0 on timeout and -1 on error
+  int Read(int timeout);
+
+  // get the next complete frame from the receive buffer
+  // the returned pointer is valid until the next call to Read
+  bool NextFrame(const uint8_t** frame, std::size_t* len);
+
+  // cobs encode, checksum, and write a payload
+  // returns the number of payload bytes written or -1 on error
+  int Write(const uint8_t* payload, std::size_t len);
+
+  uint32_t GetFrameErrors() const;
+
+ private:
+  // declared first, the buffers below are sized from these
+  const std::size_t rx_buffer_size_ = 16384;
+  const std::size_t max_frame_size_ = 1024;
+
+  int fd_ = -1;
+  std::vector<uint8_t> rx_buffer_;
+  std::size_t rx_head_ = 0;  // start of unparsed data
+  std::size_t rx_tail_ = 0;  // end of valid data
+  std::vector<uint8_t> tx_payload_;
+  std::vector<uint8_t> tx_buffer_;
+  uint32_t frame_errors_ = 0;
+};
+
+}  // namespace svis
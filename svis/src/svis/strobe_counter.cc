@@ -0,0 +1,78 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include <algorithm>
+#include <cstdio>
+
+#include "svis/strobe_counter.h"
+
+namespace svis {
+
+void StrobeCounter::Count(std::vector<StrobePacket>* strobe_packets, bool warn_jumps) {
+  for (auto& str : (*strobe_packets)) {
+    // initialize on the first strobe
+    if (history_.empty()) {
+      str.count_total = 1;
+      Push(str);
+      continue;
+    }
+
+    // count difference between the two most recent strobes, across rollover
+    const Mark& last = history_.back();
+    uint8_t diff = static_cast<uint8_t>(str.count - last.count);
+    if (diff == 0) {
+      printf("(svis) no change in strobe count\n");
+    } else if (diff > 1 && warn_jumps) {
+      printf("(svis) detected jump in strobe count\n");
+    }
+
+    str.count_total = last.count_total + diff;
+    Push(str);
+  }
+}
+
+void StrobeCounter::CountReplay(std::vector<StrobePacket>* strobe_packets) {
+  if (history_.empty()) {
+    return;
+  }
+
+  for (auto& str : (*strobe_packets)) {
+    // older than every live strobe, e.g. from before a host restart, nothing
+    // to count from
+    if (str.timestamp_teensy < history_.front().stamp) {
+      str.count_total = 0;
+      continue;
+    }
+
+    // the live strobes on either side of the replay, the nearest one counts
+    auto after = std::lower_bound(history_.begin(), history_.end(), str.timestamp_teensy,
+                                  [](const Mark& mark, double stamp) { return mark.stamp < stamp; });
+    auto nearest = after;
+    if (after == history_.end() ||
+        (after != history_.begin() && str.timestamp_teensy - (after - 1)->stamp < after->stamp - str.timestamp_teensy)) {
+      nearest = after - 1;
+    }
+
+    int8_t ahead = static_cast<int8_t>(str.count - nearest->count);
+    str.count_total = nearest->count_total + ahead;
+    if (after == history_.end() && ahead > 0) {
+      Push(str);
+    }
+  }
+}
+
+bool StrobeCounter::IsStarted() const {
+  return !history_.empty();
+}
+
+void StrobeCounter::Push(const StrobePacket& strobe) {
+  Mark mark;
+  mark.stamp = strobe.timestamp_teensy;
+  mark.count = strobe.count;
+  mark.count_total = strobe.count_total;
+  history_.push_back(mark);
+  if (history_.size() > history_size_) {
+    history_.pop_front();
+  }
+}
+
+}  // namespace svis
@@ -0,0 +1,49 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
+#include "svis/strobe_packet.h"
+
+namespace svis {
+
+// Unwraps the 8 bit strobe counts from the teensy into the running total the
+// camera frame counters are matched against.
+//
+// Live strobes arrive in order and move the total forward.  Strobes replayed
+// from the teensy journal can arrive hundreds of strobes late, so they are
+// counted from the live strobe nearest to them in teensy time, which is never
+// far since they fill a gap between live strobes.  A replay past the last
+// live strobe moves the total forward like a live strobe.  No usb here, so
+// the firmware simulation checks the same totals.
+class StrobeCounter {
+ public:
+  // live strobes, jumps are only reported once warn_jumps is set
+  void Count(std::vector<StrobePacket>* strobe_packets, bool warn_jumps);
+
+  // strobes replayed from the journal, needs a live strobe first, the ones
+  // older than the live history keep a count_total of 0
+  void CountReplay(std::vector<StrobePacket>* strobe_packets);
+
+  bool IsStarted() const;
+
+  // params
+  std::size_t history_size_ = 4096;  // live strobes kept to count replays from
+
+ private:
+  struct Mark {
+    double stamp;  // [s] teensy time
+    uint8_t count;
+    unsigned int count_total;
+  };
+
+  void Push(const StrobePacket& strobe);
+
+  std::deque<Mark> history_;
+};
+
+}  // namespace svis
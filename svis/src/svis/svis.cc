@@ -1,16 +1,45 @@
 // Copyright 2017 Massachusetts Institute of Technology
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 
+#include "svis/imu_convert.h"
 #include "svis/svis.h"
 
 namespace svis {
 
+namespace {
+
+// pulse times of the offset bootstrap burst in trigger periods, indexed by
+// pulse count.  each row is an optimal golomb ruler, every difference between
+// two pulses is distinct, so a strobe and image pair that are not the same
+// pulse can not line up any other pair.
+const int burst_marks[protocol::kBurstMaxCount + 1][protocol::kBurstMaxCount] = {
+  {},
+  {0},
+  {0, 1},
+  {0, 1, 3},
+  {0, 1, 4, 6},
+  {0, 1, 4, 9, 11},
+  {0, 1, 4, 10, 12, 17},
+  {0, 1, 4, 10, 18, 23, 25},
+  {0, 1, 4, 9, 15, 22, 32, 34},
+};
+
+}  // namespace
+
 SVIS::SVIS() {
   // set circular buffer max lengths
-  imu_buffer_.set_capacity(30);
+  imu_buffer_.SetCapacity(1024);
   strobe_buffer_.set_capacity(30);
   camera_buffer_.set_capacity(30);
+  camera_queue_.SetCapacity(camera_queue_size_);
+
+  for (int i = 0; i < 4; i++) {
+    acc_scale_arr_[i] = AccScale(i);
+    gyro_scale_arr_[i] = GyroScale(i);
+  }
 }
 
 double SVIS::GetTimeOffset() const {
@@ -22,15 +51,108 @@ std::size_t SVIS::GetCameraBufferSize() const {
 }
 
 std::size_t SVIS::GetCameraBufferMaxSize() const {
-  return camera_buffer_.max_size();
+  return camera_buffer_.capacity();
 }
 
 bool SVIS::GetSyncFlag() const {
   return sync_flag_;
 }
 
-void SVIS::PushCameraPacket(const svis::CameraPacket& camera_packet) {
-  camera_buffer_.push_back(camera_packet);
+bool SVIS::PushCameraPacket(svis::CameraPacket camera_packet) {
+  if (!camera_queue_.TryPush(std::move(camera_packet))) {
+    camera_queue_drops_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void SVIS::DrainCameraQueue() {
+  CameraPacket camera_packet;
+  while (camera_queue_.TryPop(&camera_packet)) {
+    if (camera_buffer_.full()) {
+      buffer_stats_.camera.overflow_count++;
+    }
+    camera_buffer_.push_back(std::move(camera_packet));
+  }
+
+  buffer_stats_.camera.overflow_count += camera_queue_drops_.exchange(0, std::memory_order_relaxed);
+  buffer_stats_.camera.Update(camera_buffer_.size(), camera_buffer_.capacity());
+}
+
+void SVIS::SetCameraQueueSize(int camera_queue_size) {
+  camera_queue_size_ = camera_queue_size;
+  camera_queue_.SetCapacity(camera_queue_size_);
+}
+
+const BufferStats& SVIS::GetBufferStats() const {
+  return buffer_stats_;
+}
+
+void SVIS::SetCameraRate(int camera_rate) {
+  std::vector<char> payload(2, 0);
+  uint16_t rate = static_cast<uint16_t>(camera_rate);
+  std::memcpy(&payload[0], &rate, sizeof(rate));
+  SendCommand(protocol::kCommandCameraRate, payload, camera_rate, 0);
+}
+
+void SVIS::SetImuRange(int gyro_sens, int acc_sens) {
+  std::vector<char> payload(2, 0);
+  payload[0] = static_cast<uint8_t>(gyro_sens);  // FS_SEL
+  payload[1] = static_cast<uint8_t>(acc_sens);  // AFS_SEL
+  SendCommand(protocol::kCommandImuRange, payload, gyro_sens, acc_sens);
+}
+
+void SVIS::SetImuRate(int imu_rate) {
+  // one report per usb frame has to carry every sample
+  int imu_slots = (transport_ == "serial") ? SerialReport::imu_slots : Report::imu_slots;
+  if (imu_rate > imu_slots * protocol::kReportRate) {
+    printf("(svis) imu_rate %i is above the %i Hz the %s transport carries\n",
+           imu_rate, imu_slots * protocol::kReportRate, transport_.c_str());
+    return;
+  }
+
+  std::vector<char> payload(2, 0);
+  uint16_t rate = static_cast<uint16_t>(imu_rate);
+  std::memcpy(&payload[0], &rate, sizeof(rate));
+  SendCommand(protocol::kCommandImuRate, payload, imu_rate, 0);
+}
+
+void SVIS::SetImuDlpf(int imu_dlpf) {
+  std::vector<char> payload(1, 0);
+  payload[0] = static_cast<uint8_t>(imu_dlpf);
+  SendCommand(protocol::kCommandImuDlpf, payload, imu_dlpf, 0);
+}
+
+void SVIS::SetTriggerDuration(int trigger_duration) {
+  std::vector<char> payload(4, 0);
+  uint32_t duration = static_cast<uint32_t>(trigger_duration);
+  std::memcpy(&payload[0], &duration, sizeof(duration));
+  SendCommand(protocol::kCommandTriggerDuration, payload, trigger_duration, 0);
+}
+
+std::size_t SVIS::GetPendingCommandCount() const {
+  return commands_.size();
+}
+
+const ImuHistory& SVIS::GetImuHistory() const {
+  return imu_history_;
+}
+
+void SVIS::Open() {
+  imu_history_.SetCapacity(imu_history_size_);
+  ConfigureBuffers();
+  ConfigureFramePool();
+  ConfigureImuFilter();
+  ConfigureImuResampler();
+
+  if (transport_ == "serial") {
+    OpenSerial();
+  } else {
+    OpenHID();
+  }
+
+  LoadClockState();
+  LoadLinkState();
 }
 
 void SVIS::OpenHID() {
@@ -46,6 +168,30 @@ void SVIS::OpenHID() {
   } else {
     printf("(svis) Found svis_teensy device\n");
   }
+
+  // key the clock state by the teensy serial number
+  if (device_id_.empty()) {
+    char serial[64] = {0};
+    if (rawhid_serial(0, serial, sizeof(serial)) > 0) {
+      device_id_ = serial;
+    } else {
+      device_id_ = "hid";
+    }
+  }
+}
+
+void SVIS::OpenSerial() {
+  // open usb cdc port
+  if (!serial_port_.Open(serial_device_)) {
+    printf("(svis) No svis_teensy device found on %s.\n", serial_device_.c_str());
+    return;
+  } else {
+    printf("(svis) Found svis_teensy device on %s\n", serial_device_.c_str());
+  }
+
+  if (device_id_.empty()) {
+    device_id_ = serial_device_;
+  }
 }
 
 int SVIS::ReadHID(std::vector<char>* buf) {
@@ -57,6 +203,7 @@ int SVIS::ReadHID(std::vector<char>* buf) {
   // check byte count
   if (num < 0) {
     printf("(svis) Error: reading, device went offline\n");
+    SaveLinkState();
     rawhid_close(0);
     exit(1);
   } else if (num == 0) {
@@ -73,57 +220,121 @@ int SVIS::ReadHID(std::vector<char>* buf) {
   return num;
 }
 
+int SVIS::ReadSerial() {
+  // read everything the device has queued up
+  tic();
+  int num = serial_port_.Read(220);
+  timing_.rawhid_recv = toc();
+
+  // check byte count
+  if (num < 0) {
+    printf("(svis) Error: reading, device went offline\n");
+    SaveLinkState();
+    serial_port_.Close();
+    exit(1);
+  } else if (num == 0) {
+    if (!init_flag_) {
+      printf("(svis) 0 bytes received\n");
+    }
+  }
+
+  return num;
+}
+
 void SVIS::Update() {
   std::chrono::time_point<std::chrono::high_resolution_clock>
     t_update_start_ = std::chrono::high_resolution_clock::now();
-  
-  // read and return if empty or bad
-  std::vector<char> buf(64, 0);
-  if (ReadHID(&buf) <= 0) {
-    return;
-  }
 
-  // debug print
-  if (print_buffer_) {
-    PrintBuffer(buf);
+  // resend unacknowledged commands
+  ServiceCommands();
+  ServiceBackfill();
+  ServiceResume();
+
+  // move images queued by the camera callback into the camera buffer
+  DrainCameraQueue();
+
+  // read and process reports, return if empty or bad
+  int report_count = 0;
+  if (transport_ == "serial") {
+    if (ReadSerial() <= 0) {
+      return;
+    }
+
+    // frames are decoded in place in the serial receive buffer
+    const uint8_t* frame = nullptr;
+    std::size_t len = 0;
+    while (serial_port_.NextFrame(&frame, &len)) {
+      if (len != static_cast<std::size_t>(SerialReport::report_size)) {
+        printf("(svis) Bad frame length: %lu\n", len);
+        continue;
+      }
+
+      if (ProcessReport<SerialReport>(reinterpret_cast<const char*>(frame))) {
+        report_count++;
+      }
+    }
+  } else {
+    std::vector<char> buf(Report::report_size, 0);
+    if (ReadHID(&buf) <= 0) {
+      return;
+    }
+
+    if (ProcessReport<Report>(buf.data())) {
+      report_count++;
+    }
   }
 
-  // check checksums and return if they don't match
-  if (CheckChecksum(buf)) {
+  if (report_count == 0) {
     return;
   }
 
-  // parse packets
-  std::vector<ImuPacket> imu_packets;
-  std::vector<StrobePacket> strobe_packets;
-  ParseBuffer(buf, &imu_packets, &strobe_packets);
-
-  // handle strobe
-  PushStrobe(strobe_packets, &strobe_buffer_);
-  PublishStrobeRaw(strobe_packets);
-
   // get difference between ros and teensy epochs
   if (init_flag_) {
-    ComputeOffsets(&strobe_buffer_, &camera_buffer_);
+    if (warm_start_) {
+      WarmStart();
+    } else if (use_sof_clock_) {
+      ComputeSofOffsets(&strobe_buffer_, &camera_buffer_);
+    } else if (offset_bootstrap_ == "burst") {
+      BootstrapOffsets(&strobe_buffer_, &camera_buffer_);
+    } else {
+      ComputeOffsets(&strobe_buffer_, &camera_buffer_);
+    }
     return;
   }
 
-  // handle imu
-  PushImu(imu_packets, &imu_buffer_);
-  PublishImuRaw(imu_packets);
-
   // filter and publish imu
   std::vector<ImuPacket> imu_packets_filt;
-  FilterImu(&imu_buffer_, &imu_packets_filt);
-  // DecimateImu(&imu_buffer_, &imu_packets_filt);
+  if (imu_filter_mode_ == "fir") {
+    FirFilterImu(&imu_buffer_, &imu_packets_filt);
+  } else if (imu_filter_mode_ == "decimate") {
+    DecimateImu(&imu_buffer_, &imu_packets_filt);
+  } else {
+    FilterImu(&imu_buffer_, &imu_packets_filt);
+  }
+  // spread the batch out, but never past the output period or high rates fall behind
+  int publish_gap = std::min(500, 500000 * std::max(imu_filter_size_, 1) / imu_rate_);  // [us]
   for (int i = 0; i < imu_packets_filt.size(); i++) {
-    usleep(500);
+    usleep(publish_gap);
     PublishImu(imu_packets_filt[i]);
   }
 
+  // publish imu resampled onto the uniform grid
+  if (imu_resample_rate_ > 0.0) {
+    PublishImuResampled(imu_packets_resampled_);
+    imu_packets_resampled_.clear();
+  }
+
   // associate strobe with camera and publish
+  // cameras wait until a warm start is confirmed by the first matches
   std::vector<CameraStrobePacket> camera_strobe_packets;
-  Associate(&strobe_buffer_, &camera_buffer_, &camera_strobe_packets);
+  if (validating_offsets_) {
+    ValidateOffsets(&strobe_buffer_, &camera_buffer_);
+  } else {
+    Associate(&strobe_buffer_, &camera_buffer_, &camera_strobe_packets);
+  }
+  if (preintegrate_imu_) {
+    PreintegrateImu(&camera_strobe_packets);
+  }
   PublishCamera(camera_strobe_packets);
   camera_strobe_packets.clear();
 
@@ -133,38 +344,207 @@ void SVIS::Update() {
   timing_ = svis::Timing(); // clear timing
 }
 
-void SVIS::ParseBuffer(const std::vector<char>& buf, std::vector<ImuPacket>* imu_packets, std::vector<StrobePacket>* strobe_packets) {
+template <typename Layout>
+bool SVIS::ProcessReport(const char* buf) {
+  // debug print
+  if (print_buffer_) {
+    PrintBuffer<Layout>(buf);
+  }
+
+  // check checksums and return if they don't match
+  if (CheckChecksum<Layout>(buf)) {
+    return false;
+  }
+
+  protocol::ReportDecoder<Layout> report(reinterpret_cast<const uint8_t*>(buf));
+
+  // replays from the journal fill the gaps in the send counts
+  ReportSequencer::Order order = report_sequencer_.Sequence(report.GetSendCount());
+  buffer_stats_.backfill_requested = report_sequencer_.GetRequestedCount();
+  if (order != ReportSequencer::kLive) {
+    if (order == ReportSequencer::kReplay && !report.IsAck() && !report.IsClock() && !report.IsStatus()) {
+      HandleBackfill<Layout>(buf);
+    }
+    return true;
+  }
+
+  // command acknowledgements replace the imu and strobe data
+  if (report.IsAck()) {
+    HandleAck(buf);
+    return true;
+  }
+
+  // usb start of frame clock reports
+  if (report.IsClock()) {
+    HandleClock(buf);
+    return true;
+  }
+
+  // teensy ring counters
+  if (report.IsStatus()) {
+    HandleStatus(buf);
+    return true;
+  }
+
+  // parse packets
   HeaderPacket header;
-  ParseHeader(buf, &header);
-  ParseImu(buf, header, imu_packets);
-  ParseStrobe(buf, header, strobe_packets);
+  std::vector<ImuSample> imu_samples;
+  std::vector<StrobePacket> strobe_packets;
+  ParseBuffer<Layout>(buf, &header, &imu_samples, &strobe_packets);
+  if (!imu_samples.empty()) {
+    UpdateRxOffset(header.timestamp_ros_rx - static_cast<double>(imu_samples.back().timestamp_teensy) / 1000000.0);
+  }
+
+  // handle strobe
+  PushStrobe(strobe_packets, &strobe_buffer_);
+  PublishStrobeRaw(strobe_packets);
+
+  // imu is not used until we have the teensy epoch
+  if (init_flag_) {
+    return true;
+  }
+
+  // handle imu
+  PushImu(imu_samples, &imu_buffer_);
+
+  // convert to si units only for publishing
+  std::vector<ImuPacket> imu_packets(imu_samples.size());
+  for (std::size_t i = 0; i < imu_samples.size(); i++) {
+    ConvertImu(imu_samples[i], &imu_packets[i]);
+    imu_packets[i].timestamp_ros_rx = header.timestamp_ros_rx;
+    imu_history_.Push(imu_packets[i]);
+    if (imu_resample_rate_ > 0.0) {
+      imu_resampler_.Push(imu_packets[i], &imu_packets_resampled_);
+    }
+  }
+  PublishImuRaw(imu_packets);
+
+  return true;
+}
+
+template <typename Layout>
+void SVIS::ParseBuffer(const char* buf, HeaderPacket* header, std::vector<ImuSample>* imu_samples, std::vector<StrobePacket>* strobe_packets) {
+  ParseHeader<Layout>(buf, header);
+  ParseImu<Layout>(buf, *header, imu_samples);
+  ParseStrobe<Layout>(buf, *header, strobe_packets);
   ComputeStrobeTotal(strobe_packets);
 }
 
+template <typename Layout>
+void SVIS::HandleBackfill(const char* buf) {
+  HeaderPacket header;
+  std::vector<ImuSample> imu_samples;
+  std::vector<StrobePacket> strobe_packets;
+  ParseHeader<Layout>(buf, &header);
+  ParseImu<Layout>(buf, header, &imu_samples);
+  ParseStrobe<Layout>(buf, header, &strobe_packets);
+  buffer_stats_.backfill_count++;
+
+  // strobes only spill when the teensy strobe ring is full, their frames
+  // wait in the camera buffer, so they still go to the association, strobes
+  // from before the live ones, e.g. after a host restart, have no frames left
+  if (strobe_counter_.IsStarted()) {
+    strobe_counter_.CountReplay(&strobe_packets);
+    std::vector<StrobePacket> counted;
+    for (const StrobePacket& strobe : strobe_packets) {
+      if (strobe.count_total != 0) {
+        counted.push_back(strobe);
+      }
+    }
+    PushStrobe(counted, &strobe_buffer_);
+  }
+  PublishStrobeRaw(strobe_packets);
+
+  // the filtered and uniform outputs have moved past these samples, so they
+  // only go to the raw topic and into the history in time order, where the
+  // queries and the preintegration of frames still waiting find them
+  if (init_flag_) {
+    return;
+  }
+
+  std::vector<ImuPacket> imu_packets(imu_samples.size());
+  for (std::size_t i = 0; i < imu_samples.size(); i++) {
+    ConvertImu(imu_samples[i], &imu_packets[i]);
+    imu_packets[i].timestamp_ros_rx = header.timestamp_ros_rx;
+    imu_history_.Merge(imu_packets[i]);
+  }
+  PublishImuRaw(imu_packets);
+}
+
+void SVIS::ServiceBackfill() {
+  std::chrono::duration<double> t_now =
+    std::chrono::high_resolution_clock::now().time_since_epoch();
+  uint16_t first = 0;
+  uint16_t count = 0;
+  if (!report_sequencer_.NextBackfill(t_now.count(), &first, &count)) {
+    return;
+  }
+
+  std::vector<char> payload(2*sizeof(uint16_t));
+  protocol::Store<uint16_t>(reinterpret_cast<uint8_t*>(payload.data()), 0, first);
+  protocol::Store<uint16_t>(reinterpret_cast<uint8_t*>(payload.data()), sizeof(uint16_t), count);
+  SendCommand(protocol::kCommandBackfill, payload, first, count);
+}
+
+void SVIS::ServiceResume() {
+  // replays are only published once the teensy epoch is known
+  if (!resume_pending_ || init_flag_) {
+    return;
+  }
+  resume_pending_ = false;
+
+  std::vector<char> payload(sizeof(uint32_t) + sizeof(uint16_t));
+  protocol::Store<uint32_t>(reinterpret_cast<uint8_t*>(payload.data()), 0, link_state_.session);
+  protocol::Store<uint16_t>(reinterpret_cast<uint8_t*>(payload.data()), sizeof(uint32_t), link_state_.send_count);
+  SendCommand(protocol::kCommandResume, payload, link_state_.send_count, 0);
+}
+
+void SVIS::SendPacket(std::vector<char>* buf) {
+  if (transport_ == "serial") {
+    serial_port_.Write(reinterpret_cast<const uint8_t*>(buf->data()), buf->size());
+  } else {
+    rawhid_send(0, buf->data(), buf->size(), 100);
+  }
+}
+
 void SVIS::SendPulse() {
-  std::vector<char> buf(64, 0);
-  buf[0] = 0xAB;
-  buf[1] = 2;
+  std::vector<char> buf(Report::report_size, 0);
+  buf[0] = protocol::kSetupHeader;
+  buf[1] = protocol::kSetupPulse;
   printf("(svis) Sending pulse packet\n");
-  rawhid_send(0, buf.data(), buf.size(), 100);
+  SendPacket(&buf);
+  sent_pulse_ = true;
+  t_pulse_ = std::chrono::high_resolution_clock::now();
+}
+
+void SVIS::SendBurst(int count) {
+  std::vector<char> buf(Report::report_size, 0);
+  buf[0] = protocol::kSetupHeader;
+  buf[1] = protocol::kSetupBurst;
+  buf[protocol::kBurstCountIndex] = static_cast<char>(count);
+  for (int i = 1; i < count; i++) {
+    buf[protocol::kBurstGapIndex + i - 1] = static_cast<char>(burst_marks[count][i] - burst_marks[count][i - 1]);
+  }
+  printf("(svis) Sending pulse burst packet\n");
+  SendPacket(&buf);
   sent_pulse_ = true;
   t_pulse_ = std::chrono::high_resolution_clock::now();
 }
 
 void SVIS::SendDisablePulse() {
-  std::vector<char> buf(64, 0);
-  buf[0] = 0xAB;
-  buf[1] = 3;
+  std::vector<char> buf(Report::report_size, 0);
+  buf[0] = protocol::kSetupHeader;
+  buf[1] = protocol::kSetupDisablePulse;
   printf("(svis) Sending configuration packet\n");
-  rawhid_send(0, buf.data(), buf.size(), 100);
+  SendPacket(&buf);
 }
 
 void SVIS::SendSetup() {
-  std::vector<char> buf(64, 0);
+  std::vector<char> buf(Report::report_size, 0);
 
   // header
-  buf[0] = 0xAB;
-  buf[1] = 0;
+  buf[0] = protocol::kSetupHeader;
+  buf[1] = protocol::kSetupConfigure;
 
   // camera rate
   buf[2] = static_cast<uint8_t>(camera_rate_);  // Hz
@@ -175,28 +555,232 @@ void SVIS::SendSetup() {
   // accel range
   buf[4] = acc_sens_;  // AFS_SEL
 
+  // the teensy keeps its send count and journal when the ranges are the
+  // same, the resume checks that and requests the reports in between
+  if (session_ != 0 && report_sequencer_.HasSendCount()) {
+    link_state_.session = session_;
+    link_state_.send_count = report_sequencer_.GetLastSendCount();
+    resume_pending_ = true;
+  }
+  report_sequencer_.Reset();
+
   printf("(svis) Sending configuration packet\n");
-  rawhid_send(0, buf.data(), buf.size(), 100);
+  SendPacket(&buf);
 }
 
-bool SVIS::CheckChecksum(const std::vector<char>& buf) {
-  tic();
+void SVIS::SendCommand(uint8_t command, const std::vector<char>& payload,
+                       int32_t arg0, int32_t arg1) {
+  CommandPacket packet;
+
+  // request ids are never zero so a fresh teensy never mistakes one for a retry
+  request_id_++;
+  if (request_id_ == 0) {
+    request_id_++;
+  }
+
+  packet.request_id = request_id_;
+  packet.command = command;
+  packet.arg[0] = arg0;
+  packet.arg[1] = arg1;
+
+  // header
+  packet.buf.resize(Report::report_size, 0);
+  packet.buf[0] = protocol::kCommandHeader;
+  packet.buf[protocol::kCommandRequestIdIndex] = packet.request_id;
+  packet.buf[protocol::kCommandIndex] = packet.command;
+
+  // payload
+  std::copy(payload.begin(), payload.end(), packet.buf.begin() + protocol::kCommandPayloadIndex);
+
+  printf("(svis) Sending command %i (request %i)\n", packet.command, packet.request_id);
+  SendPacket(&packet.buf);
+  packet.t_sent = std::chrono::high_resolution_clock::now();
+  commands_.push_back(packet);
+}
+
+void SVIS::ServiceCommands() {
+  std::chrono::time_point<std::chrono::high_resolution_clock> t_now =
+    std::chrono::high_resolution_clock::now();
+
+  for (auto it = commands_.begin(); it != commands_.end(); ) {
+    std::chrono::duration<double> wait_duration = t_now - it->t_sent;
+    if (wait_duration.count() < command_timeout_) {
+      ++it;
+      continue;
+    }
+
+    // give up after too many retries
+    if (it->retries >= command_retry_count_) {
+      printf("(svis) Command %i (request %i) was not acknowledged\n",
+             it->command, it->request_id);
+      it = commands_.erase(it);
+      continue;
+    }
+
+    // resend with the same request id so the teensy only applies it once
+    printf("(svis) Resending command %i (request %i)\n", it->command, it->request_id);
+    SendPacket(&it->buf);
+    it->t_sent = t_now;
+    it->retries++;
+    ++it;
+  }
+}
+
+void SVIS::HandleAck(const char* buf) {
+  ReportDecoder report(reinterpret_cast<const uint8_t*>(buf));
+  uint8_t request_id = report.GetAckRequestId();
+  uint8_t command = report.GetAckCommand();
+  uint8_t status = report.GetAckStatus();
+  uint32_t stamp = report.GetAckStamp();
+
+  // find matching command
+  auto it = commands_.begin();
+  for (; it != commands_.end(); ++it) {
+    if (it->request_id == request_id && it->command == command) {
+      break;
+    }
+  }
+
+  // duplicate ack from a retry
+  if (it == commands_.end()) {
+    return;
+  }
+
+  // the teensy still has the reports since the last host left off
+  if (command == protocol::kCommandResume) {
+    if (status == protocol::kAckOk) {
+      printf("(svis) Resumed teensy session, backfilling after send count %i\n", it->arg[0]);
+      report_sequencer_.Resume(static_cast<uint16_t>(it->arg[0]));
+    } else {
+      printf("(svis) Teensy started a new session, reports before the setup are not backfilled\n");
+    }
+    commands_.erase(it);
+    return;
+  }
+
+  // without a journal the lost reports stay lost
+  if (command == protocol::kCommandBackfill && status == protocol::kAckNoJournal) {
+    printf("(svis) teensy has no journal, lost reports will not be backfilled\n");
+    report_sequencer_.DisableBackfill();
+    commands_.erase(it);
+    return;
+  }
+
+  if (status != protocol::kAckOk) {
+    printf("(svis) Command %i (request %i) rejected with status %i\n", command, request_id, status);
+    commands_.erase(it);
+    return;
+  }
+
+  // mirror the new configuration on the host
+  if (command == protocol::kCommandCameraRate) {
+    camera_rate_ = it->arg[0];
+    ConfigureBuffers();
+  } else if (command == protocol::kCommandImuRange) {
+    // samples taken before the change still use the old sensitivity
+    sens_change_flag_ = true;
+    sens_change_stamp_ = stamp;
+    gyro_sens_next_ = it->arg[0];
+    acc_sens_next_ = it->arg[1];
+  } else if (command == protocol::kCommandImuRate) {
+    imu_rate_ = it->arg[0];
+    ConfigureBuffers();
+    ConfigureImuFilter();
+    ConfigureImuResampler();
+  } else if (command == protocol::kCommandImuDlpf) {
+    imu_dlpf_ = it->arg[0];
+  } else if (command == protocol::kCommandTriggerDuration) {
+    trigger_duration_ = it->arg[0];
+  }
+
+  printf("(svis) Command %i (request %i) acknowledged\n", command, request_id);
+  commands_.erase(it);
+}
+
+void SVIS::HandleClock(const char* buf) {
+  double t_rx = TimeNow();
+
+  ReportDecoder report(reinterpret_cast<const uint8_t*>(buf));
+  int count = report.GetClockCount();
+
+  uint16_t frames[protocol::ClockReport::pair_slots];
+  uint32_t stamps[protocol::ClockReport::pair_slots];
+  for (int i = 0; i < count; i++) {
+    frames[i] = report.GetClockFrame(i);
+    stamps[i] = report.GetClockStamp(i);
+  }
+
+  clock_estimator_.AddReport(frames, stamps, count, t_rx);
+}
+
+void SVIS::HandleStatus(const char* buf) {
+  ReportDecoder report(reinterpret_cast<const uint8_t*>(buf));
+
+  // counters are cumulative on the teensy, warn on new losses
+  uint32_t imu_overflow = report.GetImuOverflow();
+  uint32_t strobe_overflow = report.GetStrobeOverflow();
+  if (imu_overflow > buffer_stats_.teensy_imu.overflow_count ||
+      strobe_overflow > buffer_stats_.teensy_strobe.overflow_count) {
+    printf("(svis) teensy dropped %u imu samples and %u strobes\n",
+           imu_overflow - static_cast<uint32_t>(buffer_stats_.teensy_imu.overflow_count),
+           strobe_overflow - static_cast<uint32_t>(buffer_stats_.teensy_strobe.overflow_count));
+  }
+
+  buffer_stats_.teensy_imu.capacity = report.GetImuCapacity();
+  buffer_stats_.teensy_imu.high_water = report.GetImuHighWater();
+  buffer_stats_.teensy_imu.overflow_count = imu_overflow;
+  buffer_stats_.teensy_strobe.capacity = report.GetStrobeCapacity();
+  buffer_stats_.teensy_strobe.high_water = report.GetStrobeHighWater();
+  buffer_stats_.teensy_strobe.overflow_count = strobe_overflow;
+  buffer_stats_.teensy_sof_overflow_count = report.GetSofOverflow();
+  buffer_stats_.teensy_send_errors = report.GetSendErrors();
+  buffer_stats_.teensy_journal_drops = report.GetJournalDrops();
+
+  // where to resume if the host restarts
+  session_ = report.GetSession();
+  SaveLinkState();
+}
+
+double SVIS::TeensyToRos(uint64_t stamp) {
+  if (use_sof_clock_ && clock_estimator_.IsValid()) {
+    return clock_estimator_.TeensyToHost(static_cast<uint32_t>(stamp));
+  }
+
+  return static_cast<double>(stamp) / 1000000.0 + GetTimeOffset();
+}
+
+void SVIS::ConvertImu(const ImuSample& sample, ImuPacket* imu) {
+  imu->timestamp_teensy_raw = static_cast<uint32_t>(sample.timestamp_teensy);
+  imu->timestamp_teensy = static_cast<double>(sample.timestamp_teensy) / 1000000.0;
+
+  // teensy time in ros epoch
+  if (init_flag_) {
+    imu->timestamp_ros = 0.0;
+  } else {
+    imu->timestamp_ros = TeensyToRos(sample.timestamp_teensy);
+  }
 
-  // calculate checksum
-  uint16_t checksum_calc = 0;
-  for (int i = 0; i < send_buffer_size - 2; i++) {
-    checksum_calc += buf[i] & 0xFF;
+  float acc_scale = acc_scale_arr_[sample.acc_sens & 0x03];
+  float gyro_scale = gyro_scale_arr_[sample.gyro_sens & 0x03];
+  for (int j = 0; j < 3; j++) {
+    imu->acc_raw[j] = sample.acc_raw[j];
+    imu->acc[j] = static_cast<float>(sample.acc_raw[j]) * acc_scale;
+    imu->gyro_raw[j] = sample.gyro_raw[j];
+    imu->gyro[j] = static_cast<float>(sample.gyro_raw[j]) * gyro_scale;
   }
+}
+
+template <typename Layout>
+bool SVIS::CheckChecksum(const char* buf) {
+  tic();
 
-  // get packet chechsum
-  uint16_t checksum_orig = 0;
-  std::memcpy(&checksum_orig, &buf[checksum_index], sizeof(checksum_orig));
-  bool ret = (checksum_calc != checksum_orig);
+  protocol::ReportDecoder<Layout> report(reinterpret_cast<const uint8_t*>(buf));
+  bool ret = !report.ChecksumOk();
 
   // check match and return result
   if (ret) {
-    printf("(svis) checksum error [%02X, %02X] [%02X, %02X]\n",
-                 buf[checksum_index] & 0xFF, buf[checksum_index + 1] & 0xFF, checksum_calc, checksum_orig);
+    printf("(svis) checksum error [%04X, %04X]\n",
+           protocol::Checksum<Layout>(reinterpret_cast<const uint8_t*>(buf)), report.GetChecksum());
   }
 
   timing_.check_checksum = toc();
@@ -230,6 +814,7 @@ void SVIS::ComputeOffsets(boost::circular_buffer<StrobePacket>* strobe_buffer,
     printf("(svis) time_offset: %f\n", time_offset_);
 
     init_flag_ = false;
+    SaveClockState();
   }
 
   // check if we already sent a pulse and we have waiting long enough
@@ -245,7 +830,7 @@ void SVIS::ComputeOffsets(boost::circular_buffer<StrobePacket>* strobe_buffer,
       // we have exactly one of each
       if (strobe_buffer->size() == 1 && camera_buffer->size() == 1) {
         StrobePacket strobe = strobe_buffer->front();
-        CameraPacket camera = camera_buffer->front();
+        const CameraPacket& camera = camera_buffer->front();
         time_offset_vec_.push_back(camera.image.header.stamp - strobe.timestamp_teensy);
         strobe_count_offset_ = camera.metadata.frame_counter - strobe.count_total;
         printf("strobe_count_offset: %i\n", strobe_count_offset_);
@@ -271,125 +856,467 @@ void SVIS::ComputeOffsets(boost::circular_buffer<StrobePacket>* strobe_buffer,
   timing_.compute_offsets = toc();
 }
 
-void SVIS::ParseHeader(const std::vector<char>& buf, HeaderPacket* header) {
+void SVIS::ComputeSofOffsets(boost::circular_buffer<StrobePacket>* strobe_buffer,
+                             boost::circular_buffer<CameraPacket>* camera_buffer) {
   tic();
 
-  int ind = 0;
+  // the strobes are mapped through the sof clock, so wait for it
+  if (!clock_estimator_.IsValid()) {
+    camera_buffer->clear();
+    timing_.compute_offsets = toc();
+    return;
+  }
 
-  // ros time
-  header->timestamp_ros_rx = TimeNow();
+  // a free running camera only gives its latency modulo the period, so measure
+  // it once with a single pulse, starting from empty buffers
+  if (sof_latency_ < 0.0) {
+    if (!sent_pulse_) {
+      strobe_buffer->clear();
+      camera_buffer->clear();
+      SendPulse();
+      timing_.compute_offsets = toc();
+      return;
+    }
 
-  // send_count
-  memcpy(&header->send_count, &buf[ind], sizeof(header->send_count));
-  // printf("(svis) send_count: [%i, %i]\n", ind, header->send_count);
-  ind += sizeof(header->send_count);
+    std::chrono::duration<double> pulse_duration = std::chrono::high_resolution_clock::now() - t_pulse_;
+    if (pulse_duration.count() < offset_sample_time_) {
+      timing_.compute_offsets = toc();
+      return;
+    }
 
-  // imu_packet_count
-  memcpy(&header->imu_count, &buf[ind], sizeof(header->imu_count));
-  // printf("(svis) imu_packet_count: [%i, %i]\n", ind, header->imu_count);
-  ind += sizeof(header->imu_count);
+    if (strobe_buffer->size() == 1 && camera_buffer->size() == 1) {
+      double t_strobe = clock_estimator_.TeensyToHost(strobe_buffer->front().timestamp_teensy_raw);
+      sof_latency_ = camera_buffer->front().image.header.stamp - t_strobe;
+      printf("(svis) camera latency: %f\n", sof_latency_);
 
-  // strobe_packet_count
-  memcpy(&header->strobe_count, &buf[ind], sizeof(header->strobe_count));
-  // printf("(svis) strobe_packet_count: [%i, %i]\n", ind, header->strobe_count);
-  ind += sizeof(header->strobe_count);
+      // then let the camera run freely and only recover the strobe to frame
+      // counter offset
+      SendDisablePulse();
+    } else {
+      printf("(svis) pulse got %zu strobes and %zu images, retrying\n",
+             strobe_buffer->size(), camera_buffer->size());
+      sent_pulse_ = false;
+    }
+    strobe_buffer->clear();
+    camera_buffer->clear();
+    timing_.compute_offsets = toc();
+    return;
+  }
 
-  timing_.parse_header = toc();
+  // match each camera to the strobe a latency before its stamp, a neighbouring
+  // strobe is a period away, outside the tolerance
+  double tolerance = 0.25 / static_cast<double>(std::max(camera_rate_, 1));
+  for (auto it_camera = camera_buffer->begin(); it_camera != camera_buffer->end(); ) {
+    double t_camera = (*it_camera).image.header.stamp;
+    double t_expected = t_camera - sof_latency_;
+    double best_error = std::numeric_limits<double>::infinity();
+    double t_best = 0.0;
+    double t_newest = -std::numeric_limits<double>::infinity();
+    const StrobePacket* best = nullptr;
+    for (auto it_strobe = strobe_buffer->begin(); it_strobe != strobe_buffer->end(); ++it_strobe) {
+      double t_strobe = clock_estimator_.TeensyToHost((*it_strobe).timestamp_teensy_raw);
+      t_newest = std::max(t_newest, t_strobe);
+      if (std::abs(t_strobe - t_expected) < best_error) {
+        best_error = std::abs(t_strobe - t_expected);
+        t_best = t_strobe;
+        best = &(*it_strobe);
+      }
+    }
+
+    if (best == nullptr || best_error >= tolerance) {
+      if (t_newest > t_expected + tolerance || (TimeNow() - t_camera) > GetStaleTimeout()) {
+        // its strobe should have arrived by now, a lost strobe or a latency
+        // that moved, so it agrees with nothing
+        buffer_stats_.camera.stale_count++;
+        strobe_count_offset_vec_.clear();
+        it_camera = camera_buffer->erase(it_camera);
+      } else {
+        // wait for the strobe if it hasn't been received yet
+        ++it_camera;
+      }
+      continue;
+    }
+
+    strobe_count_offset_vec_.push_back((*it_camera).metadata.frame_counter - best->count_total);
+    time_offset_ = t_best - best->timestamp_teensy;
+    it_camera = camera_buffer->erase(it_camera);
+  }
+
+  // drop stale strobes
+  while (strobe_buffer->size() > 0 && (TimeNow() - strobe_buffer->front().timestamp_ros_rx) > GetStaleTimeout()) {
+    buffer_stats_.strobe.stale_count++;
+    strobe_buffer->pop_front();
+  }
+
+  // require agreement between consecutive samples
+  while (strobe_count_offset_vec_.size() > static_cast<std::size_t>(offset_sample_count_)) {
+    strobe_count_offset_vec_.pop_front();
+  }
+  if (strobe_count_offset_vec_.size() == static_cast<std::size_t>(offset_sample_count_) &&
+      std::all_of(strobe_count_offset_vec_.begin(), strobe_count_offset_vec_.end(),
+                  [this](unsigned int offset) { return offset == strobe_count_offset_vec_.front(); })) {
+    strobe_count_offset_ = strobe_count_offset_vec_.front();
+    printf("strobe_count_offset: %i\n", strobe_count_offset_);
+
+    // time_offset_ is only kept as a fallback
+    printf("(svis) time_offset: %f skew: %f\n", time_offset_, clock_estimator_.GetSkew());
+
+    init_flag_ = false;
+  }
+
+  timing_.compute_offsets = toc();
 }
 
-void SVIS::ParseImu(const std::vector<char>& buf, const HeaderPacket& header, std::vector<ImuPacket>* imu_packets) {
+void SVIS::BootstrapOffsets(boost::circular_buffer<StrobePacket>* strobe_buffer,
+                            boost::circular_buffer<CameraPacket>* camera_buffer) {
   tic();
 
-  for (int i = 0; i < header.imu_count; i++) {
-    ImuPacket imu;
-    int ind = imu_index[i];
+  int count = std::min(std::max(offset_sample_count_, 3), protocol::kBurstMaxCount);
+
+  // start from empty buffers so only the burst is matched
+  if (!sent_pulse_) {
+    strobe_buffer->clear();
+    camera_buffer->clear();
+    SendBurst(count);
+    timing_.compute_offsets = toc();
+    return;
+  }
 
-    // ros receive time
-    imu.timestamp_ros_rx = header.timestamp_ros_rx;
+  // wait for the whole burst or give up a sample time after the last pulse
+  double period = 1.0 / static_cast<double>(std::max(camera_rate_, 1));
+  std::chrono::duration<double> burst_duration = std::chrono::high_resolution_clock::now() - t_pulse_;
+  bool timed_out = burst_duration.count() > burst_marks[count][count - 1] * period + offset_sample_time_;
+  if (!timed_out && (strobe_buffer->size() < static_cast<std::size_t>(count) ||
+                     camera_buffer->size() < static_cast<std::size_t>(count))) {
+    timing_.compute_offsets = toc();
+    return;
+  }
 
-    // raw teensy timestamp
-    memcpy(&imu.timestamp_teensy_raw, &buf[ind], sizeof(imu.timestamp_teensy_raw));
-    // printf("(svis) imu.timestamp: [%i, %i]\n", ind, imu.timestamp);
-    ind += sizeof(imu.timestamp_teensy_raw);
+  // every strobe and image pair proposes an offset, keep the one most other
+  // images agree with to within half a period
+  double tolerance = 0.5 * period;
+  int best_inliers = 0;
+  double best_offset = 0.0;
+  unsigned int best_count_offset = 0;
+  for (auto it_strobe = strobe_buffer->begin(); it_strobe != strobe_buffer->end(); ++it_strobe) {
+    for (auto it_camera = camera_buffer->begin(); it_camera != camera_buffer->end(); ++it_camera) {
+      double offset = (*it_camera).image.header.stamp - (*it_strobe).timestamp_teensy;
+
+      int inliers = 0;
+      double sum = 0.0;
+      for (auto it_c = camera_buffer->begin(); it_c != camera_buffer->end(); ++it_c) {
+        for (auto it_s = strobe_buffer->begin(); it_s != strobe_buffer->end(); ++it_s) {
+          double candidate = (*it_c).image.header.stamp - (*it_s).timestamp_teensy;
+          if (std::abs(candidate - offset) < tolerance) {
+            inliers++;
+            sum += candidate;
+            break;
+          }
+        }
+      }
 
-    // convert to seconds
-    imu.timestamp_teensy = static_cast<double>(imu.timestamp_teensy_raw) / 1000000.0;
+      if (inliers > best_inliers) {
+        best_inliers = inliers;
+        best_offset = sum / static_cast<double>(inliers);
+        best_count_offset = (*it_camera).metadata.frame_counter - (*it_strobe).count_total;
+      }
+    }
+  }
 
-    // teensy time in ros epoch
-    if (init_flag_) {
-      imu.timestamp_ros = 0.0;
+  // tolerate one dropped image
+  if (best_inliers >= count - 1) {
+    time_offset_ = best_offset;
+    strobe_count_offset_ = best_count_offset;
+    printf("strobe_count_offset: %i\n", strobe_count_offset_);
+    printf("(svis) time_offset: %f from %i of %i pulses\n", time_offset_, best_inliers, count);
+
+    strobe_buffer->clear();
+    camera_buffer->clear();
+    SendDisablePulse();
+    init_flag_ = false;
+    SaveClockState();
+  } else if (timed_out) {
+    printf("(svis) pulse burst matched %i of %i images, retrying\n", best_inliers, count);
+    sent_pulse_ = false;
+  }
+
+  timing_.compute_offsets = toc();
+}
+
+void SVIS::LoadClockState() {
+  // the sof clock needs no pulse calibration to begin with
+  if (clock_state_file_.empty() || use_sof_clock_) {
+    return;
+  }
+
+  if (!ReadClockState(clock_state_file_, device_id_, camera_id_, camera_rate_, &clock_state_)) {
+    printf("(svis) No clock state for %s %s at %i Hz, calibrating\n", device_id_.c_str(), camera_id_.c_str(),
+           camera_rate_);
+    return;
+  }
+
+  printf("(svis) Loaded clock state for %s %s at %i Hz saved %.0f s ago\n", device_id_.c_str(),
+         camera_id_.c_str(), camera_rate_, TimeNow() - clock_state_.saved_time);
+  warm_start_ = true;
+}
+
+void SVIS::SaveClockState() {
+  if (clock_state_file_.empty() || std::isinf(GetRxOffset())) {
+    return;
+  }
+
+  clock_state_.device = device_id_;
+  clock_state_.camera = camera_id_;
+  clock_state_.camera_rate = camera_rate_;
+  clock_state_.time_offset_bias = time_offset_ - GetRxOffset();
+  clock_state_.strobe_count_offset = strobe_count_offset_;
+  clock_state_.saved_time = TimeNow();
+  if (!WriteClockState(clock_state_file_, clock_state_)) {
+    printf("(svis) Failed to write clock state to %s\n", clock_state_file_.c_str());
+  }
+}
+
+void SVIS::LoadLinkState() {
+  if (link_state_file_.empty() || !ReadLinkState(link_state_file_, device_id_, &link_state_)) {
+    return;
+  }
+
+  // send counts wrap after 65536 reports, there is a bit more than one per usb
+  // frame with the clock and status reports
+  double age = TimeNow() - link_state_.saved_time;
+  if (age > 0.5*65536/protocol::kReportRate) {
+    printf("(svis) Link state for %s saved %.0f s ago, not resuming\n", device_id_.c_str(), age);
+    return;
+  }
+
+  printf("(svis) Loaded link state for %s, resuming after send count %u\n",
+         device_id_.c_str(), link_state_.send_count);
+  resume_pending_ = true;
+}
+
+void SVIS::SaveLinkState() {
+  // a pending resume still needs the state it was loaded from
+  if (link_state_file_.empty() || session_ == 0 || resume_pending_ || !report_sequencer_.HasSendCount()) {
+    return;
+  }
+
+  link_state_.device = device_id_;
+  link_state_.session = session_;
+  link_state_.send_count = report_sequencer_.GetLastSendCount();
+  link_state_.saved_time = TimeNow();
+  if (!WriteLinkState(link_state_file_, link_state_)) {
+    printf("(svis) Failed to write link state to %s\n", link_state_file_.c_str());
+  }
+}
+
+void SVIS::WarmStart() {
+  // skip the reports queued up before the start, their receive offsets are late
+  const int min_report_count = 100;
+  if (rx_offset_count_ < min_report_count) {
+    return;
+  }
+
+  time_offset_ = GetRxOffset() + clock_state_.time_offset_bias;
+  strobe_count_offset_ = clock_state_.strobe_count_offset;
+  printf("(svis) Warm start time_offset: %f\n", time_offset_);
+
+  // let the camera run and check the model against the first images
+  strobe_buffer_.clear();
+  camera_buffer_.clear();
+  time_offset_vec_.clear();
+  strobe_count_offset_vec_.clear();
+  SendDisablePulse();
+
+  warm_start_ = false;
+  validating_offsets_ = true;
+  init_flag_ = false;
+}
+
+void SVIS::ValidateOffsets(boost::circular_buffer<StrobePacket>* strobe_buffer,
+                           boost::circular_buffer<CameraPacket>* camera_buffer) {
+  tic();
+
+  // follow the receive envelope until the matches take over
+  time_offset_ = GetRxOffset() + clock_state_.time_offset_bias;
+
+  // each image must land within a quarter period of a strobe mapped with the
+  // model, half a period would accept a latency off by almost a whole frame
+  double tolerance = 0.25 / static_cast<double>(std::max(camera_rate_, 1));
+  bool failed = false;
+  while (camera_buffer->size() > 0 && !failed) {
+    const CameraPacket& camera = camera_buffer->front();
+    double t_camera = camera.image.header.stamp;
+
+    double best_error = std::numeric_limits<double>::infinity();
+    double t_newest = -std::numeric_limits<double>::infinity();
+    const StrobePacket* best = nullptr;
+    for (auto it_strobe = strobe_buffer->begin(); it_strobe != strobe_buffer->end(); ++it_strobe) {
+      double t_strobe = (*it_strobe).timestamp_teensy + time_offset_;
+      t_newest = std::max(t_newest, t_strobe);
+      if (std::abs(t_camera - t_strobe) < best_error) {
+        best_error = std::abs(t_camera - t_strobe);
+        best = &(*it_strobe);
+      }
+    }
+
+    if (best != nullptr && best_error < tolerance) {
+      time_offset_vec_.push_back(t_camera - best->timestamp_teensy);
+      strobe_count_offset_vec_.push_back(camera.metadata.frame_counter - best->count_total);
+    } else if (t_newest > t_camera + tolerance || (TimeNow() - t_camera) > GetStaleTimeout()) {
+      // the strobe for this image should have arrived by now
+      failed = true;
+    } else {
+      break;
+    }
+    camera_buffer->pop_front();
+  }
+
+  // drop stale strobes
+  while (strobe_buffer->size() > 0 && (TimeNow() - strobe_buffer->front().timestamp_ros_rx) > GetStaleTimeout()) {
+    buffer_stats_.strobe.stale_count++;
+    strobe_buffer->pop_front();
+  }
+
+  // the matches must agree on the strobe to frame counter offset
+  if (!failed && strobe_count_offset_vec_.size() >= static_cast<std::size_t>(offset_sample_count_)) {
+    if (std::all_of(strobe_count_offset_vec_.begin(), strobe_count_offset_vec_.end(),
+                    [this](unsigned int offset) { return offset == strobe_count_offset_vec_.front(); })) {
+      double sum = 0.0;
+      for (std::size_t i = 0; i < time_offset_vec_.size(); i++) {
+        sum += time_offset_vec_[i];
+      }
+      time_offset_ = sum / static_cast<double>(time_offset_vec_.size());
+      strobe_count_offset_ = strobe_count_offset_vec_.front();
+      printf("strobe_count_offset: %i\n", strobe_count_offset_);
+      printf("(svis) Warm start validated, time_offset: %f\n", time_offset_);
+
+      validating_offsets_ = false;
+      SaveClockState();
     } else {
-      imu.timestamp_ros = imu.timestamp_teensy + GetTimeOffset();
+      failed = true;
+    }
+  }
+
+  // fall back to the full calibration, the setup packet puts the teensy back
+  // into pulse triggering
+  if (failed) {
+    printf("(svis) Warm start failed validation, calibrating\n");
+    SendSetup();
+    strobe_buffer->clear();
+    camera_buffer->clear();
+    time_offset_vec_.clear();
+    strobe_count_offset_vec_.clear();
+    validating_offsets_ = false;
+    sent_pulse_ = false;
+    init_flag_ = true;
+  }
+
+  timing_.compute_offsets = toc();
+}
+
+void SVIS::UpdateRxOffset(double rx_offset) {
+  // the envelope restarts every block so it follows the clock drift
+  const int block_size = 1000;
+  if (rx_offset_count_ > 0 && rx_offset_count_ % block_size == 0) {
+    rx_offset_min_last_ = rx_offset_min_;
+    rx_offset_min_ = std::numeric_limits<double>::infinity();
+  }
+
+  rx_offset_min_ = std::min(rx_offset_min_, rx_offset);
+  rx_offset_count_++;
+}
+
+double SVIS::GetRxOffset() const {
+  return std::min(rx_offset_min_, rx_offset_min_last_);
+}
+
+template <typename Layout>
+void SVIS::ParseHeader(const char* buf, HeaderPacket* header) {
+  tic();
+
+  protocol::ReportDecoder<Layout> report(reinterpret_cast<const uint8_t*>(buf));
+
+  // ros time
+  header->timestamp_ros_rx = TimeNow();
+
+  // counts are clamped to the report slots
+  header->send_count = report.GetSendCount();
+  header->imu_count = report.GetImuCount();
+  header->strobe_count = report.GetStrobeCount();
+
+  timing_.parse_header = toc();
+}
+
+template <typename Layout>
+void SVIS::ParseImu(const char* buf, const HeaderPacket& header, std::vector<ImuSample>* imu_samples) {
+  tic();
+
+  protocol::ReportDecoder<Layout> report(reinterpret_cast<const uint8_t*>(buf));
+
+  for (int i = 0; i < header.imu_count; i++) {
+    ImuSample imu;
+
+    // raw teensy timestamp
+    uint32_t stamp = report.GetImuStamp(i);
+    imu.timestamp_teensy = stamp_unwrapper_.Unwrap(stamp);
+
+    // switch sensitivity once we reach samples taken after a range change
+    if (sens_change_flag_ &&
+        static_cast<int32_t>(stamp - sens_change_stamp_) >= 0) {
+      gyro_sens_ = gyro_sens_next_;
+      acc_sens_ = acc_sens_next_;
+      sens_change_flag_ = false;
     }
-    
+    imu.acc_sens = acc_sens_;
+    imu.gyro_sens = gyro_sens_;
+
     // accel
-    memcpy(&imu.acc_raw[0], &buf[ind], sizeof(imu.acc_raw[0]));
-    ind += sizeof(imu.acc_raw[0]);
-    memcpy(&imu.acc_raw[1], &buf[ind], sizeof(imu.acc_raw[1]));
-    ind += sizeof(imu.acc_raw[1]);
-    memcpy(&imu.acc_raw[2], &buf[ind], sizeof(imu.acc_raw[2]));
-    ind += sizeof(imu.acc_raw[2]);
-    // printf("(svis) imu.acc_raw: [%i, %i, %i]\n", imu.acc_raw[0], imu.acc_raw[1], imu.acc_raw[2]);
-
-    // convert accel
-    imu.acc[0] = static_cast<float>(imu.acc_raw[0]) / acc_sens_arr_[acc_sens_] * g_;
-    imu.acc[1] = static_cast<float>(imu.acc_raw[1]) / acc_sens_arr_[acc_sens_] * g_;
-    imu.acc[2] = static_cast<float>(imu.acc_raw[2]) / acc_sens_arr_[acc_sens_] * g_;
-    // printf("(svis) imu.acc: [%0.2f, %0.2f, %0.2f]\n", imu.acc[0], imu.acc[1], imu.acc[2]);
+    imu.acc_raw[0] = report.GetImuAxis(i, 0);
+    imu.acc_raw[1] = report.GetImuAxis(i, 1);
+    imu.acc_raw[2] = report.GetImuAxis(i, 2);
 
     // gyro
-    memcpy(&imu.gyro_raw[0], &buf[ind], sizeof(imu.gyro_raw[0]));
-    ind += sizeof(imu.gyro_raw[0]);
-    memcpy(&imu.gyro_raw[1], &buf[ind], sizeof(imu.gyro_raw[1]));
-    ind += sizeof(imu.gyro_raw[1]);
-    memcpy(&imu.gyro_raw[2], &buf[ind], sizeof(imu.gyro_raw[2]));
-    ind += sizeof(imu.gyro_raw[2]);
-    // printf("(svis) imu.gyro_raw: [%i, %i, %i]\n", imu.gyro_raw[0], imu.gyro_raw[1], imu.gyro_raw[2]);
-
-    // convert gyro
-    imu.gyro[0] = static_cast<float>(imu.gyro_raw[0]) / gyro_sens_arr_[gyro_sens_] * rad_per_deg_;
-    imu.gyro[1] = static_cast<float>(imu.gyro_raw[1]) / gyro_sens_arr_[gyro_sens_] * rad_per_deg_;
-    imu.gyro[2] = static_cast<float>(imu.gyro_raw[2]) / gyro_sens_arr_[gyro_sens_] * rad_per_deg_;
-    // printf("(svis) imu.gyro: [%0.2f, %0.2f, %0.2f]\n", imu.gyro[0], imu.gyro[1], imu.gyro[2]);
+    imu.gyro_raw[0] = report.GetImuAxis(i, 3);
+    imu.gyro_raw[1] = report.GetImuAxis(i, 4);
+    imu.gyro_raw[2] = report.GetImuAxis(i, 5);
 
-    // save packet
-    imu_packets->push_back(imu);
-
-    timing_.parse_imu = toc();
+    // save sample
+    imu_samples->push_back(imu);
   }
+
+  timing_.parse_imu = toc();
 }
 
-void SVIS::ParseStrobe(const std::vector<char>& buf,
+template <typename Layout>
+void SVIS::ParseStrobe(const char* buf,
                      const HeaderPacket& header,
                      std::vector<StrobePacket>* strobe_packets) {
   tic();
 
-  for (uint i = 0; i < header.strobe_count; i++) {
+  protocol::ReportDecoder<Layout> report(reinterpret_cast<const uint8_t*>(buf));
+
+  for (int i = 0; i < header.strobe_count; i++) {
     StrobePacket strobe;
-    int ind = strobe_index[i];
 
     // ros time
     strobe.timestamp_ros_rx = header.timestamp_ros_rx;
 
     // timestamp
-    memcpy(&strobe.timestamp_teensy_raw, &buf[ind], sizeof(strobe.timestamp_teensy_raw));
-    // printf("(svis) strobe.timestamp: [%i, %i]\n", ind, strobe.timestamp);
-    ind += sizeof(strobe.timestamp_teensy_raw);
+    strobe.timestamp_teensy_raw = report.GetStrobeStamp(i);
+    uint64_t stamp = stamp_unwrapper_.Unwrap(strobe.timestamp_teensy_raw);
 
     // convert to seconds
-    strobe.timestamp_teensy = static_cast<double>(strobe.timestamp_teensy_raw) / 1000000.0;
+    strobe.timestamp_teensy = static_cast<double>(stamp) / 1000000.0;
 
     // teensy time in ros epoch
     if (init_flag_) {
       strobe.timestamp_ros = 0.0;
     } else {
-      strobe.timestamp_ros = strobe.timestamp_teensy + GetTimeOffset();
+      strobe.timestamp_ros = TeensyToRos(stamp);
     }
 
     // count
-    memcpy(&strobe.count, &buf[ind], sizeof(strobe.count));
-    // printf("(svis) strobe.count: [%i, %i]\n", ind, strobe.count);
-    ind += strobe.count;
+    strobe.count = report.GetStrobeCountValue(i);
 
     // save packet
     strobe_packets->push_back(strobe);
@@ -398,18 +1325,19 @@ void SVIS::ParseStrobe(const std::vector<char>& buf,
   timing_.parse_strobe = toc();
 }
 
-void SVIS::PushImu(const std::vector<ImuPacket>& imu_packets,
-                   boost::circular_buffer<ImuPacket>* imu_buffer) {
+void SVIS::PushImu(const std::vector<ImuSample>& imu_samples,
+                   ImuRing* imu_buffer) {
   tic();
 
-  ImuPacket imu;
-  for (uint i = 0; i < imu_packets.size(); i++) {
-    imu = imu_packets[i];
-    imu_buffer->push_back(imu);
+  for (std::size_t i = 0; i < imu_samples.size(); i++) {
+    if (!imu_buffer->PushBack(imu_samples[i])) {
+      buffer_stats_.imu.overflow_count++;
+    }
   }
+  buffer_stats_.imu.Update(imu_buffer->size(), imu_buffer->capacity());
 
   // warn if buffer is at max size
-  if (imu_buffer->size() == imu_buffer->max_size()) {
+  if (imu_buffer->full()) {
     printf("(svis) imu buffer at max size\n");
   }
 
@@ -423,31 +1351,33 @@ void SVIS::PushStrobe(const std::vector<StrobePacket>& strobe_packets,
   StrobePacket strobe;
   for (uint i = 0; i < strobe_packets.size(); i++) {
     strobe = strobe_packets[i];
+    if (strobe_buffer->full()) {
+      buffer_stats_.strobe.overflow_count++;
+    }
     strobe_buffer->push_back(strobe);
   }
+  buffer_stats_.strobe.Update(strobe_buffer->size(), strobe_buffer->capacity());
 
   // warn if buffer is at max size
-  if (strobe_buffer->size() == strobe_buffer->max_size()) {
+  if (strobe_buffer->full()) {
     printf("(svis) strobe buffer at max size\n");
   }
 
   timing_.push_strobe = toc();
 }
 
-void SVIS::DecimateImu(boost::circular_buffer<ImuPacket>* imu_buffer,
+void SVIS::DecimateImu(ImuRing* imu_buffer,
                        std::vector<ImuPacket>* imu_packets_filt) {
   // create filter packets
   while (imu_buffer->size() >= static_cast<std::size_t>(imu_filter_size_) && imu_filter_size_ > 0) {
-    for (int i = 0; i < imu_filter_size_; i++) {
-      if (i == 0) {
-        imu_packets_filt->push_back(imu_buffer->front());
-      }
-      imu_buffer->pop_front();
-    }
+    ImuPacket imu;
+    ConvertImu(imu_buffer->front(), &imu);
+    imu_packets_filt->push_back(imu);
+    imu_buffer->PopFront(imu_filter_size_);
   }
 }
 
-void SVIS::FilterImu(boost::circular_buffer<ImuPacket>* imu_buffer,
+void SVIS::FilterImu(ImuRing* imu_buffer,
                      std::vector<ImuPacket>* imu_packets_filt) {
   tic();
 
@@ -456,23 +1386,28 @@ void SVIS::FilterImu(boost::circular_buffer<ImuPacket>* imu_buffer,
     double timestamp_diff_mean = 0.0;
     double acc_mean[3] = {0.0};
     double gyro_mean[3] = {0.0};
+    double inv_size = 1.0 / static_cast<double>(imu_filter_size_);
 
     // get local time offset for better precision
-    double first_timestamp = imu_buffer->front().timestamp_ros;
-    
+    uint64_t first_timestamp = imu_buffer->GetTimestamp(0);
+
     for (int i = 0; i < imu_filter_size_; i++) {
-      ImuPacket temp_packet = imu_buffer->front();
-      imu_buffer->pop_front();
+      float acc_scale = acc_scale_arr_[imu_buffer->GetAccSens(i) & 0x03];
+      float gyro_scale = gyro_scale_arr_[imu_buffer->GetGyroSens(i) & 0x03];
 
-      timestamp_diff_mean += (temp_packet.timestamp_ros - first_timestamp) / static_cast<double>(imu_filter_size_);
-      for (uint j = 0; j < 3; j++) {
-        acc_mean[j] += temp_packet.acc[j] / static_cast<double>(imu_filter_size_);
-        gyro_mean[j] += temp_packet.gyro[j] / static_cast<double>(imu_filter_size_);
+      timestamp_diff_mean += static_cast<double>(imu_buffer->GetTimestamp(i) - first_timestamp) * inv_size;
+      for (int j = 0; j < 3; j++) {
+        acc_mean[j] += imu_buffer->GetAccRaw(i, j) * acc_scale * inv_size;
+        gyro_mean[j] += imu_buffer->GetGyroRaw(i, j) * gyro_scale * inv_size;
       }
     }
+    imu_buffer->PopFront(imu_filter_size_);
 
     ImuPacket filter_packet;
-    filter_packet.timestamp_ros = first_timestamp + timestamp_diff_mean;
+    uint64_t timestamp = first_timestamp + static_cast<uint64_t>(timestamp_diff_mean + 0.5);
+    filter_packet.timestamp_teensy_raw = static_cast<uint32_t>(timestamp);
+    filter_packet.timestamp_teensy = static_cast<double>(timestamp) / 1000000.0;
+    filter_packet.timestamp_ros = TeensyToRos(timestamp);
     for (uint j = 0; j < 3; j++) {
       filter_packet.acc[j] = acc_mean[j];
       filter_packet.gyro[j] = gyro_mean[j];
@@ -485,69 +1420,130 @@ void SVIS::FilterImu(boost::circular_buffer<ImuPacket>* imu_buffer,
   timing_.filter_imu = toc();
 }
 
-void SVIS::PrintBuffer(const std::vector<char>& buf) {
-  printf("(svis) buffer: ");
-  for (uint i = 0; i < buf.size(); i++) {
-    printf("%02X ", buf[i] & 255);
-  }
-  printf("\n");
-}
-
-void SVIS::ComputeStrobeTotal(std::vector<StrobePacket>* strobe_packets) {
+void SVIS::FirFilterImu(ImuRing* imu_buffer,
+                        std::vector<ImuPacket>* imu_packets_filt) {
   tic();
 
-  for (auto& str : (*strobe_packets)) {
-    // printf("strobe_count_total: %u\n", strobe_count_total_);
+  // the decimator keeps its own window, so the whole buffer is consumed
+  for (std::size_t i = 0; i < imu_buffer->size(); i++) {
+    float acc_scale = acc_scale_arr_[imu_buffer->GetAccSens(i) & 0x03];
+    float gyro_scale = gyro_scale_arr_[imu_buffer->GetGyroSens(i) & 0x03];
 
-    // initialize variables on first iteration
-    if (strobe_count_total_ == 0 && strobe_count_last_ == 0) {
-      // printf("init strobe count\n");
-      strobe_count_total_ = 1;
-      strobe_count_last_ = str.count_total;
-      str.count_total = strobe_count_total_;
-      continue;
+    float axes[ImuDecimator::kAxes];
+    for (int j = 0; j < 3; j++) {
+      axes[j] = imu_buffer->GetAccRaw(i, j) * acc_scale;
+      axes[3 + j] = imu_buffer->GetGyroRaw(i, j) * gyro_scale;
     }
 
-    // get count difference between two most recent strobe messages
-    uint8_t diff = 0;
-    if (str.count > strobe_count_last_) {
-      // no rollover
-      diff = str.count - strobe_count_last_;
-    } else if (str.count < strobe_count_last_) {
-      // rollover
-      diff = (strobe_count_last_ + str.count);
-
-      // handle rollover
-      if (diff == 255) {
-        // printf("(svis) Handle rollover\n");
-        diff = 1;
-      }
-    } else {
-      // no change
-      printf("(svis) no change in strobe count\n");
+    uint64_t timestamp = 0;
+    float axes_filt[ImuDecimator::kAxes];
+    if (!imu_decimator_.Push(imu_buffer->GetTimestamp(i), axes, &timestamp, axes_filt)) {
+      continue;
     }
 
-    // check diff value
-    if (diff > 1 && !std::isinf(strobe_count_last_) && !init_flag_) {
-      printf("(svis) detected jump in strobe count\n");
-      // printf("(svis) diff: %i, last: %i, count: %i\n",
-      //              diff,
-      //              strobe_count_last_,
-      //              strobe_packets[i].count);
-    } else if (diff < 1 && !std::isinf(strobe_count_last_)) {
-      printf("(svis) detected lag in strobe count\n");
+    ImuPacket filter_packet;
+    filter_packet.timestamp_teensy_raw = static_cast<uint32_t>(timestamp);
+    filter_packet.timestamp_teensy = static_cast<double>(timestamp) / 1000000.0;
+    filter_packet.timestamp_ros = TeensyToRos(timestamp);
+    for (int j = 0; j < 3; j++) {
+      filter_packet.acc[j] = axes_filt[j];
+      filter_packet.gyro[j] = axes_filt[3 + j];
     }
 
-    // update count
-    strobe_count_total_ += diff;
+    // save packet
+    imu_packets_filt->push_back(filter_packet);
+  }
+  imu_buffer->PopFront(imu_buffer->size());
+
+  timing_.filter_imu = toc();
+}
+
+void SVIS::ConfigureFramePool() {
+  FramePool::Backing backing = FramePool::kHeap;
+  if (frame_pool_backing_ == "locked") {
+    backing = FramePool::kLocked;
+  } else if (frame_pool_backing_ == "huge") {
+    backing = FramePool::kHugePage;
+  }
 
-    // set packet total
-    str.count_total = strobe_count_total_;
+  // enough free frames to refill the camera queue and buffer
+  FramePool::Default().SetBacking(backing);
+  FramePool::Default().SetMaxFree(camera_queue_size_ + camera_buffer_.capacity());
+}
 
-    // update last value
-    strobe_count_last_ = str.count;
+void SVIS::ConfigureBuffers() {
+  // hold buffer_latency_ worth of data at the current rates unless set explicitly
+  std::size_t imu_size = imu_buffer_size_;
+  if (imu_size == 0) {
+    imu_size = std::max<std::size_t>(64, std::ceil(imu_rate_ * buffer_latency_));
+  }
+  std::size_t strobe_size = strobe_buffer_size_;
+  if (strobe_size == 0) {
+    strobe_size = std::max<std::size_t>(30, std::ceil(camera_rate_ * buffer_latency_));
   }
+  std::size_t camera_size = camera_buffer_size_;
+  if (camera_size == 0) {
+    camera_size = std::max<std::size_t>(30, std::ceil(camera_rate_ * buffer_latency_));
+  }
+
+  // resizing the imu ring clears it, it is drained every update so little is lost
+  std::size_t imu_capacity = 1;
+  while (imu_capacity < imu_size) {
+    imu_capacity <<= 1;
+  }
+  if (imu_capacity != imu_buffer_.capacity()) {
+    imu_buffer_.SetCapacity(imu_size);
+  }
+  strobe_buffer_.set_capacity(strobe_size);
+  camera_buffer_.set_capacity(camera_size);
+
+  buffer_stats_.imu.Update(imu_buffer_.size(), imu_buffer_.capacity());
+  buffer_stats_.strobe.Update(strobe_buffer_.size(), strobe_buffer_.capacity());
+  buffer_stats_.camera.Update(camera_buffer_.size(), camera_buffer_.capacity());
+
+  printf("(svis) buffer capacities imu: %zu, strobe: %zu, camera: %zu, stale timeout: %f s\n",
+         imu_buffer_.capacity(), strobe_buffer_.capacity(), camera_buffer_.capacity(),
+         GetStaleTimeout());
+}
+
+double SVIS::GetStaleTimeout() const {
+  return stale_timeout_ > 0.0 ? stale_timeout_ : buffer_latency_;
+}
 
+void SVIS::ConfigureImuFilter() {
+  int ratio = imu_filter_size_ > 0 ? imu_filter_size_ : 1;
+  double cutoff = imu_filter_cutoff_;
+  if (cutoff <= 0.0) {
+    cutoff = 0.8 * 0.5 * imu_rate_ / ratio;
+  }
+
+  imu_decimator_.Configure(ratio, cutoff / imu_rate_, imu_filter_taps_);
+}
+
+void SVIS::ConfigureImuResampler() {
+  ImuResampler::Method method = ImuResampler::kCubic;
+  if (imu_resample_method_ == "linear") {
+    method = ImuResampler::kLinear;
+  }
+
+  imu_resampler_.Configure(imu_resample_rate_, imu_rate_, method);
+
+  // one update rarely holds more than a few reports of samples
+  imu_packets_resampled_.reserve(256);
+}
+
+template <typename Layout>
+void SVIS::PrintBuffer(const char* buf) {
+  printf("(svis) buffer: ");
+  for (int i = 0; i < Layout::report_size; i++) {
+    printf("%02X ", buf[i] & 255);
+  }
+  printf("\n");
+}
+
+void SVIS::ComputeStrobeTotal(std::vector<StrobePacket>* strobe_packets) {
+  tic();
+  strobe_counter_.Count(strobe_packets, !init_flag_);
   timing_.compute_strobe_total = toc();
 }
 
@@ -557,7 +1553,7 @@ void SVIS::Associate(boost::circular_buffer<StrobePacket>* strobe_buffer,
   tic();
 
   // create camera strobe packets
-  CameraStrobePacket camera_strobe;
+  double stale_timeout = GetStaleTimeout();
   int fail_count = 0;
   int match_count = 0;
   bool match = false;
@@ -573,8 +1569,10 @@ void SVIS::Associate(boost::circular_buffer<StrobePacket>* strobe_buffer,
       // check for strobe/camera match
       if ((*it_strobe).count_total + strobe_count_offset_ ==
           (*it_camera).metadata.frame_counter) {
-        // copy matched elements
-        camera_strobe.camera = *it_camera;
+        // move matched elements, the image storage goes along with it and
+        // the moved from camera is only erased below
+        CameraStrobePacket camera_strobe;
+        camera_strobe.camera = std::move(*it_camera);
         camera_strobe.strobe = *it_strobe;
 
         // fix timestamps
@@ -583,7 +1581,7 @@ void SVIS::Associate(boost::circular_buffer<StrobePacket>* strobe_buffer,
         // camera_strobe.camera.image.header.stamp = ros::Time(camera_strobe.strobe.timestamp_ros);
 
         // push to buffer
-        camera_strobe_packets->push_back(camera_strobe);
+        camera_strobe_packets->push_back(std::move(camera_strobe));
 
         // remove matched strobe
         // printf("delete matched camera\n");
@@ -596,8 +1594,9 @@ void SVIS::Associate(boost::circular_buffer<StrobePacket>* strobe_buffer,
         break;
       } else {
         // check for stale entry and delete
-        if ((TimeNow() - (*it_camera).image.header.stamp) > 1.0) {
+        if ((TimeNow() - (*it_camera).image.header.stamp) > stale_timeout) {
           // printf("delete stale camera\n");
+          buffer_stats_.camera.stale_count++;
           it_camera = camera_buffer->erase(it_camera);
         } else {
           // printf("increment camera\n");
@@ -616,8 +1615,9 @@ void SVIS::Associate(boost::circular_buffer<StrobePacket>* strobe_buffer,
       // printf("fail\n");
 
       // check for stale entry and delete
-      if ((TimeNow() - (*it_strobe).timestamp_ros_rx) > 1.0) {
+      if ((TimeNow() - (*it_strobe).timestamp_ros_rx) > stale_timeout) {
         printf("(svis ros) Delete stale strobe\n");
+        buffer_stats_.strobe.stale_count++;
         it_strobe = strobe_buffer->erase(it_strobe);
       } else {
         // printf("increment strobe\n");
@@ -628,14 +1628,85 @@ void SVIS::Associate(boost::circular_buffer<StrobePacket>* strobe_buffer,
 
   // printf("final fail_count: %i\n", fail_count);
   // printf("final match_count: %i\n", match_count);
-  if (static_cast<std::size_t>(fail_count) == strobe_buffer->max_size()) {
+  if (static_cast<std::size_t>(fail_count) == strobe_buffer->capacity()) {
     printf("Failure to match.  Resyncing...\n");
     sync_flag_ = true;
   }
 
+  buffer_stats_.strobe.Update(strobe_buffer->size(), strobe_buffer->capacity());
+  buffer_stats_.camera.Update(camera_buffer->size(), camera_buffer->capacity());
+
   timing_.associate = toc();
 }
 
+void SVIS::PreintegrateImu(std::vector<CameraStrobePacket>* camera_strobe_packets) {
+  tic();
+
+  // packets are in strobe order, so each frame starts where the last one ended
+  for (std::size_t i = 0; i < camera_strobe_packets->size(); i++) {
+    CameraStrobePacket& packet = (*camera_strobe_packets)[i];
+    double t_frame = packet.strobe.timestamp_ros;
+
+    if (preint_t_last_ > 0.0 && t_frame > preint_t_last_) {
+      if (!Preintegrate(preint_t_last_, t_frame, &packet.imu)) {
+        printf("(svis) Imu history does not cover frame interval [%f, %f]\n",
+               preint_t_last_, t_frame);
+      }
+    }
+
+    preint_t_last_ = t_frame;
+  }
+
+  timing_.preintegrate_imu = toc();
+}
+
+bool SVIS::Preintegrate(double t0, double t1, PreintegratedImu* preint) {
+  preintegrator_.Reset(t0);
+  *preint = preintegrator_.Get();
+  preint->t1 = t1;
+
+  // bracket the full rate samples with values interpolated at the frame times
+  ImuPacket start;
+  ImuPacket end;
+  if (!imu_history_.Interpolate(t0, &start) || !imu_history_.Interpolate(t1, &end)) {
+    return false;
+  }
+
+  preint_samples_.clear();
+  preint_samples_.push_back(start);
+  std::size_t sample_count = imu_history_.GetRange(t0, t1, &preint_samples_);
+  preint_samples_.push_back(end);
+
+  // samples still in the teensy journal leave a hole the interpolation would
+  // bridge, the frame goes out without preintegration
+  double max_step = 2.5 / imu_rate_;
+  for (std::size_t i = 1; i < preint_samples_.size(); i++) {
+    if (preint_samples_[i].timestamp_ros - preint_samples_[i - 1].timestamp_ros > max_step) {
+      return false;
+    }
+  }
+
+  // midpoint of consecutive samples held over each step
+  for (std::size_t i = 1; i < preint_samples_.size(); i++) {
+    const ImuPacket& a = preint_samples_[i - 1];
+    const ImuPacket& b = preint_samples_[i];
+    double acc[3];
+    double gyro[3];
+    for (int j = 0; j < 3; j++) {
+      acc[j] = 0.5 * (a.acc[j] + b.acc[j]);
+      gyro[j] = 0.5 * (a.gyro[j] + b.gyro[j]);
+    }
+    preintegrator_.Integrate(acc, gyro, b.timestamp_ros - a.timestamp_ros);
+  }
+
+  *preint = preintegrator_.Get();
+  preint->valid = true;
+  preint->t1 = t1;  // avoid accumulated rounding in the step sum
+  preint->sample_count = static_cast<int>(sample_count);
+
+  return true;
+}
+
 void SVIS::PrintCameraBuffer(const boost::circular_buffer<CameraPacket>& camera_buffer) {
   double t_now = TimeNow();
   printf("camera_buffer: %lu\n", camera_buffer.size());
@@ -742,6 +1813,10 @@ void SVIS::SetPublishImuHandler(std::function<void(const ImuPacket&)> handler) {
   PublishImu = handler;
 }
 
+void SVIS::SetPublishImuResampledHandler(std::function<void(const std::vector<ImuPacket>&)> handler) {
+  PublishImuResampled = handler;
+}
+
 void SVIS::SetPublishCameraHandler(std::function<void(std::vector<CameraStrobePacket>&)> handler) {
   PublishCamera = handler;
 }
@@ -7,16 +7,37 @@
 #include <stdarg.h>
 #include <sys/ioctl.h>
 
+#include <atomic>
 #include <chrono>
+#include <deque>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
 #include <boost/circular_buffer.hpp>
 
 #include "svis/timing.h"
+#include "svis/buffer_stats.h"
 #include "svis/header_packet.h"
+#include "svis/imu_decimator.h"
+#include "svis/imu_history.h"
 #include "svis/imu_packet.h"
+#include "svis/imu_preintegration.h"
+#include "svis/imu_resampler.h"
+#include "svis/imu_ring.h"
+#include "svis/imu_sample.h"
+#include "svis/mpsc_queue.h"
+#include "svis/strobe_counter.h"
 #include "svis/strobe_packet.h"
 #include "svis/camera_packet.h"
 #include "svis/camera_strobe_packet.h"
+#include "svis/clock_estimator.h"
+#include "svis/clock_state.h"
+#include "svis/command_packet.h"
 #include "svis/image.h"
+#include "svis/protocol.h"
+#include "svis/report_sequencer.h"
+#include "svis/serial_port.h"
 
 extern "C" {
 #include "svis_hid/svis_hid.h"
@@ -28,8 +49,11 @@ class SVIS {
  public:
   SVIS();
   void Update();
+  void Open();
   void OpenHID();
+  void OpenSerial();
   int ReadHID(std::vector<char>* buf);
+  int ReadSerial();
   void SendSetup();
   void tic();
   double toc();
@@ -39,11 +63,33 @@ class SVIS {
   std::size_t GetCameraBufferSize() const;
   std::size_t GetCameraBufferMaxSize() const;
   bool GetSyncFlag() const;
-  void PushCameraPacket(const svis::CameraPacket& camera_packet);
-  
+
+  // thread safe, queues the packet for the next Update
+  // returns false if the queue was full and the packet dropped
+  bool PushCameraPacket(svis::CameraPacket camera_packet);
+
+  // images waiting for Update, resizing is not thread safe so this has to
+  // happen before anything calls PushCameraPacket
+  void SetCameraQueueSize(int camera_queue_size);
+
+  // buffer fill and loss counters for sizing the buffers below
+  const BufferStats& GetBufferStats() const;
+
+  // runtime configuration, acknowledged by the teensy and retried until then
+  void SetCameraRate(int camera_rate);
+  void SetImuRange(int gyro_sens, int acc_sens);
+  void SetImuRate(int imu_rate);
+  void SetImuDlpf(int imu_dlpf);
+  void SetTriggerDuration(int trigger_duration);
+  std::size_t GetPendingCommandCount() const;
+
+  // full rate imu history in ros time for interpolation and integration queries
+  const ImuHistory& GetImuHistory() const;
+
   void SetPublishStrobeRawHandler(std::function<void(const std::vector<StrobePacket>&)> handler);
   void SetPublishImuRawHandler(std::function<void(const std::vector<ImuPacket>&)> handler);
   void SetPublishImuHandler(std::function<void(const ImuPacket&)> handler);
+  void SetPublishImuResampledHandler(std::function<void(const std::vector<ImuPacket>&)> handler);
   void SetPublishCameraHandler(std::function<void(std::vector<CameraStrobePacket>&)> handler);
   void SetPublishTimingHandler(std::function<void(const Timing&)> handler);
   void SetTimeNowHandler(std::function<double()> handler);
@@ -52,9 +98,35 @@ class SVIS {
   int camera_rate_ = 0;
   int gyro_sens_ = 0;  // gyro sensitivity selection [0,3]
   int acc_sens_ = 0;  // acc sensitivity selection [0,3]
-  int imu_filter_size_ = 0;
+  int imu_filter_size_ = 0;  // decimation ratio
+  std::string imu_filter_mode_ = "box";  // "box", "decimate" or "fir"
+  float imu_filter_cutoff_ = 0.0;  // [Hz] fir corner, 0 uses 0.8 of the output nyquist
+  int imu_filter_taps_ = 63;  // fir length
+  float imu_resample_rate_ = 0.0;  // [Hz] uniform grid output in ros time, 0 disables
+  std::string imu_resample_method_ = "cubic";  // "linear" or "cubic"
+  int imu_rate_ = 1000;  // [Hz]
+  int imu_dlpf_ = 0;  // dlpf_cfg [0,7]
+  int trigger_duration_ = 1000;  // [us]
   int offset_sample_count_ = 5;
+  std::string offset_bootstrap_ = "pulse";  // "pulse" one trigger per offset_sample_time_, "burst" all in one pass
+  float buffer_latency_ = 1.0;  // [s] publish stall the buffers absorb, sizes them from the rates
+  int imu_buffer_size_ = 0;  // explicit capacities, 0 derives from buffer_latency_
+  int strobe_buffer_size_ = 0;
+  int camera_buffer_size_ = 0;
+  std::string frame_pool_backing_ = "heap";  // image storage: "heap", "locked" or "huge"
+  float stale_timeout_ = 0.0;  // [s] unmatched strobes and images are dropped after, 0 uses buffer_latency_
   float offset_sample_time_ = 0.5;  // [s]
+  std::string transport_ = "hid";  // "hid" or "serial"
+  std::string serial_device_ = "/dev/ttyACM0";
+  int command_retry_count_ = 5;
+  float command_timeout_ = 0.05;  // [s]
+  bool use_sof_clock_ = false;  // map teensy time with usb start of frame reports
+  int imu_history_size_ = 10000;  // full rate samples kept for queries
+  bool preintegrate_imu_ = false;  // attach preintegrated imu to each camera frame
+  std::string clock_state_file_ = "";  // persisted clock calibration for warm starts, empty disables
+  std::string link_state_file_ = "";  // persisted send count to backfill across host restarts, empty disables
+  std::string device_id_ = "";  // clock state key, empty uses the usb serial number or serial device
+  std::string camera_id_ = "camera";  // clock state key
 
   // timing
   Timing timing_;
@@ -62,31 +134,75 @@ class SVIS {
   std::chrono::time_point<std::chrono::high_resolution_clock> tic_;
 
  private:
-  void ParseBuffer(const std::vector<char>& buf,
-                      std::vector<ImuPacket>* imu_packets,
+  template <typename Layout>
+  bool ProcessReport(const char* buf);
+  template <typename Layout>
+  void ParseBuffer(const char* buf,
+                      HeaderPacket* header,
+                      std::vector<ImuSample>* imu_samples,
                       std::vector<StrobePacket>* strobe_packets);
+  template <typename Layout>
+  void HandleBackfill(const char* buf);
+  void ServiceBackfill();
+  void ServiceResume();
+  void SendPacket(std::vector<char>* buf);
   void SendPulse();
   void SendDisablePulse();
-  bool CheckChecksum(const std::vector<char>& buf);
+  void SendBurst(int count);
+  void SendCommand(uint8_t command, const std::vector<char>& payload,
+                   int32_t arg0, int32_t arg1);
+  void ServiceCommands();
+  void HandleAck(const char* buf);
+  void HandleClock(const char* buf);
+  void HandleStatus(const char* buf);
+  double TeensyToRos(uint64_t stamp);
+  void ConvertImu(const ImuSample& sample, ImuPacket* imu);
+  template <typename Layout>
+  bool CheckChecksum(const char* buf);
   void ComputeOffsets(boost::circular_buffer<StrobePacket>* strobe_buffer,
                      boost::circular_buffer<CameraPacket>* camera_buffer);
-  void ParseHeader(const std::vector<char>& buf,
+  void ComputeSofOffsets(boost::circular_buffer<StrobePacket>* strobe_buffer,
+                         boost::circular_buffer<CameraPacket>* camera_buffer);
+  void BootstrapOffsets(boost::circular_buffer<StrobePacket>* strobe_buffer,
+                        boost::circular_buffer<CameraPacket>* camera_buffer);
+  void LoadClockState();
+  void SaveClockState();
+  void WarmStart();
+  void LoadLinkState();
+  void SaveLinkState();
+  void ValidateOffsets(boost::circular_buffer<StrobePacket>* strobe_buffer,
+                       boost::circular_buffer<CameraPacket>* camera_buffer);
+  void UpdateRxOffset(double rx_offset);
+  double GetRxOffset() const;
+  template <typename Layout>
+  void ParseHeader(const char* buf,
                  HeaderPacket* header);
-  void ParseImu(const std::vector<char>& buf,
+  template <typename Layout>
+  void ParseImu(const char* buf,
               const HeaderPacket& header,
-              std::vector<ImuPacket>* imu_packets);
-  void ParseStrobe(const std::vector<char>& buf,
+              std::vector<ImuSample>* imu_samples);
+  template <typename Layout>
+  void ParseStrobe(const char* buf,
                  const HeaderPacket& header,
                  std::vector<StrobePacket>* strobe_packets);
-  void PushImu(const std::vector<ImuPacket>& imu_packets,
-               boost::circular_buffer<ImuPacket>* imu_buffer);
+  void PushImu(const std::vector<ImuSample>& imu_samples,
+               ImuRing* imu_buffer);
   void PushStrobe(const std::vector<StrobePacket>& strobe_packets,
                   boost::circular_buffer<StrobePacket>* strobe_buffer);
-  void FilterImu(boost::circular_buffer<ImuPacket>* imu_buffer,
+  void FilterImu(ImuRing* imu_buffer,
                  std::vector<ImuPacket>* imu_packets_filt);
-  void DecimateImu(boost::circular_buffer<ImuPacket>* imu_buffer,
+  void DecimateImu(ImuRing* imu_buffer,
                  std::vector<ImuPacket>* imu_packets_filt);
-  void PrintBuffer(const std::vector<char>& buf);
+  void FirFilterImu(ImuRing* imu_buffer,
+                    std::vector<ImuPacket>* imu_packets_filt);
+  void ConfigureBuffers();
+  void ConfigureFramePool();
+  void DrainCameraQueue();
+  double GetStaleTimeout() const;
+  void ConfigureImuFilter();
+  void ConfigureImuResampler();
+  template <typename Layout>
+  void PrintBuffer(const char* buf);
   // void PrintImageQuadlet(const std::string& name,
   //                        const sensor_msgs::Image::ConstPtr& msg,
   //                        const int& i);
@@ -95,6 +211,8 @@ class SVIS {
   void Associate(boost::circular_buffer<StrobePacket>* strobe_buffer,
                  boost::circular_buffer<CameraPacket>* camera_buffer,
                  std::vector<CameraStrobePacket>* camera_strobe_packets);
+  void PreintegrateImu(std::vector<CameraStrobePacket>* camera_strobe_packets);
+  bool Preintegrate(double t0, double t1, PreintegratedImu* preint);
   void PrintCameraBuffer(const boost::circular_buffer<CameraPacket>& camera_buffer);
   void PrintStrobeBuffer(const boost::circular_buffer<StrobePacket>& strobe_buffer);
 
@@ -102,52 +220,98 @@ class SVIS {
   std::function<void(const std::vector<svis::StrobePacket>&)> PublishStrobeRaw;
   std::function<void(const std::vector<svis::ImuPacket>&)> PublishImuRaw;
   std::function<void(const svis::ImuPacket&)> PublishImu;
+  std::function<void(const std::vector<svis::ImuPacket>&)> PublishImuResampled;
   std::function<void(std::vector<svis::CameraStrobePacket>&)> PublishCamera;
   std::function<void(const Timing&)> PublishTiming;
   std::function<double()> TimeNow;
 
+  // serial transport
+  SerialPort serial_port_;
+
+  // usb start of frame clock
+  ClockEstimator clock_estimator_;
+
   // buffers
-  boost::circular_buffer<ImuPacket> imu_buffer_;
+  ImuRing imu_buffer_;
+  ImuDecimator imu_decimator_;
   boost::circular_buffer<StrobePacket> strobe_buffer_;
   boost::circular_buffer<CameraPacket> camera_buffer_;
+  BufferStats buffer_stats_;
+
+  // camera ingest from ros callback threads, drained by Update
+  MpscQueue<CameraPacket> camera_queue_;
+  int camera_queue_size_ = 64;
+  std::atomic<uint64_t> camera_queue_drops_{0};
 
-  // constants
-  const double g_ = 9.80665;
-  const double rad_per_deg_ = 0.0174533;
+  // commands
+  std::deque<CommandPacket> commands_;
+  uint8_t request_id_ = 0;
 
-  // imu
-  double gyro_sens_arr_[4] = {131, 65.5, 32.8, 16.4};  // LSB/(deg/s)
-  double acc_sens_arr_[4] = {16384, 8192, 4096, 2048};  // LSB/g
+  // send count gaps are replayed from the teensy journal when it has one,
+  // requests are spaced out so their acks never crowd out the live reports
+  ReportSequencer report_sequencer_;
+
+  // where the last host or the last setup left off, resumed once the teensy
+  // epoch is known so the replays can be published, see svis/clock_state.h
+  uint32_t session_ = 0;  // from the status reports
+  bool resume_pending_ = false;
+  LinkState link_state_;
+
+  // full rate imu in ros time
+  ImuHistory imu_history_;
+
+  // full rate imu on a uniform grid, published each update
+  ImuResampler imu_resampler_;
+  std::vector<ImuPacket> imu_packets_resampled_;
+
+  // imu preintegration between camera frames
+  ImuPreintegrator preintegrator_;
+  std::vector<ImuPacket> preint_samples_;
+  double preint_t_last_ = 0.0;  // [seconds] previous frame in ros epoch
+
+  // teensy stamps extended past the 32 bit wrap
+  StampUnwrapper stamp_unwrapper_;
+
+  // reciprocal imu scales per sensitivity selection
+  float acc_scale_arr_[4];
+  float gyro_scale_arr_[4];
+
+  // imu sensitivity change that takes effect at a teensy timestamp
+  bool sens_change_flag_ = false;
+  uint32_t sens_change_stamp_ = 0;
+  int gyro_sens_next_ = 0;
+  int acc_sens_next_ = 0;
 
   // camera and strobe timing
   bool init_flag_ = true;
   bool sent_pulse_ = false;
+  double sof_latency_ = -1.0;  // [s] camera latency from a single pulse, negative until measured
   std::deque<double> time_offset_vec_;
   double time_offset_ = 0.0;
   int init_count_ = 0;
 
   // camera and strobe count
   bool sync_flag_ = true;
-  uint8_t strobe_count_last_ = 0;
-  unsigned int strobe_count_total_ = std::numeric_limits<unsigned int>::infinity();
+  StrobeCounter strobe_counter_;
   unsigned int strobe_count_offset_ = 0;
+  std::deque<unsigned int> strobe_count_offset_vec_;
+
+  // warm start from the persisted clock state, see svis/clock_state.h
+  bool warm_start_ = false;
+  bool validating_offsets_ = false;
+  ClockState clock_state_;
+
+  // lower envelope of host_rx - teensy stamp over the last one to two blocks of reports
+  double rx_offset_min_ = std::numeric_limits<double>::infinity();
+  double rx_offset_min_last_ = std::numeric_limits<double>::infinity();
+  int rx_offset_count_ = 0;
 
-  // hid usb packet sizes
-  const int imu_data_size = 6;  // (int16_t) [ax, ay, az, gx, gy, gz]
-  const int imu_buffer_size = 10;  // store 10 samples (imu_stamp, imu_data) in circular buffers
-  const int imu_packet_size = 16;  // (int8_t) [imu_stamp[0], ... , imu_stamp[3], imu_data[0], ... , imu_data[11]]
-  const int strobe_buffer_size = 10;  // store 10 samples (strobe_stamp, strobe_count) in circular buffers
-  const int strobe_packet_size = 5;  // (int8_t) [strobe_stamp[0], ... , strobe_stamp[3], strobe_count]
-  const int send_buffer_size = 64;  // (int8_t) size of HID USB packets
-  const int send_header_size = 4;  // (int8_t) [send_count[0], send_count[1], imu_count, strobe_count];
-
-  // hid usb packet indices
-  const int send_count_index = 0;
-  const int imu_count_index = 2;
-  const int strobe_count_index = 3;
-  const int imu_index[3] = {4, 20, 36};
-  const int strobe_index[2] = {52, 57};
-  const int checksum_index = 62;
+  // report layouts, see svis/protocol.h
+  // data reports are wider on serial, commands stay hid sized on both transports
+  // and ack and clock fields sit at the same offsets in every layout
+  typedef protocol::HidReport Report;
+  typedef protocol::SerialReport SerialReport;
+  typedef protocol::ReportDecoder<Report> ReportDecoder;
 
   // debug
   bool print_buffer_ = false;
@@ -23,6 +23,7 @@ struct Timing {
   float filter_imu = std::numeric_limits<float>::quiet_NaN();
   float publish_imu = std::numeric_limits<float>::quiet_NaN();
   float associate = std::numeric_limits<float>::quiet_NaN();
+  float preintegrate_imu = std::numeric_limits<float>::quiet_NaN();
   float publish_camera = std::numeric_limits<float>::quiet_NaN();
   float update = std::numeric_limits<float>::quiet_NaN();
   float period = std::numeric_limits<float>::quiet_NaN();
@@ -6,6 +6,7 @@
  *  rawhid_recv - receive a packet
  *  rawhid_send - send a packet
  *  rawhid_close - close a device
+ *  rawhid_serial - read the usb serial number
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -288,6 +289,27 @@ void rawhid_close(int num)
 	hid_close(hid);
 }
 
+//  rawhid_serial - read the usb serial number string
+//
+//    Inputs:
+//	num = device to read (zero based)
+//	buf = buffer to receive the string
+//	len = buffer's size
+//    Output:
+//	length of the string, or -1 on error
+//
+int rawhid_serial(int num, char *buf, int len)
+{
+	hid_t *hid;
+	struct usb_device *dev;
+
+	hid = get_hid(num);
+	if (!hid || !hid->open) return -1;
+	dev = usb_device(hid->usb);
+	if (!dev || !dev->descriptor.iSerialNumber) return -1;
+	return usb_get_string_simple(hid->usb, dev->descriptor.iSerialNumber, buf, len);
+}
+
 // Chuck Robey wrote a real HID report parser
 // (chuckr@telenix.org) chuckr@chuckr.org
 // http://people.freebsd.org/~chuckr/code/python/uhidParser-0.2.tbz
@@ -25,6 +25,11 @@ SVISRos::SVISRos()
 				       std::placeholders::_1);
   svis_.SetPublishImuHandler(publish_imu_handler);
 
+  // setup PublishImuResampled handler
+  auto publish_imu_resampled_handler = std::bind(&SVISRos::PublishImuResampled, this,
+                                                 std::placeholders::_1);
+  svis_.SetPublishImuResampledHandler(publish_imu_resampled_handler);
+
   // setup PublishCamera handler
   auto publish_camera_handler = std::bind(&SVISRos::PublishCamera, this,
                                               std::placeholders::_1);
@@ -44,27 +49,51 @@ void SVISRos::Run() {
   GetParams();
   InitSubscribers();
   InitPublishers();
+
+  // the clock state is kept per camera topic
+  svis_.camera_id_ = camera_sub_.getTopic();
+  InitServices();
   ConfigureCamera();
 
   // setup comms and send init packet
-  svis_.OpenHID();
+  svis_.Open();
 
   // send setup packet
   svis_.SendSetup();
 
+  // camera and service callbacks on their own threads, the camera queue and
+  // svis_mutex_ keep them off the usb processing below
+  std::unique_ptr<ros::AsyncSpinner> spinner;
+  if (spinner_threads_ > 0) {
+    spinner.reset(new ros::AsyncSpinner(spinner_threads_));
+    spinner->start();
+  }
+
   ros::Time t_start = ros::Time::now();
   ros::Time t_start_last = t_start;
+  ros::Time t_stats_last = t_start;
   ros::Rate r(1000);
   while (ros::ok() && !stop_signal_) {
     t_start = ros::Time::now();
     svis_.timing_.period = (t_start - t_start_last).toSec();
     t_start_last = t_start;
 
-    svis_.tic();
-    ros::spinOnce();
-    svis_.timing_.ros_spin_once = svis_.toc();
+    if (!spinner) {
+      svis_.tic();
+      ros::spinOnce();
+      svis_.timing_.ros_spin_once = svis_.toc();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(svis_mutex_);
+      svis_.Update();
 
-    svis_.Update();
+      // buffer stats at 1 Hz
+      if ((t_start - t_stats_last).toSec() >= 1.0) {
+        PublishBufferStats(svis_.GetBufferStats());
+        t_stats_last = t_start;
+      }
+    }
 
     if (!received_camera_) {
       ROS_WARN_THROTTLE(0.5, "(svis_ros) Have not received camera message");
@@ -139,88 +168,185 @@ void SVISRos::GetParams() {
   SafeGetParam(pnh, "gyro_sens", svis_.gyro_sens_);
   SafeGetParam(pnh, "acc_sens", svis_.acc_sens_);
   SafeGetParam(pnh, "imu_filter_size", svis_.imu_filter_size_);
+  SafeGetParam(pnh, "imu_filter_mode", svis_.imu_filter_mode_);
+  SafeGetParam(pnh, "imu_filter_cutoff", svis_.imu_filter_cutoff_);
+  SafeGetParam(pnh, "imu_filter_taps", svis_.imu_filter_taps_);
+  SafeGetParam(pnh, "imu_resample_rate", svis_.imu_resample_rate_);
+  SafeGetParam(pnh, "imu_resample_method", svis_.imu_resample_method_);
   SafeGetParam(pnh, "offset_sample_count", svis_.offset_sample_count_);
   SafeGetParam(pnh, "offset_sample_time", svis_.offset_sample_time_);
+  SafeGetParam(pnh, "offset_bootstrap", svis_.offset_bootstrap_);
+  SafeGetParam(pnh, "buffer_latency", svis_.buffer_latency_);
+  SafeGetParam(pnh, "imu_buffer_size", svis_.imu_buffer_size_);
+  SafeGetParam(pnh, "strobe_buffer_size", svis_.strobe_buffer_size_);
+  SafeGetParam(pnh, "camera_buffer_size", svis_.camera_buffer_size_);
+  SafeGetParam(pnh, "stale_timeout", svis_.stale_timeout_);
+  SafeGetParam(pnh, "transport", svis_.transport_);
+  SafeGetParam(pnh, "serial_device", svis_.serial_device_);
+  SafeGetParam(pnh, "use_sof_clock", svis_.use_sof_clock_);
+
+  // sized here, before InitSubscribers starts the camera callback
+  int camera_queue_size = 0;
+  SafeGetParam(pnh, "camera_queue_size", camera_queue_size);
+  svis_.SetCameraQueueSize(camera_queue_size);
+
+  SafeGetParam(pnh, "frame_pool_backing", svis_.frame_pool_backing_);
+  SafeGetParam(pnh, "spinner_threads", spinner_threads_);
+  SafeGetParam(pnh, "imu_history_size", svis_.imu_history_size_);
+  SafeGetParam(pnh, "preintegrate_imu", svis_.preintegrate_imu_);
+  SafeGetParam(pnh, "clock_state_file", svis_.clock_state_file_);
+  SafeGetParam(pnh, "link_state_file", svis_.link_state_file_);
+  SafeGetParam(pnh, "device_id", svis_.device_id_);
+
+  // relative state paths are kept in ROS_HOME
+  std::string ros_home;
+  if (getenv("ROS_HOME") != nullptr) {
+    ros_home = getenv("ROS_HOME");
+  } else if (getenv("HOME") != nullptr) {
+    ros_home = std::string(getenv("HOME")) + "/.ros";
+  }
+  if (!ros_home.empty() && !svis_.clock_state_file_.empty() && svis_.clock_state_file_[0] != '/') {
+    svis_.clock_state_file_ = ros_home + "/" + svis_.clock_state_file_;
+  }
+  if (!ros_home.empty() && !svis_.link_state_file_.empty() && svis_.link_state_file_[0] != '/') {
+    svis_.link_state_file_ = ros_home + "/" + svis_.link_state_file_;
+  }
 }
 
 void SVISRos::InitSubscribers() {
   camera_sub_ = it_.subscribeCamera("/flea3/image_raw", 10, &SVISRos::CameraCallback, this);
 }
 
+void SVISRos::InitServices() {
+  configure_srv_ = pnh_.advertiseService("configure", &SVISRos::ConfigureCallback, this);
+  imu_interpolate_srv_ = pnh_.advertiseService("imu_interpolate", &SVISRos::ImuInterpolateCallback, this);
+  imu_range_srv_ = pnh_.advertiseService("imu_range", &SVISRos::ImuRangeCallback, this);
+  integrate_gyro_srv_ = pnh_.advertiseService("integrate_gyro", &SVISRos::IntegrateGyroCallback, this);
+}
+
 void SVISRos::InitPublishers() {
   camera_pub_ = it_.advertiseCamera("/svis/image_raw", 1);
   imu_pub_ = nh_.advertise<sensor_msgs::Imu>("/svis/imu", 1);
+  imu_uniform_pub_ = nh_.advertise<sensor_msgs::Imu>("/svis/imu_uniform", 100);
   svis_imu_pub_ = nh_.advertise<svis_ros::SvisImu>("/svis/imu_packet", 1);
   svis_strobe_pub_ = nh_.advertise<svis_ros::SvisStrobe>("/svis/strobe_packet", 1);
   svis_timing_pub_ = nh_.advertise<svis_ros::SvisTiming>("/svis/timing", 1);
+  svis_buffer_stats_pub_ = nh_.advertise<svis_ros::SvisBufferStats>("/svis/buffer_stats", 1);
+  if (svis_.preintegrate_imu_) {
+    svis_preint_pub_ = nh_.advertise<svis_ros::SvisPreintegratedImu>("/svis/preintegrated_imu", 10);
+  }
 }
 
 void SVISRos::PublishImu(const svis::ImuPacket& imu_packet) {
   svis_.tic();
   sensor_msgs::Imu imu;
+  SvisToRosImu(imu_packet, &imu);
+
+  // publish
+  imu_pub_.publish(imu);
+  //ROS_INFO("stamp: %f, acc.z: %f", imu.header.stamp.toSec(), imu.linear_acceleration.z);
+
+  svis_.timing_.publish_imu = svis_.toc();
+}
+
+void SVISRos::PublishImuResampled(const std::vector<svis::ImuPacket>& imu_packets) {
+  for (int i = 0; i < imu_packets.size(); i++) {
+    sensor_msgs::Imu imu;
+    SvisToRosImu(imu_packets[i], &imu);
+    imu_uniform_pub_.publish(imu);
+  }
+}
 
-  imu.header.stamp = ros::Time(imu_packet.timestamp_ros);
-  imu.header.frame_id = "body";
+void SVISRos::SvisToRosImu(const svis::ImuPacket& imu_packet, sensor_msgs::Imu* imu) {
+  imu->header.stamp = ros::Time(imu_packet.timestamp_ros);
+  imu->header.frame_id = "body";
 
   // orientation
-  imu.orientation.x = std::numeric_limits<double>::quiet_NaN();
-  imu.orientation.y = std::numeric_limits<double>::quiet_NaN();
-  imu.orientation.z = std::numeric_limits<double>::quiet_NaN();
-  imu.orientation.w = std::numeric_limits<double>::quiet_NaN();
+  imu->orientation.x = std::numeric_limits<double>::quiet_NaN();
+  imu->orientation.y = std::numeric_limits<double>::quiet_NaN();
+  imu->orientation.z = std::numeric_limits<double>::quiet_NaN();
+  imu->orientation.w = std::numeric_limits<double>::quiet_NaN();
 
   // orientation covariance
-  for (int i = 0; i < imu.orientation_covariance.size(); i++) {
-    imu.orientation_covariance[i] = std::numeric_limits<double>::quiet_NaN();
+  for (int i = 0; i < imu->orientation_covariance.size(); i++) {
+    imu->orientation_covariance[i] = std::numeric_limits<double>::quiet_NaN();
   }
 
   // angular velocity [rad/s]
-  imu.angular_velocity.x = imu_packet.gyro[0];
-  imu.angular_velocity.y = imu_packet.gyro[1];
-  imu.angular_velocity.z = imu_packet.gyro[2];
+  imu->angular_velocity.x = imu_packet.gyro[0];
+  imu->angular_velocity.y = imu_packet.gyro[1];
+  imu->angular_velocity.z = imu_packet.gyro[2];
 
   // angular velocity covariance
-  for (int i = 0; i < imu.angular_velocity_covariance.size(); i++) {
-    imu.angular_velocity_covariance[i] = std::numeric_limits<double>::quiet_NaN();
+  for (int i = 0; i < imu->angular_velocity_covariance.size(); i++) {
+    imu->angular_velocity_covariance[i] = std::numeric_limits<double>::quiet_NaN();
   }
 
   // linear acceleration [m/s^2]
-  imu.linear_acceleration.x = imu_packet.acc[0];
-  imu.linear_acceleration.y = imu_packet.acc[1];
-  imu.linear_acceleration.z = imu_packet.acc[2];
+  imu->linear_acceleration.x = imu_packet.acc[0];
+  imu->linear_acceleration.y = imu_packet.acc[1];
+  imu->linear_acceleration.z = imu_packet.acc[2];
 
   // acceleration covariance
-  for (int i = 0; i < imu.linear_acceleration_covariance.size(); i++) {
-    imu.linear_acceleration_covariance[i] = std::numeric_limits<double>::quiet_NaN();
+  for (int i = 0; i < imu->linear_acceleration_covariance.size(); i++) {
+    imu->linear_acceleration_covariance[i] = std::numeric_limits<double>::quiet_NaN();
   }
+}
 
-  // publish
-  imu_pub_.publish(imu);
-  //ROS_INFO("stamp: %f, acc.z: %f", imu.header.stamp.toSec(), imu.linear_acceleration.z);
+void SVISRos::SvisToRosPreintegratedImu(const svis::PreintegratedImu& preint,
+                                        svis_ros::SvisPreintegratedImu* msg) {
+  msg->header.frame_id = "body";
+  msg->valid = preint.valid;
+  msg->start = ros::Time(preint.t0);
+  msg->end = ros::Time(preint.t1);
+  msg->sample_count = preint.sample_count;
+
+  for (int k = 0; k < 9; k++) {
+    msg->delta_R[k] = preint.delta_R[k];
+    msg->d_R_d_bg[k] = preint.d_R_d_bg[k];
+    msg->d_v_d_ba[k] = preint.d_v_d_ba[k];
+    msg->d_v_d_bg[k] = preint.d_v_d_bg[k];
+    msg->d_p_d_ba[k] = preint.d_p_d_ba[k];
+    msg->d_p_d_bg[k] = preint.d_p_d_bg[k];
+  }
 
-  svis_.timing_.publish_imu = svis_.toc();
+  for (int j = 0; j < 3; j++) {
+    msg->delta_v[j] = preint.delta_v[j];
+    msg->delta_p[j] = preint.delta_p[j];
+  }
 }
 
-std::shared_ptr<svis::Image> SVISRos::RosImageToSvis(const sensor_msgs::Image& ros_image) {
-  auto svis_image_ptr = std::make_shared<svis::Image>();
-
+void SVISRos::RosImageToSvis(const sensor_msgs::Image& ros_image, svis::Image* svis_image) {
   // header
-  svis_image_ptr->header.seq = ros_image.header.seq;
-  svis_image_ptr->header.stamp = ros_image.header.stamp.toSec();
-  svis_image_ptr->header.frame_id = ros_image.header.frame_id;
-
-  // data
-  svis_image_ptr->height = ros_image.height;
-  svis_image_ptr->width = ros_image.width;
-  svis_image_ptr->encoding = ros_image.encoding;
-  svis_image_ptr->is_bigendian = ros_image.is_bigendian;
-  svis_image_ptr->step = ros_image.step;
-  svis_image_ptr->data = ros_image.data;
-
-  return svis_image_ptr;
+  svis_image->header.seq = ros_image.header.seq;
+  svis_image->header.stamp = ros_image.header.stamp.toSec();
+  svis_image->header.frame_id = ros_image.header.frame_id;
+
+  // data, copied into a pooled frame buffer
+  svis_image->height = ros_image.height;
+  svis_image->width = ros_image.width;
+  svis_image->encoding = ros_image.encoding;
+  svis_image->is_bigendian = ros_image.is_bigendian;
+  svis_image->step = ros_image.step;
+  svis_image->data.assign(ros_image.data.data(), ros_image.data.data() + ros_image.data.size());
 }
 
-const std::shared_ptr<sensor_msgs::Image> SVISRos::SvisToRosImage(const svis::Image& svis_image) {
-  auto ros_image_ptr = std::make_shared<sensor_msgs::Image>();
+sensor_msgs::ImagePtr SVISRos::SvisToRosImage(const svis::Image& svis_image) {
+  // reuse a published message once every subscriber has released it, its
+  // data keeps the capacity of the last frame
+  sensor_msgs::ImagePtr ros_image_ptr;
+  for (std::size_t i = 0; i < ros_image_pool_.size(); i++) {
+    if (ros_image_pool_[i].unique()) {
+      ros_image_ptr = ros_image_pool_[i];
+      break;
+    }
+  }
+  if (!ros_image_ptr) {
+    ros_image_ptr = boost::make_shared<sensor_msgs::Image>();
+    if (ros_image_pool_.size() < ros_image_pool_size_) {
+      ros_image_pool_.push_back(ros_image_ptr);
+    }
+  }
 
   // header
   ros_image_ptr->header.seq = svis_image.header.seq;
@@ -233,7 +359,7 @@ const std::shared_ptr<sensor_msgs::Image> SVISRos::SvisToRosImage(const svis::Im
   ros_image_ptr->encoding = svis_image.encoding;
   ros_image_ptr->is_bigendian = svis_image.is_bigendian;
   ros_image_ptr->step = svis_image.step;
-  ros_image_ptr->data = svis_image.data;
+  ros_image_ptr->data.assign(svis_image.data.begin(), svis_image.data.end());
 
   return ros_image_ptr;
 }
@@ -284,32 +410,102 @@ const std::shared_ptr<sensor_msgs::CameraInfo> SVISRos::SvisToRosCameraInfo(cons
 
 void SVISRos::CameraCallback(const sensor_msgs::Image::ConstPtr& image_msg,
                              const sensor_msgs::CameraInfo::ConstPtr& info_msg) {
-  if (!received_camera_) {
-    received_camera_ = true;
-  }
+  received_camera_ = true;
 
   svis::CameraPacket camera_packet;
 
   // convert image and info
-  auto svis_image_ptr = RosImageToSvis(*image_msg);
+  RosImageToSvis(*image_msg, &camera_packet.image);
   auto svis_info_ptr = RosCameraInfoToSvis(*info_msg);
+  camera_packet.info = *svis_info_ptr;
 
   // metadata
   // PrintMetaDataRaw(image_msg);
-  svis_.ParseImageMetadata(*svis_image_ptr, &camera_packet);
+  svis_.ParseImageMetadata(camera_packet.image, &camera_packet);
   // ROS_INFO("frame_count: %u", camera_packet.metadata.frame_counter);
 
-  // set image and info
-  camera_packet.image = *svis_image_ptr;
-  camera_packet.info = *svis_info_ptr;
+  // queue for the sync thread, never blocks on usb processing
+  if (!svis_.PushCameraPacket(std::move(camera_packet))) {
+    ROS_WARN_THROTTLE(1.0, "(svis_ros) camera queue full, dropping image");
+  }
+}
+
+bool SVISRos::ConfigureCallback(svis_ros::SvisConfigure::Request& req,
+                                svis_ros::SvisConfigure::Response& resp) {
+  std::lock_guard<std::mutex> lock(svis_mutex_);
+
+  if (req.camera_rate >= 0) {
+    svis_.SetCameraRate(req.camera_rate);
+  }
+
+  if (req.gyro_sens >= 0 || req.acc_sens >= 0) {
+    int gyro_sens = (req.gyro_sens >= 0) ? req.gyro_sens : svis_.gyro_sens_;
+    int acc_sens = (req.acc_sens >= 0) ? req.acc_sens : svis_.acc_sens_;
+    svis_.SetImuRange(gyro_sens, acc_sens);
+  }
+
+  if (req.imu_rate >= 0) {
+    svis_.SetImuRate(req.imu_rate);
+  }
+
+  if (req.imu_dlpf >= 0) {
+    svis_.SetImuDlpf(req.imu_dlpf);
+  }
+
+  if (req.trigger_duration >= 0) {
+    svis_.SetTriggerDuration(req.trigger_duration);
+  }
+
+  resp.success = true;
+  return true;
+}
+
+bool SVISRos::ImuInterpolateCallback(svis_ros::SvisImuInterpolate::Request& req,
+                                     svis_ros::SvisImuInterpolate::Response& resp) {
+  std::lock_guard<std::mutex> lock(svis_mutex_);
+
+  svis::ImuPacket imu_packet;
+  resp.success = svis_.GetImuHistory().Interpolate(req.stamp.toSec(), &imu_packet);
+  if (resp.success) {
+    SvisToRosImu(imu_packet, &resp.imu);
+  }
 
-  // add to buffer
-  svis_.PushCameraPacket(camera_packet);
+  return true;
+}
+
+bool SVISRos::ImuRangeCallback(svis_ros::SvisImuRange::Request& req,
+                               svis_ros::SvisImuRange::Response& resp) {
+  std::lock_guard<std::mutex> lock(svis_mutex_);
+
+  resp.success = req.end >= req.start;
+  if (!resp.success) {
+    return true;
+  }
+
+  std::vector<svis::ImuPacket> imu_packets;
+  svis_.GetImuHistory().GetRange(req.start.toSec(), req.end.toSec(), &imu_packets);
 
-  // warn if buffer is at max size
-  if (svis_.GetCameraBufferSize() == svis_.GetCameraBufferMaxSize() && !svis_.GetSyncFlag()) {
-    ROS_WARN("(svis_ros) camera buffer at max size");
+  resp.imu.resize(imu_packets.size());
+  for (int i = 0; i < imu_packets.size(); i++) {
+    SvisToRosImu(imu_packets[i], &resp.imu[i]);
   }
+
+  return true;
+}
+
+bool SVISRos::IntegrateGyroCallback(svis_ros::SvisIntegrateGyro::Request& req,
+                                    svis_ros::SvisIntegrateGyro::Response& resp) {
+  std::lock_guard<std::mutex> lock(svis_mutex_);
+
+  double q[4] = {1.0, 0.0, 0.0, 0.0};
+  resp.success = svis_.GetImuHistory().IntegrateGyro(req.start.toSec(), req.end.toSec(), q);
+
+  resp.rotation.w = q[0];
+  resp.rotation.x = q[1];
+  resp.rotation.y = q[2];
+  resp.rotation.z = q[3];
+
+  return true;
 }
 
 void SVISRos::PublishCamera(std::vector<svis::CameraStrobePacket>& camera_strobe_packets) {
@@ -318,12 +514,22 @@ void SVISRos::PublishCamera(std::vector<svis::CameraStrobePacket>& camera_strobe
   for (int i = 0; i < camera_strobe_packets.size(); i++) {
     // convert
     auto ros_info_ptr = SvisToRosCameraInfo(camera_strobe_packets[i].camera.info);
-    auto ros_image_ptr = SvisToRosImage(camera_strobe_packets[i].camera.image);
-
-    // publish
-    camera_pub_.publish(*ros_image_ptr,
-                        *ros_info_ptr,
-                        ros::Time(camera_strobe_packets[i].strobe.timestamp_ros));
+    sensor_msgs::ImagePtr ros_image_ptr = SvisToRosImage(camera_strobe_packets[i].camera.image);
+    sensor_msgs::CameraInfoPtr ros_info = boost::make_shared<sensor_msgs::CameraInfo>(*ros_info_ptr);
+
+    // publish by pointer so intraprocess subscribers share the pooled image
+    ros::Time stamp(camera_strobe_packets[i].strobe.timestamp_ros);
+    ros_image_ptr->header.stamp = stamp;
+    ros_info->header.stamp = stamp;
+    camera_pub_.publish(ros_image_ptr, ros_info);
+
+    // preintegrated imu since the previous frame, stamped like the image
+    if (svis_.preintegrate_imu_) {
+      svis_ros::SvisPreintegratedImu preint;
+      SvisToRosPreintegratedImu(camera_strobe_packets[i].imu, &preint);
+      preint.header.stamp = ros::Time(camera_strobe_packets[i].strobe.timestamp_ros);
+      svis_preint_pub_.publish(preint);
+    }
   }
 
   svis_.timing_.publish_camera = svis_.toc();
@@ -381,6 +587,43 @@ void SVISRos::PublishStrobeRaw(const std::vector<svis::StrobePacket>& strobe_pac
   svis_.timing_.publish_strobe_raw = svis_.toc();
 }
 
+void SVISRos::PublishBufferStats(const svis::BufferStats& stats) {
+  SvisBufferStats msg;
+
+  msg.header.stamp = ros::Time::now();
+
+  msg.imu_size = stats.imu.size;
+  msg.imu_capacity = stats.imu.capacity;
+  msg.imu_high_water = stats.imu.high_water;
+  msg.imu_overflow = stats.imu.overflow_count;
+
+  msg.strobe_size = stats.strobe.size;
+  msg.strobe_capacity = stats.strobe.capacity;
+  msg.strobe_high_water = stats.strobe.high_water;
+  msg.strobe_overflow = stats.strobe.overflow_count;
+  msg.strobe_stale = stats.strobe.stale_count;
+
+  msg.camera_size = stats.camera.size;
+  msg.camera_capacity = stats.camera.capacity;
+  msg.camera_high_water = stats.camera.high_water;
+  msg.camera_overflow = stats.camera.overflow_count;
+  msg.camera_stale = stats.camera.stale_count;
+
+  msg.teensy_imu_capacity = stats.teensy_imu.capacity;
+  msg.teensy_imu_high_water = stats.teensy_imu.high_water;
+  msg.teensy_imu_overflow = stats.teensy_imu.overflow_count;
+  msg.teensy_strobe_capacity = stats.teensy_strobe.capacity;
+  msg.teensy_strobe_high_water = stats.teensy_strobe.high_water;
+  msg.teensy_strobe_overflow = stats.teensy_strobe.overflow_count;
+  msg.teensy_sof_overflow = stats.teensy_sof_overflow_count;
+  msg.teensy_send_errors = stats.teensy_send_errors;
+  msg.teensy_journal_drops = stats.teensy_journal_drops;
+  msg.backfill_requested = stats.backfill_requested;
+  msg.backfill_count = stats.backfill_count;
+
+  svis_buffer_stats_pub_.publish(msg);
+}
+
 void SVISRos::PublishTiming(const svis::Timing& timing) {
   SvisTiming msg;
 
@@ -401,6 +644,7 @@ void SVISRos::PublishTiming(const svis::Timing& timing) {
   msg.filter_imu = timing.filter_imu;
   msg.publish_imu = timing.publish_imu;
   msg.associate = timing.associate;
+  msg.preintegrate_imu = timing.preintegrate_imu;
   msg.publish_camera = timing.publish_camera;
   msg.update = timing.update;
   msg.period = timing.period;
@@ -2,10 +2,15 @@
 
 #pragma once
 
+#include <atomic>
 #include <csignal>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <termios.h>
 
+#include <boost/make_shared.hpp>
+
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/CameraInfo.h>
 #include <sensor_msgs/Imu.h>
@@ -21,9 +26,15 @@
 #include "svis/camera_strobe_packet.h"
 #include "svis/image.h"
 #include "svis/camera_info.h"
+#include "svis_ros/SvisBufferStats.h"
 #include "svis_ros/SvisImu.h"
+#include "svis_ros/SvisPreintegratedImu.h"
 #include "svis_ros/SvisStrobe.h"
 #include "svis_ros/SvisTiming.h"
+#include "svis_ros/SvisConfigure.h"
+#include "svis_ros/SvisImuInterpolate.h"
+#include "svis_ros/SvisImuRange.h"
+#include "svis_ros/SvisIntegrateGyro.h"
 
 namespace svis_ros {
 
@@ -49,24 +60,38 @@ class SVISRos {
   void GetParams();
   void InitSubscribers();
   void InitPublishers();
+  void InitServices();
 
   // callbacks
   void CameraCallback(const sensor_msgs::Image::ConstPtr& image_msg,
                       const sensor_msgs::CameraInfo::ConstPtr& info_msg);
+  bool ConfigureCallback(svis_ros::SvisConfigure::Request& req,
+                         svis_ros::SvisConfigure::Response& resp);
+  bool ImuInterpolateCallback(svis_ros::SvisImuInterpolate::Request& req,
+                              svis_ros::SvisImuInterpolate::Response& resp);
+  bool ImuRangeCallback(svis_ros::SvisImuRange::Request& req,
+                        svis_ros::SvisImuRange::Response& resp);
+  bool IntegrateGyroCallback(svis_ros::SvisIntegrateGyro::Request& req,
+                             svis_ros::SvisIntegrateGyro::Response& resp);
 
   // publishers
   void PublishImuRaw(const std::vector<svis::ImuPacket>& imu_packets);
   void PublishImu(const svis::ImuPacket& imu_packet);
+  void PublishImuResampled(const std::vector<svis::ImuPacket>& imu_packets);
   void PublishStrobeRaw(const std::vector<svis::StrobePacket>& strobe_packets);
   void PublishTiming(const svis::Timing& timing);
+  void PublishBufferStats(const svis::BufferStats& stats);
   void PublishCamera(std::vector<svis::CameraStrobePacket>& camera_strobe_packets);
   double TimeNow();
   
   void ConfigureCamera();
 
   // conversions
-  std::shared_ptr<svis::Image> RosImageToSvis(const sensor_msgs::Image& ros_image);
-  const std::shared_ptr<sensor_msgs::Image> SvisToRosImage(const svis::Image& svis_image);
+  void SvisToRosImu(const svis::ImuPacket& imu_packet, sensor_msgs::Imu* imu);
+  void SvisToRosPreintegratedImu(const svis::PreintegratedImu& preint,
+                                 svis_ros::SvisPreintegratedImu* msg);
+  void RosImageToSvis(const sensor_msgs::Image& ros_image, svis::Image* svis_image);
+  sensor_msgs::ImagePtr SvisToRosImage(const svis::Image& svis_image);
   std::shared_ptr<svis::CameraInfo> RosCameraInfoToSvis(const sensor_msgs::CameraInfo& ros_info);
   const std::shared_ptr<sensor_msgs::CameraInfo> SvisToRosCameraInfo(const svis::CameraInfo& svis_info);
 
@@ -78,14 +103,32 @@ class SVISRos {
   // publishers
   image_transport::CameraPublisher camera_pub_;
   ros::Publisher imu_pub_;
+  ros::Publisher imu_uniform_pub_;
   ros::Publisher svis_imu_pub_;
   ros::Publisher svis_strobe_pub_;
   ros::Publisher svis_timing_pub_;
+  ros::Publisher svis_buffer_stats_pub_;
+  ros::Publisher svis_preint_pub_;
+
+  // published images recycled once subscribers release them
+  std::vector<sensor_msgs::ImagePtr> ros_image_pool_;
+  std::size_t ros_image_pool_size_ = 8;
 
   // subscribers
   image_transport::CameraSubscriber camera_sub_;
 
-  bool received_camera_ = false;
+  // services
+  ros::ServiceServer configure_srv_;
+  ros::ServiceServer imu_interpolate_srv_;
+  ros::ServiceServer imu_range_srv_;
+  ros::ServiceServer integrate_gyro_srv_;
+
+  std::atomic<bool> received_camera_{false};
+  int spinner_threads_ = 0;  // 0 spins in the sync loop
+
+  // serializes svis_ between the sync loop and service callbacks
+  // camera images go through the lock-free queue in svis_ instead
+  std::mutex svis_mutex_;
   svis::SVIS svis_;
 };
 
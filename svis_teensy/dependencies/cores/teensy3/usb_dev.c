@@ -855,6 +855,7 @@ void usb_isr(void)
 
 	if ((status & USB_ISTAT_SOFTOK /* 04 */ )) {
 		if (usb_configuration) {
+			if (usb_sof_callback) usb_sof_callback();
 			t = usb_reboot_timer;
 			if (t) {
 				usb_reboot_timer = --t;
@@ -58,6 +58,9 @@ void usb_tx_isochronous(uint32_t endpoint, void *data, uint32_t len);
 
 extern volatile uint8_t usb_configuration;
 
+// optional start of frame hook, called from usb_isr every 1 ms while configured
+extern void usb_sof_callback(void) __attribute__((weak));
+
 extern uint16_t usb_rx_byte_count_data[NUM_ENDPOINTS];
 static inline uint32_t usb_rx_byte_count(uint32_t endpoint) __attribute__((always_inline));
 static inline uint32_t usb_rx_byte_count(uint32_t endpoint)
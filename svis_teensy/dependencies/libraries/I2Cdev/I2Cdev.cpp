@@ -85,6 +85,20 @@ THE SOFTWARE.
     // Originally offered to the i2cdevlib project at http://arduino.cc/forum/index.php/topic,68210.30.html
     TwoWire Wire;
 
+#elif I2CDEV_IMPLEMENTATION == I2CDEV_TEENSY_SPI
+
+    // register address in the first byte, the top bit set for reads
+    static void spiBegin(uint8_t regAddr) {
+        SPI.beginTransaction(SPISettings(I2Cdev::spiClock, MSBFIRST, SPI_MODE3));
+        digitalWrite(I2Cdev::spiChipSelect, LOW);
+        SPI.transfer(regAddr);
+    }
+
+    static void spiEnd() {
+        digitalWrite(I2Cdev::spiChipSelect, HIGH);
+        SPI.endTransaction();
+    }
+
 #endif
 
 /** Default constructor.
@@ -301,6 +315,19 @@ int8_t I2Cdev::readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8
             count = -1; // error
         }
 
+    #elif (I2CDEV_IMPLEMENTATION == I2CDEV_TEENSY_SPI)
+
+        // SPI, no buffer limit, the address auto increments
+        spiBegin(regAddr | 0x80);
+        for (; count < length; count++) {
+            data[count] = SPI.transfer(0);
+            #ifdef I2CDEV_SERIAL_DEBUG
+                Serial.print(data[count], HEX);
+                if (count + 1 < length) Serial.print(" ");
+            #endif
+        }
+        spiEnd();
+
     #endif
 
     // check for timeout
@@ -454,6 +481,20 @@ int8_t I2Cdev::readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint1
             count = -1; // error
         }
 
+    #elif (I2CDEV_IMPLEMENTATION == I2CDEV_TEENSY_SPI)
+
+        // SPI, no buffer limit, the address auto increments
+        spiBegin(regAddr | 0x80);
+        for (; count < length; count++) {
+            data[count] = SPI.transfer(0) << 8;
+            data[count] |= SPI.transfer(0);
+            #ifdef I2CDEV_SERIAL_DEBUG
+                Serial.print(data[count], HEX);
+                if (count + 1 < length) Serial.print(" ");
+            #endif
+        }
+        spiEnd();
+
     #endif
 
     if (timeout > 0 && millis() - t1 >= timeout && count < length) count = -1; // timeout
@@ -600,6 +641,8 @@ bool I2Cdev::writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_
     #elif (I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_FASTWIRE)
         Fastwire::beginTransmission(devAddr);
         Fastwire::write(regAddr);
+    #elif (I2CDEV_IMPLEMENTATION == I2CDEV_TEENSY_SPI)
+        spiBegin(regAddr & 0x7F);
     #endif
     for (uint8_t i = 0; i < length; i++) {
         #ifdef I2CDEV_SERIAL_DEBUG
@@ -612,6 +655,8 @@ bool I2Cdev::writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_
             Wire.write((uint8_t) data[i]);
         #elif (I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_FASTWIRE)
             Fastwire::write((uint8_t) data[i]);
+        #elif (I2CDEV_IMPLEMENTATION == I2CDEV_TEENSY_SPI)
+            SPI.transfer((uint8_t) data[i]);
         #endif
     }
     #if ((I2CDEV_IMPLEMENTATION == I2CDEV_ARDUINO_WIRE && ARDUINO < 100) || I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_NBWIRE)
@@ -621,6 +666,8 @@ bool I2Cdev::writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_
     #elif (I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_FASTWIRE)
         Fastwire::stop();
         //status = Fastwire::endTransmission();
+    #elif (I2CDEV_IMPLEMENTATION == I2CDEV_TEENSY_SPI)
+        spiEnd();
     #endif
     #ifdef I2CDEV_SERIAL_DEBUG
         Serial.println(". Done.");
@@ -655,6 +702,8 @@ bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16
     #elif (I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_FASTWIRE)
         Fastwire::beginTransmission(devAddr);
         Fastwire::write(regAddr);
+    #elif (I2CDEV_IMPLEMENTATION == I2CDEV_TEENSY_SPI)
+        spiBegin(regAddr & 0x7F);
     #endif
     for (uint8_t i = 0; i < length * 2; i++) {
         #ifdef I2CDEV_SERIAL_DEBUG
@@ -671,6 +720,9 @@ bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16
             Fastwire::write((uint8_t)(data[i] >> 8));       // send MSB
             status = Fastwire::write((uint8_t)data[i++]);   // send LSB
             if (status != 0) break;
+        #elif (I2CDEV_IMPLEMENTATION == I2CDEV_TEENSY_SPI)
+            SPI.transfer((uint8_t)(data[i] >> 8));  // send MSB
+            SPI.transfer((uint8_t)data[i++]);       // send LSB
         #endif
     }
     #if ((I2CDEV_IMPLEMENTATION == I2CDEV_ARDUINO_WIRE && ARDUINO < 100) || I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_NBWIRE)
@@ -680,6 +732,8 @@ bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16
     #elif (I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_FASTWIRE)
         Fastwire::stop();
         //status = Fastwire::endTransmission();
+    #elif (I2CDEV_IMPLEMENTATION == I2CDEV_TEENSY_SPI)
+        spiEnd();
     #endif
     #ifdef I2CDEV_SERIAL_DEBUG
         Serial.println(". Done.");
@@ -692,6 +746,14 @@ bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16
  */
 uint16_t I2Cdev::readTimeout = I2CDEV_DEFAULT_READ_TIMEOUT;
 
+#if I2CDEV_IMPLEMENTATION == I2CDEV_TEENSY_SPI
+    /** SPI chip select pin and register access clock.
+     * Set both before the first register access.
+     */
+    uint8_t I2Cdev::spiChipSelect = 10;
+    uint32_t I2Cdev::spiClock = 1000000;
+#endif
+
 #if I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_FASTWIRE
     // I2C library
     //////////////////////
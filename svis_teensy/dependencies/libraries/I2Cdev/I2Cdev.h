@@ -51,7 +51,11 @@ THE SOFTWARE.
 // I2C interface implementation setting
 // -----------------------------------------------------------------------------
 #ifndef I2CDEV_IMPLEMENTATION
+#ifdef I2CDEV_SPI
+#define I2CDEV_IMPLEMENTATION       I2CDEV_TEENSY_SPI
+#else
 #define I2CDEV_IMPLEMENTATION       I2CDEV_ARDUINO_WIRE
+#endif
 //#define I2CDEV_IMPLEMENTATION       I2CDEV_BUILTIN_FASTWIRE
 #endif // I2CDEV_IMPLEMENTATION
 
@@ -67,6 +71,7 @@ THE SOFTWARE.
                                       // ^^^ NBWire implementation is still buggy w/some interrupts!
 #define I2CDEV_BUILTIN_FASTWIRE     3 // FastWire object from Francesco Ferrara's project
 #define I2CDEV_I2CMASTER_LIBRARY    4 // I2C object from DSSCircuits I2C-Master Library at https://github.com/DSSCircuits/I2C-Master-Library
+#define I2CDEV_TEENSY_SPI           5 // SPI object, 4 wire register access for InvenSense parts (devAddr is ignored)
 
 // -----------------------------------------------------------------------------
 // Arduino-style "Serial.print" debug constant (uncomment to enable)
@@ -80,11 +85,22 @@ THE SOFTWARE.
         #include "Arduino.h"
     #endif
     #if I2CDEV_IMPLEMENTATION == I2CDEV_ARDUINO_WIRE
-        #include <Wire.h>
+        #ifdef I2CDEV_I2C_T3
+            // i2c_t3 replaces Wire on the Teensy 3 with the same interface
+            #include <i2c_t3.h>
+            #ifndef BUFFER_LENGTH
+                #define BUFFER_LENGTH 32
+            #endif
+        #else
+            #include <Wire.h>
+        #endif
     #endif
     #if I2CDEV_IMPLEMENTATION == I2CDEV_I2CMASTER_LIBRARY
         #include <I2C.h>
     #endif
+    #if I2CDEV_IMPLEMENTATION == I2CDEV_TEENSY_SPI
+        #include <SPI.h>
+    #endif
 #endif
 
 #ifdef SPARK
@@ -119,6 +135,12 @@ class I2Cdev {
         static bool writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16_t *data);
 
         static uint16_t readTimeout;
+
+        #if I2CDEV_IMPLEMENTATION == I2CDEV_TEENSY_SPI
+            // chip select pin and clock used for every register access
+            static uint8_t spiChipSelect;
+            static uint32_t spiClock;
+        #endif
 };
 
 #if I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_FASTWIRE
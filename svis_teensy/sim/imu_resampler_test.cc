@@ -0,0 +1,101 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+// Feeds the host's ImuResampler from svis with stamps as the teensy sample
+// isr makes them, jittered by up to 20 us, and checks the output grid.  A
+// steady stream must come out with every grid point and none twice, and a
+// stamp jump that is not a whole number of periods, as from a clock model
+// step, must restart the grid instead of interpolating over the jump.
+//
+// usage: imu_resampler_test
+
+#include <stdint.h>
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "svis/imu_resampler.h"
+
+namespace {
+
+const double jitter_max = 20e-6;  // [s]
+
+// deterministic uniform jitter in [-jitter_max, jitter_max]
+double Jitter(uint32_t* state) {
+  *state = *state * 1664525u + 1013864223u;
+  return jitter_max * (2.0 * (*state >> 8) / 16777215.0 - 1.0);
+}
+
+// outputs that are not one grid step after the last one, 0 is a clean stream
+int GridBreaks(const std::vector<svis::ImuPacket>& out, double rate) {
+  int breaks = 0;
+  for (std::size_t i = 1; i < out.size(); i++) {
+    double step = (out[i].timestamp_ros - out[i - 1].timestamp_ros) * rate;
+    if (std::abs(step - 1.0) > 1e-6) {
+      breaks++;
+    }
+  }
+  return breaks;
+}
+
+// steady input at input_rate, then a jump of jump periods, output at rate
+bool Run(double input_rate, double rate, double jump) {
+  svis::ImuResampler resampler;
+  resampler.Configure(rate, input_rate, svis::ImuResampler::kLinear);
+
+  uint32_t state = 1;
+  std::vector<svis::ImuPacket> out;
+  svis::ImuPacket imu;
+  double period = 1.0 / input_rate;
+  double t = 100.0;
+  int n = static_cast<int>(5.0 * input_rate);
+  for (int i = 0; i < n; i++) {
+    imu.timestamp_ros = t + Jitter(&state);
+    imu.timestamp_ros_rx = imu.timestamp_ros;
+    imu.acc[0] = static_cast<float>(i);
+    resampler.Push(imu, &out);
+    t += period;
+  }
+
+  int steady_breaks = GridBreaks(out, rate);
+  double jitter = resampler.GetJitter();
+  bool steady = steady_breaks == 0 && out.size() + 2 >= static_cast<std::size_t>(5.0 * rate);
+
+  // nothing may land between the last sample before the jump and the first after it
+  double t_before = t - period;
+  t += (jump - 1.0) * period;
+  std::size_t before = out.size();
+  for (int i = 0; i < 10; i++) {
+    imu.timestamp_ros = t + Jitter(&state);
+    imu.timestamp_ros_rx = imu.timestamp_ros;
+    resampler.Push(imu, &out);
+    t += period;
+  }
+
+  int bridged = 0;
+  double t_after = t - 10.0 * period;
+  for (std::size_t i = before; i < out.size(); i++) {
+    if (out[i].timestamp_ros > t_before + jitter_max &&
+        out[i].timestamp_ros < t_after - jitter_max) {
+      bridged++;
+    }
+  }
+
+  printf("input %.0f Hz, output %.0f Hz: %lu samples, %i grid breaks, jitter %.1f us, "
+         "jump of %.2f periods: %i samples across it\n",
+         input_rate, rate, out.size(), steady_breaks, jitter * 1e6, jump, bridged);
+  return steady && bridged == 0;
+}
+
+}  // namespace
+
+int main() {
+  bool ok = true;
+  ok = Run(1000.0, 1000.0, 3.4) && ok;
+  ok = Run(1000.0, 200.0, 2.7) && ok;
+  ok = Run(2000.0, 1000.0, 1.35) && ok;
+  ok = Run(8000.0, 1000.0, 5.7) && ok;
+
+  printf("%s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
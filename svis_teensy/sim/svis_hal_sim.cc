@@ -0,0 +1,345 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include "svis_hal_sim.h"
+
+#include <string.h>
+
+#include <deque>
+#include <limits>
+#include <vector>
+
+#include "svis_core.h"
+#include "svis_hal.h"
+
+namespace {
+
+uint64_t sim_micros = 0;
+bool sim_usb_configured = true;
+bool sim_led = false;
+uint32_t sim_led_toggles = 0;
+
+#if defined(USB_SERIAL)
+// serial usb, the teensy core queues up to 8 transmit packets of 64 bytes
+const uint32_t serial_tx_capacity = 8*64;
+std::deque<uint8_t> serial_tx;
+std::deque<uint8_t> serial_rx;
+#else
+// raw hid usb, packets queued on the endpoint as in usb_rawhid_send, plus
+// one being assembled
+const uint32_t rawhid_tx_limit = 4;
+uint8_t packet_pool[rawhid_tx_limit + 1][send_buffer_size];
+std::vector<uint8_t*> packet_free;
+std::deque<uint8_t*> packet_tx;
+std::deque<std::vector<uint8_t>> packet_rx;
+
+void InitPacketPool() {
+  if (packet_free.empty() && packet_tx.empty()) {
+    for (uint32_t i = 0; i < rawhid_tx_limit + 1; i++) {
+      packet_free.push_back(packet_pool[i]);
+    }
+  }
+}
+#endif
+
+// journal flash, busy times of a typical spi nor part
+const uint32_t journal_block_size = 64*1024;
+const uint32_t journal_program_micros = 700;  // 256 byte page
+const uint32_t journal_erase_micros = 150000;  // 64 KB block
+std::vector<uint8_t> journal_flash;
+uint64_t journal_busy_until = 0;
+
+// imu, registers and fifo of the icm20689
+const uint8_t imu_accel_register = 0x3B;  // ICM20689_RA_ACCEL_XOUT_H
+const uint8_t imu_fifo_count_register = 0x72;  // ICM20689_RA_FIFO_COUNTH
+const uint8_t imu_fifo_data_register = 0x74;  // ICM20689_RA_FIFO_R_W
+const uint32_t imu_fifo_size = 4096;  // bytes, full fifos drop new samples
+const int imu_rx_max = 259;  // i2c_t3 rx buffer
+uint32_t imu_odr_period = 0;  // microseconds, 0 before the rate is set
+uint64_t imu_next_sample = 0;
+uint8_t imu_registers[14];  // [ax, ay, az, temp, gx, gy, gz] big endian
+std::deque<uint8_t> imu_fifo;
+
+// imu bus
+uint32_t imu_bus_rate = 1000000;  // Hz
+uint32_t imu_bus_fallback_rate = 400000;
+uint32_t imu_nak_period = 0;
+uint32_t imu_transactions = 0;
+uint64_t imu_bus_done = 0;  // end of the last transaction
+bool imu_bus_error = false;
+uint8_t imu_bus_register = 0;
+uint8_t imu_rx[imu_rx_max];
+int imu_rx_index = 0;
+
+// starts a transaction of bytes on the bus
+void StartImuTransaction(int bytes) {
+  imu_bus_done = sim_micros + (uint64_t(bytes)*9*1000000 + imu_bus_rate - 1)/imu_bus_rate;
+}
+
+}  // namespace
+
+uint32_t HalMicros() {
+  return static_cast<uint32_t>(sim_micros);
+}
+
+uint32_t HalMillis() {
+  return static_cast<uint32_t>(sim_micros/1000);
+}
+
+void HalSetLed(bool on) {
+  if (on != sim_led) {
+    sim_led = on;
+    sim_led_toggles++;
+  }
+}
+
+bool HalUsbConfigured() {
+  return sim_usb_configured;
+}
+
+uint8_t* HalUsbAcquirePacket() {
+#if defined(USB_SERIAL)
+  return nullptr;
+#else
+  InitPacketPool();
+  if (!sim_usb_configured || packet_tx.size() >= rawhid_tx_limit || packet_free.empty()) {
+    return nullptr;
+  }
+  uint8_t* packet = packet_free.back();
+  packet_free.pop_back();
+  return packet;
+#endif
+}
+
+void HalUsbSendPacket(uint8_t* buf) {
+#if !defined(USB_SERIAL)
+  packet_tx.push_back(buf);
+#endif
+}
+
+int HalUsbWrite(const uint8_t* buf, int length) {
+#if defined(USB_SERIAL)
+  int n = static_cast<int>(serial_tx_capacity - serial_tx.size());
+  if (n > length) {
+    n = length;
+  }
+  serial_tx.insert(serial_tx.end(), buf, buf + n);
+  return n;
+#else
+  uint8_t* packet = HalUsbAcquirePacket();
+  if (packet == nullptr) {
+    return 0;
+  }
+  memcpy(packet, buf, length);
+  HalUsbSendPacket(packet);
+  return length;
+#endif
+}
+
+int HalUsbRead(uint8_t* buf, int length) {
+#if defined(USB_SERIAL)
+  int n = 0;
+  while (n < length && !serial_rx.empty()) {
+    buf[n++] = serial_rx.front();
+    serial_rx.pop_front();
+  }
+  return n;
+#else
+  if (packet_rx.empty()) {
+    return 0;
+  }
+  int n = static_cast<int>(packet_rx.front().size());
+  if (n > length) {
+    n = length;
+  }
+  memcpy(buf, packet_rx.front().data(), n);
+  packet_rx.pop_front();
+  return n;
+#endif
+}
+
+uint32_t HalJournalBegin() {
+  return journal_flash.size();
+}
+
+uint32_t HalJournalBlockSize() {
+  return journal_block_size;
+}
+
+bool HalJournalReady() {
+  return sim_micros >= journal_busy_until;
+}
+
+void HalJournalErase(uint32_t addr) {
+  uint32_t block = addr - addr%journal_block_size;
+  memset(&journal_flash[block], 0xFF, journal_block_size);
+  journal_busy_until = sim_micros + journal_erase_micros;
+}
+
+void HalJournalWrite(uint32_t addr, const uint8_t* buf, int length) {
+  // programming only clears bits
+  for (int i = 0; i < length; i++) {
+    journal_flash[addr + i] &= buf[i];
+  }
+  journal_busy_until = sim_micros + journal_program_micros;
+}
+
+void HalJournalRead(uint32_t addr, uint8_t* buf, int length) {
+  // reads suspend a program or erase in progress
+  memcpy(buf, &journal_flash[addr], length);
+}
+
+void HalImuSendAddress(uint8_t reg) {
+  // device address and register, or just the device address when nakked
+  imu_transactions++;
+  imu_bus_error = imu_nak_period > 0 && imu_transactions%imu_nak_period == 0;
+  imu_bus_register = reg;
+  StartImuTransaction(imu_bus_error ? 1 : 2);
+}
+
+void HalImuSendRequest(uint8_t length) {
+  // the data is latched as the read starts
+  memset(imu_rx, 0, sizeof(imu_rx));
+  if (imu_bus_register == imu_accel_register) {
+    memcpy(imu_rx, imu_registers, length < sizeof(imu_registers) ? length : sizeof(imu_registers));
+  } else if (imu_bus_register == imu_fifo_count_register) {
+    imu_rx[0] = uint8_t(imu_fifo.size() >> 8);
+    imu_rx[1] = uint8_t(imu_fifo.size());
+  } else if (imu_bus_register == imu_fifo_data_register) {
+    for (int i = 0; i < length && !imu_fifo.empty(); i++) {
+      imu_rx[i] = imu_fifo.front();
+      imu_fifo.pop_front();
+    }
+  }
+  imu_rx_index = 0;
+  imu_bus_error = false;
+  StartImuTransaction(1 + length);
+}
+
+HalImuStatus HalImuBusStatus() {
+  if (sim_micros < imu_bus_done) {
+    return kHalImuPending;
+  }
+  return imu_bus_error ? kHalImuError : kHalImuOk;
+}
+
+void HalImuFinish() {
+  if (sim_micros < imu_bus_done) {
+    sim_micros = imu_bus_done;
+  }
+}
+
+uint8_t HalImuReadByte() {
+  return imu_rx[imu_rx_index++];
+}
+
+int HalImuReadMax() {
+  return imu_rx_max;
+}
+
+void HalImuSlowBus() {
+  imu_bus_rate = imu_bus_fallback_rate;
+}
+
+uint64_t SimMicros() {
+  return sim_micros;
+}
+
+void SimAdvance(uint32_t micros) {
+  sim_micros += micros;
+}
+
+void SimSetUsbConfigured(bool configured) {
+  sim_usb_configured = configured;
+}
+
+uint32_t SimUsbTxPending() {
+#if defined(USB_SERIAL)
+  return serial_tx.size();
+#else
+  return packet_tx.size();
+#endif
+}
+
+int SimHostRead(uint8_t* buf, int length) {
+#if defined(USB_SERIAL)
+  int n = 0;
+  while (n < length && !serial_tx.empty()) {
+    buf[n++] = serial_tx.front();
+    serial_tx.pop_front();
+  }
+  return n;
+#else
+  if (packet_tx.empty() || length < send_buffer_size) {
+    return 0;
+  }
+  uint8_t* packet = packet_tx.front();
+  packet_tx.pop_front();
+  memcpy(buf, packet, send_buffer_size);
+  packet_free.push_back(packet);
+  return send_buffer_size;
+#endif
+}
+
+void SimHostWrite(const uint8_t* buf, int length) {
+#if defined(USB_SERIAL)
+  serial_rx.insert(serial_rx.end(), buf, buf + length);
+#else
+  packet_rx.push_back(std::vector<uint8_t>(buf, buf + length));
+#endif
+}
+
+uint32_t SimLedToggles() {
+  return sim_led_toggles;
+}
+
+void SimSetJournalSize(uint32_t bytes) {
+  journal_flash.assign(bytes, 0xFF);
+  journal_busy_until = 0;
+}
+
+void SimSetImuRate(uint32_t odr_period) {
+  imu_odr_period = odr_period;
+  imu_next_sample = sim_micros + odr_period;
+}
+
+void SimResetImuFifo() {
+  imu_fifo.clear();
+}
+
+void SimSetImuBus(uint32_t rate, uint32_t fallback_rate, uint32_t nak_period) {
+  imu_bus_rate = rate;
+  imu_bus_fallback_rate = fallback_rate;
+  imu_nak_period = nak_period;
+}
+
+uint32_t SimImuBusRate() {
+  return imu_bus_rate;
+}
+
+uint64_t SimImuNextSample() {
+  return imu_odr_period > 0 ? imu_next_sample : std::numeric_limits<uint64_t>::max();
+}
+
+uint32_t SimImuSample() {
+  uint32_t stamp = static_cast<uint32_t>(imu_next_sample);
+  imu_next_sample += imu_odr_period;
+
+  // the stamp in ax and ay, the rest derived from it
+  int16_t axes[6] = {int16_t(stamp & 0xFFFF), int16_t(stamp >> 16), int16_t(~stamp),
+                     int16_t(stamp*3), int16_t(stamp*5), int16_t(stamp*7)};
+  uint8_t sample[12];
+  for (int j = 0; j < 6; j++) {
+    sample[2*j] = uint8_t(uint16_t(axes[j]) >> 8);
+    sample[2*j + 1] = uint8_t(axes[j]);
+  }
+
+  // the temperature sits between the accel and gyro registers
+  memcpy(&imu_registers[0], &sample[0], 6);
+  memset(&imu_registers[6], 0, 2);
+  memcpy(&imu_registers[8], &sample[6], 6);
+  if (imu_fifo.size() + sizeof(sample) <= imu_fifo_size) {
+    imu_fifo.insert(imu_fifo.end(), sample, sample + sizeof(sample));
+  }
+
+  return stamp;
+}
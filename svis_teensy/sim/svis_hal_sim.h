@@ -0,0 +1,44 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+// Host side of the simulated teensy hal in svis_hal_sim.cc.  The clock only
+// moves when the simulation advances it, and the usb endpoint is a queue the
+// simulated host drains at its own pace, so a stalled host backs the reports
+// up into the firmware core exactly as a real one would.
+
+// clock
+uint64_t SimMicros();
+void SimAdvance(uint32_t micros);
+
+// usb
+void SimSetUsbConfigured(bool configured);
+uint32_t SimUsbTxPending();  // raw hid packets or serial bytes the host has not read
+
+// host reads a raw hid report or up to length serial bytes, returns the bytes read
+int SimHostRead(uint8_t* buf, int length);
+
+// host writes a raw hid report or serial bytes for RecvPacket
+void SimHostWrite(const uint8_t* buf, int length);
+
+// led toggles, the core blinks every 10 reports
+uint32_t SimLedToggles();
+
+// journal flash, nor flash with 64 KB erase blocks that is busy for a page
+// program or a block erase, 0 bytes leaves the journal off
+void SimSetJournalSize(uint32_t bytes);
+
+// imu, an icm20689 sampling into its registers and its 4096 byte fifo on a
+// bus modelled on i2c_t3's dma transfers, where each byte takes 9 bit times
+// and every nak_period'th register address is nakked (0 never naks).  The
+// first two axes of each sample carry its data ready stamp.
+void SimSetImuRate(uint32_t odr_period);  // the next sample is a period out
+void SimResetImuFifo();
+void SimSetImuBus(uint32_t rate, uint32_t fallback_rate, uint32_t nak_period);  // Hz
+uint32_t SimImuBusRate();
+uint64_t SimImuNextSample();  // UINT64_MAX before the rate is set
+
+// writes the next sample, returns its stamp
+uint32_t SimImuSample();
@@ -0,0 +1,660 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+// Runs the firmware core from svis_core.cpp and svis_imu.cpp on the host
+// against a simulated teensy: an icm20689 on an i2c bus that naks now and
+// then (an 8 MHz spi bus without naks with IMU_SPI), a camera strobing at the
+// trigger rate, usb start of frame ticks, and a usb host that drains the
+// endpoint at full speed except for a stall of stall_ms every second.  The
+// host decodes every report and checks checksums, send counts, imu stamp
+// spacing, the stamps against the data ready stamps the fake imu writes into
+// its samples, and strobe counts, and reads the overflow counters in the
+// status reports.  Send counts and strobe totals go through the host's own
+// ReportSequencer and StrobeCounter from svis, so with a journal flash the
+// host requests the reports it lost and drops duplicate replays as the ros
+// host does, and every strobe total, live or replayed, is checked against the
+// strobe that was fired.  The run fails on any sample or strobe that is
+// neither received nor replayed, a strobe total that is off, or when the
+// firmware rejects the imu rate.
+//
+// With reconnect_ms the usb link drops halfway through for that long and the
+// host comes back as a restarted one would: fresh sequencing and strobe
+// counts, the same setup, and a resume with the session and send count it
+// last saw, so the journal has to cover the outage as well.
+//
+// Two seconds in, after a newer command, the host resends the imu rate command
+// as a late retry.  Applying it again would restart the imu and lose samples.
+//
+// Built with IMU_FIFO the imu samples into its fifo and the core drains it,
+// otherwise a timer starts a read every sample period.  The core validates and
+// sets up the imu rate as on the teensy, so a rate the firmware build rejects
+// fails the run here too.
+//
+// usage: svis_teensy_sim [seconds] [imu_rate] [stall_ms] [camera_rate] [journal_kb] [reconnect_ms]
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "svis/cobs.h"
+#include "svis/report_sequencer.h"
+#include "svis/strobe_counter.h"
+#include "svis_core.h"
+#include "svis_hal.h"
+#include "svis_hal_sim.h"
+#include "svis_imu.h"
+
+namespace {
+
+// simulated teensy
+const uint32_t loop_period = 10;  // microseconds per pass of the main loop
+#if defined(IMU_SPI)
+const uint32_t imu_bus_rate = 8000000;  // Hz
+const uint32_t imu_bus_fallback_rate = 8000000;
+const uint32_t imu_bus_nak_period = 0;  // transactions
+#else
+const uint32_t imu_bus_rate = 1000000;
+const uint32_t imu_bus_fallback_rate = 400000;
+const uint32_t imu_bus_nak_period = 97;
+#endif
+bool imu_drdy_enabled = false;
+bool imu_timer_running = false;
+uint64_t imu_next_timer = 0;
+uint32_t camera_period = 0;  // microseconds, 0 until the host disables single pulses
+uint8_t camera_rate = 30;  // Hz
+uint8_t fs_sel = 0;  // ranges only decide whether a setup resumes the session
+uint8_t afs_sel = 0;
+bool pulse_trigger = true;
+
+// host
+struct HostStats {
+  uint64_t reports = 0;
+  uint64_t bad_checksums = 0;
+  uint64_t imu_samples = 0;
+  uint64_t imu_missing = 0;  // stamp gaps
+  uint64_t imu_bad_spacing = 0;  // stamp steps that are not a whole number of periods
+  uint64_t imu_bad_stamps = 0;  // stamps off the data ready stamp in the sample
+  uint64_t strobes = 0;
+  uint64_t strobes_missing = 0;  // strobe count gaps
+  uint64_t strobe_bad_totals = 0;  // strobe totals off the strobe that was fired
+  uint64_t clock_reports = 0;
+  uint64_t status_reports = 0;
+  uint64_t acks = 0;
+  uint64_t backfill_requests = 0;
+  uint64_t backfill_rejected = 0;  // reports in ranges the firmware had no room for
+  uint64_t backfill_reports = 0;  // replays of lost reports
+  uint64_t backfill_duplicates = 0;  // replays of reports already received, from merged ranges
+  uint64_t imu_backfilled = 0;
+  uint64_t strobes_backfilled = 0;
+  uint32_t imu_overflow = 0;  // from the last status report
+  uint32_t strobe_overflow = 0;
+  uint32_t imu_high_water = 0;
+  uint32_t send_errors = 0;
+  uint32_t journal_drops = 0;
+  uint32_t session = 0;
+  bool resumed = false;
+  double latency_sum = 0.0;  // microseconds from imu stamp to host read
+  uint32_t latency_max = 0;
+};
+
+HostStats host;
+bool host_have_imu = false;
+uint32_t host_imu_stamp = 0;
+bool host_have_strobe = false;
+uint8_t host_strobe_count = 0;
+bool host_rate_acked = false;
+uint8_t host_rate_status = 0;
+
+// send counts and strobe totals as on the ros host
+svis::ReportSequencer host_sequencer;
+svis::StrobeCounter host_strobe_counter;
+bool host_have_strobe_offset = false;
+uint32_t host_strobe_offset = 0;  // strobe total minus the index of the fired strobe
+
+// strobes fired by the simulated camera, by stamp
+std::map<uint32_t, uint32_t> sim_strobe_index;
+uint32_t sim_strobes_fired = 0;
+
+void FireStrobe(uint32_t stamp) {
+  sim_strobe_index[stamp] = sim_strobes_fired++;
+  ReadStrobe(stamp);
+}
+
+uint8_t host_request_id = 1;
+uint16_t host_resume_send_count = 0;
+uint16_t host_request_counts[256] = {0};  // reports requested by each request id
+
+void HostSend(const uint8_t* packet);
+
+void ServiceBackfill() {
+  uint16_t first = 0;
+  uint16_t count = 0;
+  if (!host_sequencer.NextBackfill(SimMicros()/1.0e6, &first, &count)) {
+    return;
+  }
+
+  uint8_t packet[recv_buffer_size] = {0};
+  host_request_id++;
+  packet[0] = protocol::kCommandHeader;
+  packet[protocol::kCommandRequestIdIndex] = host_request_id;
+  packet[protocol::kCommandIndex] = protocol::kCommandBackfill;
+  memcpy(&packet[protocol::kCommandPayloadIndex], &first, sizeof(first));
+  memcpy(&packet[protocol::kCommandPayloadIndex + sizeof(first)], &count, sizeof(count));
+  HostSend(packet);
+  host_request_counts[host_request_id] = count;
+  host.backfill_requests++;
+}
+
+// every strobe total lies the same distance from the index of its strobe
+void CheckStrobeTotals(const protocol::ReportDecoder<Report>& decoder, bool replay) {
+  std::vector<svis::StrobePacket> strobe_packets(decoder.GetStrobeCount());
+  for (int i = 0; i < decoder.GetStrobeCount(); i++) {
+    strobe_packets[i].timestamp_teensy_raw = decoder.GetStrobeStamp(i);
+    strobe_packets[i].timestamp_teensy = decoder.GetStrobeStamp(i)/1.0e6;
+    strobe_packets[i].count = decoder.GetStrobeCountValue(i);
+  }
+  if (replay) {
+    if (!host_strobe_counter.IsStarted()) {
+      return;
+    }
+    host_strobe_counter.CountReplay(&strobe_packets);
+  } else {
+    host_strobe_counter.Count(&strobe_packets, true);
+  }
+
+  for (const svis::StrobePacket& strobe : strobe_packets) {
+    // replays from before a host restart are not counted
+    if (strobe.count_total == 0) {
+      continue;
+    }
+    auto it = sim_strobe_index.find(strobe.timestamp_teensy_raw);
+    if (it == sim_strobe_index.end()) {
+      host.strobe_bad_totals++;
+      continue;
+    }
+    uint32_t offset = strobe.count_total - it->second;
+    if (host_have_strobe_offset && offset != host_strobe_offset) {
+      host.strobe_bad_totals++;
+    }
+    host_have_strobe_offset = true;
+    host_strobe_offset = offset;
+  }
+}
+
+void HandleReport(const uint8_t* buf) {
+  protocol::ReportDecoder<Report> decoder(buf);
+  host.reports++;
+  if (!decoder.ChecksumOk()) {
+    host.bad_checksums++;
+    return;
+  }
+
+  // reports are never dropped once queued, so gaps are reports that only
+  // went to the journal and replays arrive behind the last send count
+  svis::ReportSequencer::Order order = host_sequencer.Sequence(decoder.GetSendCount());
+  if (order == svis::ReportSequencer::kDuplicate) {
+    host.backfill_duplicates++;
+    return;
+  }
+  if (order == svis::ReportSequencer::kReplay) {
+    host.backfill_reports++;
+    host.imu_backfilled += decoder.GetImuCount();
+    host.strobes_backfilled += decoder.GetStrobeCount();
+    CheckStrobeTotals(decoder, true);
+    return;
+  }
+
+  if (decoder.IsAck()) {
+    host.acks++;
+    if (decoder.GetAckCommand() == protocol::kCommandBackfill && decoder.GetAckStatus() == protocol::kAckNoJournal) {
+      host_sequencer.DisableBackfill();
+    } else if (decoder.GetAckCommand() == protocol::kCommandBackfill && decoder.GetAckStatus() != protocol::kAckOk) {
+      host.backfill_rejected += host_request_counts[decoder.GetAckRequestId()];
+    }
+    if (decoder.GetAckCommand() == protocol::kCommandResume && decoder.GetAckStatus() == protocol::kAckOk) {
+      host.resumed = true;
+      host_sequencer.Resume(host_resume_send_count);
+    }
+    if (decoder.GetAckCommand() == protocol::kCommandImuRate) {
+      host_rate_acked = true;
+      host_rate_status = decoder.GetAckStatus();
+    }
+    return;
+  }
+  if (decoder.IsClock()) {
+    host.clock_reports++;
+    return;
+  }
+  if (decoder.IsStatus()) {
+    host.status_reports++;
+    host.imu_overflow = decoder.GetImuOverflow();
+    host.strobe_overflow = decoder.GetStrobeOverflow();
+    host.imu_high_water = decoder.GetImuHighWater();
+    host.send_errors = decoder.GetSendErrors();
+    host.journal_drops = decoder.GetJournalDrops();
+    host.session = decoder.GetSession();
+    return;
+  }
+
+  uint32_t now = static_cast<uint32_t>(SimMicros());
+  for (int i = 0; i < decoder.GetImuCount(); i++) {
+    uint32_t stamp = decoder.GetImuStamp(i);
+    if (host_have_imu) {
+      uint32_t step = stamp - host_imu_stamp;
+      if (step % imu_period != 0 || step == 0) {
+        host.imu_bad_spacing++;
+      } else {
+        host.imu_missing += step/imu_period - 1;
+      }
+    }
+    host_have_imu = true;
+    host_imu_stamp = stamp;
+    host.imu_samples++;
+
+    // fifo samples carry their edge stamp, a timer read gets the newest sample
+    uint32_t sampled = uint16_t(decoder.GetImuAxis(i, 0)) | (uint32_t(uint16_t(decoder.GetImuAxis(i, 1))) << 16);
+    int32_t error = static_cast<int32_t>(stamp - sampled);
+#if defined(IMU_FIFO)
+    if (error != 0) {
+#else
+    if (error < -static_cast<int32_t>(imu_period) || error > static_cast<int32_t>(imu_period)) {
+#endif
+      host.imu_bad_stamps++;
+    }
+
+    uint32_t latency = now - stamp;
+    host.latency_sum += latency;
+    host.latency_max = std::max(host.latency_max, latency);
+  }
+
+  for (int i = 0; i < decoder.GetStrobeCount(); i++) {
+    uint8_t count = decoder.GetStrobeCountValue(i);
+    if (host_have_strobe) {
+      host.strobes_missing += uint8_t(count - host_strobe_count - 1);
+    }
+    host_have_strobe = true;
+    host_strobe_count = count;
+    host.strobes++;
+  }
+  CheckStrobeTotals(decoder, false);
+}
+
+#if defined(USB_SERIAL)
+// frames are COBS(report + crc16) terminated by a zero delimiter
+std::vector<uint8_t> host_frame;
+
+void HostPoll(uint32_t bytes) {
+  std::vector<uint8_t> buf(bytes);
+  int n = SimHostRead(buf.data(), static_cast<int>(bytes));
+  for (int i = 0; i < n; i++) {
+    if (buf[i] != svis::kCobsDelimiter) {
+      host_frame.push_back(buf[i]);
+      continue;
+    }
+    if (!host_frame.empty()) {
+      size_t len = svis::CobsFrameDecode(host_frame.data(), host_frame.size());
+      if (len == static_cast<size_t>(send_buffer_size)) {
+        HandleReport(host_frame.data());
+      } else {
+        host.bad_checksums++;
+      }
+    }
+    host_frame.clear();
+  }
+}
+
+void HostSend(const uint8_t* packet) {
+  uint8_t payload[recv_buffer_size + 2];
+  memcpy(payload, packet, recv_buffer_size);
+  uint8_t frame[recv_buffer_size + 2 + recv_buffer_size/254 + 1 + 2];
+  size_t n = svis::CobsFrameEncode(payload, recv_buffer_size, frame);
+  SimHostWrite(frame, static_cast<int>(n));
+}
+#else
+void HostPoll(uint32_t packets) {
+  uint8_t buf[send_buffer_size];
+  for (uint32_t i = 0; i < packets; i++) {
+    if (SimHostRead(buf, send_buffer_size) != send_buffer_size) {
+      return;
+    }
+    HandleReport(buf);
+  }
+}
+
+void HostSend(const uint8_t* packet) {
+  SimHostWrite(packet, recv_buffer_size);
+}
+#endif
+
+// the link drops what usb had queued and the host starts over
+void HostDisconnect() {
+  SimSetUsbConfigured(false);
+  uint8_t buf[send_buffer_size];
+  while (SimHostRead(buf, send_buffer_size) > 0) {
+  }
+#if defined(USB_SERIAL)
+  host_frame.clear();
+#endif
+  host_resume_send_count = host_sequencer.GetLastSendCount();
+  host_sequencer = svis::ReportSequencer();
+  host_strobe_counter = svis::StrobeCounter();
+  host_have_strobe_offset = false;
+}
+
+void HostReconnect() {
+  SimSetUsbConfigured(true);
+
+  uint8_t packet[recv_buffer_size] = {0};
+  packet[0] = protocol::kSetupHeader;
+  packet[1] = protocol::kSetupConfigure;
+  packet[2] = camera_rate;
+  HostSend(packet);
+
+  memset(packet, 0, sizeof(packet));
+  host_request_id++;
+  packet[0] = protocol::kCommandHeader;
+  packet[protocol::kCommandRequestIdIndex] = host_request_id;
+  packet[protocol::kCommandIndex] = protocol::kCommandResume;
+  memcpy(&packet[protocol::kCommandPayloadIndex], &host.session, sizeof(host.session));
+  memcpy(&packet[protocol::kCommandPayloadIndex + sizeof(host.session)], &host_resume_send_count,
+         sizeof(host_resume_send_count));
+  HostSend(packet);
+}
+
+double Seconds(std::chrono::high_resolution_clock::time_point t0) {
+  std::chrono::duration<double> d = std::chrono::high_resolution_clock::now() - t0;
+  return d.count();
+}
+
+}  // namespace
+
+// application hooks, the firmware's counterparts drive the imu and trigger
+// the imu keeps sampling on its own clock while stopped
+void OnImuStart() {
+#if defined(IMU_FIFO)
+  SimResetImuFifo();
+  imu_drdy_enabled = true;
+#else
+  imu_timer_running = true;
+  imu_next_timer = SimMicros() + imu_period;
+#endif
+}
+
+void OnImuStop() {
+  imu_drdy_enabled = false;
+  imu_timer_running = false;
+}
+
+// the fake imu samples at the odr the registers select
+void OnImuRate(uint8_t dlpf_cfg, bool accel_dlpf_bypass, uint8_t divider) {
+  uint32_t internal_rate = (dlpf_cfg == 0 || dlpf_cfg == 7) ? 8000 : 1000;
+  SimSetImuRate(1000000*(divider + 1)/internal_rate);
+}
+
+void OnConfigure() {
+  if (!setup_flag) {
+    SetCoreParams();
+    ConfigureImuRate();
+    StartImu();
+    setup_flag = true;
+  } else if (recv_buffer[3] == fs_sel && recv_buffer[4] == afs_sel) {
+    ResetCoreParams(true);
+  } else {
+    StopImu();
+    ResetCoreParams(false);
+    StartImu();
+  }
+  fs_sel = recv_buffer[3];
+  afs_sel = recv_buffer[4];
+  camera_rate = recv_buffer[2];
+  pulse_trigger = true;
+}
+
+void OnPulse() {
+  if (pulse_trigger) {
+    FireStrobe(HalMicros());
+  }
+}
+
+void OnDisablePulse() {
+  pulse_trigger = false;
+  camera_period = camera_rate > 0 ? 1000000/camera_rate : 0;
+}
+
+void OnBurst() {
+}
+
+uint8_t ApplyCommand(uint8_t command, const uint8_t* payload) {
+  if (!setup_flag) {
+    return protocol::kAckNotSetup;
+  }
+
+  if (command == protocol::kCommandImuRate) {
+    uint16_t rate = 0;
+    memcpy(&rate, payload, sizeof(rate));
+    if (!ImuRateValid(rate, imu_dlpf_mode)) {
+      return protocol::kAckBadArgument;
+    }
+    StopImu();
+    imu_period = 1000000/rate;
+    ConfigureImuRate();
+    StartImu();
+  } else {
+    return protocol::kAckBadCommand;
+  }
+
+  last_command_stamp = HalMicros();
+  return protocol::kAckOk;
+}
+
+int main(int argc, char** argv) {
+  double seconds = (argc > 1) ? std::atof(argv[1]) : 10.0;
+  uint32_t imu_rate = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 1000;
+  uint32_t stall_ms = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 100;
+  camera_rate = (argc > 4) ? std::atoi(argv[4]) : 30;
+  uint32_t journal_kb = (argc > 5) ? std::strtoul(argv[5], nullptr, 10) : 0;
+  uint32_t reconnect_ms = (argc > 6) ? std::strtoul(argv[6], nullptr, 10) : 0;
+  SimSetJournalSize(journal_kb*1024);
+  SimSetImuBus(imu_bus_rate, imu_bus_fallback_rate, imu_bus_nak_period);
+
+#if defined(USB_SERIAL)
+  const char* transport = "serial";
+  const uint32_t host_poll_amount = 19*64;  // bytes per frame at full speed
+#else
+  const char* transport = "raw hid";
+  const uint32_t host_poll_amount = 1;  // packets per frame on a 1 ms interrupt endpoint
+#endif
+
+  // configure, free running camera and the imu rate
+  uint8_t packet[recv_buffer_size] = {0};
+  packet[0] = protocol::kSetupHeader;
+  packet[1] = protocol::kSetupConfigure;
+  packet[2] = camera_rate;
+  HostSend(packet);
+
+  memset(packet, 0, sizeof(packet));
+  packet[0] = protocol::kSetupHeader;
+  packet[1] = protocol::kSetupDisablePulse;
+  HostSend(packet);
+
+  uint16_t rate = imu_rate;
+  uint8_t rate_packet[recv_buffer_size] = {0};
+  rate_packet[0] = protocol::kCommandHeader;
+  rate_packet[protocol::kCommandRequestIdIndex] = 1;
+  rate_packet[protocol::kCommandIndex] = protocol::kCommandImuRate;
+  memcpy(&rate_packet[protocol::kCommandPayloadIndex], &rate, sizeof(rate));
+  HostSend(rate_packet);
+
+  // the host sends one packet per pass until setup is through
+  for (int i = 0; i < 3; i++) {
+    ServiceHost();
+    ServiceImu();
+    ServiceReports();
+  }
+
+  uint64_t end = SimMicros() + static_cast<uint64_t>(seconds*1.0e6);
+  uint64_t disconnect = reconnect_ms > 0 ? SimMicros() + static_cast<uint64_t>(seconds*0.5e6) : UINT64_MAX;
+  uint64_t reconnect = disconnect + 1000*static_cast<uint64_t>(reconnect_ms);
+  bool connected = true;
+  uint64_t stale_retry = SimMicros() + 2000000;
+  uint64_t next_loop = SimMicros();
+  uint64_t next_strobe = SimMicros() + camera_period;
+  uint64_t next_frame = SimMicros() + 1000;
+  uint16_t frame = 0;
+  uint64_t passes = 0;
+  uint32_t tx_pending_max = 0;
+
+  auto t0 = std::chrono::high_resolution_clock::now();
+  while (SimMicros() < end) {
+    // on to the next isr or pass of the main loop, isrs delayed by a wait on
+    // the imu bus keep their stamps
+    uint64_t next = std::min(next_loop, next_frame);
+    next = std::min(next, SimImuNextSample());
+    if (imu_timer_running) {
+      next = std::min(next, imu_next_timer);
+    }
+    if (camera_period > 0) {
+      next = std::min(next, next_strobe);
+    }
+    if (next > SimMicros()) {
+      SimAdvance(static_cast<uint32_t>(next - SimMicros()));
+    }
+    uint64_t now = SimMicros();
+
+    // imu data ready edge, captured while the imu runs
+    while (SimImuNextSample() <= now) {
+      uint32_t stamp = SimImuSample();
+      if (imu_drdy_enabled) {
+        ReadImuDrdy(stamp);
+      }
+    }
+
+    // imu sample timer
+    while (imu_timer_running && imu_next_timer <= now) {
+      ReadImu();
+      imu_next_timer += imu_period;
+    }
+
+    // camera strobe isr
+    while (camera_period > 0 && next_strobe <= now) {
+      FireStrobe(static_cast<uint32_t>(next_strobe));
+      next_strobe += camera_period;
+    }
+
+    // usb start of frame isr and the host's poll in that frame
+    while (next_frame <= now) {
+      ReadSof(frame, static_cast<uint32_t>(next_frame));
+      frame = (frame + 1) & 0x7FF;
+      next_frame += 1000;
+
+      // a newer command, a resume without a session, then the late retry
+      if (next_frame >= stale_retry) {
+        memset(packet, 0, sizeof(packet));
+        host_request_id++;
+        packet[0] = protocol::kCommandHeader;
+        packet[protocol::kCommandRequestIdIndex] = host_request_id;
+        packet[protocol::kCommandIndex] = protocol::kCommandResume;
+        HostSend(packet);
+        HostSend(rate_packet);
+        stale_retry = UINT64_MAX;
+      }
+
+      if (connected && next_frame >= disconnect) {
+        HostDisconnect();
+        connected = false;
+        disconnect = UINT64_MAX;
+      }
+      if (!connected && next_frame >= reconnect) {
+        HostReconnect();
+        connected = true;
+      }
+
+      uint64_t ms = next_frame/1000;
+      bool stalled = (ms % 1000) >= 500 && (ms % 1000) < 500 + stall_ms;
+      if (connected && !stalled) {
+        HostPoll(host_poll_amount);
+        ServiceBackfill();
+      }
+    }
+
+    // main loop
+    if (now < next_loop) {
+      continue;
+    }
+    ServiceHost();
+    ServiceImu();
+    ServiceReports();
+    tx_pending_max = std::max(tx_pending_max, SimUsbTxPending());
+    next_loop = now + loop_period;
+    passes++;
+  }
+  double wall = Seconds(t0);
+  StopImu();
+
+  // the rest of the queue and the replays, then the final overflow counters
+  for (int i = 0; i < 2000; i++) {
+    for (uint32_t t = 0; t < 1000; t += loop_period) {
+      SimAdvance(loop_period);
+      ServiceHost();
+      ServiceReports();
+    }
+    HostPoll(host_poll_amount);
+    ServiceBackfill();
+  }
+  SendStatus();
+  for (int i = 0; i < 10; i++) {
+    FlushReports();
+    HostPoll(host_poll_amount);
+  }
+
+  double latency_mean = host.imu_samples > 0 ? host.latency_sum/host.imu_samples : 0.0;
+  printf("transport: %s, %u byte reports, %i imu slots\n", transport, send_buffer_size, Report::imu_slots);
+  bool rate_ok = host_rate_acked && host_rate_status == protocol::kAckOk;
+  if (!rate_ok) {
+    printf("imu rate %u Hz rejected with status %u\n", imu_rate, host_rate_status);
+  }
+  printf("simulated: %.1f s, imu %u Hz, camera %u Hz, host stall %u ms/s\n",
+         seconds, 1000000/imu_period, camera_rate, stall_ms);
+  printf("reports: %lu (%lu clock, %lu status, %lu ack), %lu bad, %lu lost\n",
+         host.reports, host.clock_reports, host.status_reports, host.acks,
+         host.bad_checksums, host_sequencer.GetLostCount());
+  printf("journal: %u KB, %lu backfill requests, %lu reports replayed, %lu duplicates, %lu rejected, %u dropped\n",
+         journal_kb, host.backfill_requests, host.backfill_reports, host.backfill_duplicates,
+         host.backfill_rejected, host.journal_drops);
+  if (reconnect_ms > 0) {
+    printf("reconnect: %u ms outage, session %s\n", reconnect_ms, host.resumed ? "resumed" : "not resumed");
+  }
+  printf("imu: %lu samples, %lu missing, %lu backfilled, %lu bad spacing, %lu bad stamps, firmware overflow %u, high water %u/%i\n",
+         host.imu_samples, host.imu_missing, host.imu_backfilled, host.imu_bad_spacing, host.imu_bad_stamps,
+         host.imu_overflow, host.imu_high_water, imu_buffer_size);
+  printf("imu bus: %s, %u kHz, %u read errors\n",
+#if defined(IMU_FIFO)
+         "fifo",
+#else
+         "timer",
+#endif
+         SimImuBusRate()/1000, imu_read_errors);
+  printf("strobes: %lu, %lu missing, %lu backfilled, %lu bad totals, firmware overflow %u\n",
+         host.strobes, host.strobes_missing, host.strobes_backfilled, host.strobe_bad_totals,
+         host.strobe_overflow);
+  printf("imu latency: %.0f us mean, %u us max\n", latency_mean, host.latency_max);
+  printf("usb: %u pending at most, %u send errors, %u led toggles\n",
+         tx_pending_max, host.send_errors, SimLedToggles());
+  printf("wall: %.3f s, %.1fx real time, %.2f Mpasses/s\n",
+         wall, seconds/wall, passes/wall/1.0e6);
+
+  // every sample and strobe arrives live or replayed
+  uint64_t imu_lost = host.imu_missing - std::min(host.imu_backfilled, host.imu_missing);
+  uint64_t strobes_lost = host.strobes_missing - std::min(host.strobes_backfilled, host.strobes_missing);
+  printf("lost: %lu imu samples, %lu strobes\n", imu_lost, strobes_lost);
+  bool ok = rate_ok && host.bad_checksums == 0 && host.imu_bad_spacing == 0 && host.imu_bad_stamps == 0 &&
+    host.strobe_bad_totals == 0 && imu_lost == 0 && strobes_lost == 0 && (reconnect_ms == 0 || host.resumed);
+  printf("%s\n", ok ? "ok" : "FAILED");
+
+  return ok ? 0 : 1;
+}
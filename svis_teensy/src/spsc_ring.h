@@ -0,0 +1,84 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+// Single producer, single consumer ring that hands samples from an isr to the
+// main loop without masking interrupts.  Head and tail run freely and are
+// masked into the power of two buffer, so the count is head - tail across the
+// 32 bit wrap.  Each index is only written by its own side, and a barrier
+// orders the slot contents against the index that publishes or releases them.
+//
+// A full ring drops the newest entry and counts it, the consumer keeps the
+// oldest entries until it pops them.
+template <typename T, int Size>
+class SpscRing {
+ public:
+  static_assert(Size > 0 && (Size & (Size - 1)) == 0, "ring size must be a power of two");
+  static const uint32_t capacity = Size;
+
+  // only while neither side runs
+  void Clear() {
+    head_ = 0;
+    tail_ = 0;
+    high_water_ = 0;
+    overflow_count_ = 0;
+  }
+
+  // producer, the slot to fill before Push, or nullptr and an overflow if full
+  T* Next() {
+    uint32_t head = head_;
+    if (head - tail_ >= capacity) {
+      overflow_count_++;
+      return nullptr;
+    }
+    __sync_synchronize();  // the consumer released the slot
+    return &buf_[head & (capacity - 1)];
+  }
+
+  // producer, publishes the slot from Next
+  void Push() {
+    uint32_t head = head_ + 1;
+    __sync_synchronize();  // slot contents before the index
+    head_ = head;
+
+    uint32_t count = head - tail_;
+    if (count > high_water_) {
+      high_water_ = count;
+    }
+  }
+
+  // producer, entries lost before they reached the ring
+  void Drop(uint32_t n) {
+    overflow_count_ += n;
+  }
+
+  // consumer, entries ready to read with Peek
+  uint32_t Count() const {
+    uint32_t count = head_ - tail_;
+    __sync_synchronize();  // index before the slot contents
+    return count;
+  }
+
+  // consumer, i = 0 is the oldest, i < Count()
+  const T& Peek(uint32_t i) const {
+    return buf_[(tail_ + i) & (capacity - 1)];
+  }
+
+  // consumer, releases the n oldest entries
+  void Pop(uint32_t n) {
+    __sync_synchronize();  // slot reads before the index
+    tail_ = tail_ + n;
+  }
+
+  uint32_t GetHighWater() const { return high_water_; }
+  uint32_t GetOverflowCount() const { return overflow_count_; }
+
+ private:
+  T buf_[Size];
+  volatile uint32_t head_ = 0;  // written by the producer
+  volatile uint32_t tail_ = 0;  // written by the consumer
+  volatile uint32_t high_water_ = 0;  // largest count seen by the producer
+  volatile uint32_t overflow_count_ = 0;  // entries dropped by the producer
+};
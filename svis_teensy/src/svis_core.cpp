@@ -0,0 +1,602 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include <string.h>
+
+#include "svis/cobs.h"
+#include "svis_core.h"
+#include "svis_hal.h"
+#include "svis_journal.h"
+
+// hid usb
+bool setup_flag = false;
+uint8_t recv_buffer[recv_buffer_size];
+uint16_t send_count = 0;
+uint32_t session_id = 0;
+uint32_t send_errors = 0;
+uint8_t strobe_packet_count = 0;
+uint8_t imu_packet_count = 0;
+bool report_led = false;  // toggles every 10 reports
+
+// report queue
+// reports are assembled in a free buffer and the main loop hands them to usb
+// without waiting, so a slow host leaves samples in the rings, where drops are
+// counted, instead of stalling acquisition
+uint8_t report_queue[report_queue_size][send_buffer_size + 2];  // spare bytes for serial frame crc
+uint32_t report_queue_head = 0;  // next report to assemble
+uint32_t report_queue_tail = 0;  // oldest report waiting for usb
+uint8_t* report_packet = nullptr;  // usb packet the report is assembled in, if any
+ReportEncoder report(report_queue[0]);
+uint8_t spill_buffer[send_buffer_size];  // reports that only go to the journal
+
+#if defined(USB_SERIAL)
+// serial usb
+// frames are COBS(report + crc16) terminated by a zero delimiter
+const int serial_frame_size = send_buffer_size + 2 + send_buffer_size/254 + 1 + 2;
+uint8_t serial_tx_buffer[serial_frame_size];
+int serial_tx_length = 0;  // frame of the oldest queued report, 0 before it is encoded
+int serial_tx_sent = 0;
+uint8_t serial_rx_buffer[serial_frame_size];
+int serial_rx_count = 0;
+#endif
+
+// imu variables
+SpscRing<ImuSlot, imu_buffer_size> imu_ring;
+uint8_t imu_send_batch = 3;
+
+// strobe variables
+SpscRing<StrobeSlot, strobe_buffer_size> strobe_ring;
+uint8_t strobe_count = 0;
+
+// usb start of frame variables
+SpscRing<SofSlot, sof_buffer_size> sof_ring;
+
+// status report
+const uint32_t status_period = 1000;  // milliseconds
+uint32_t status_stamp = 0;  // millis of the last status report
+
+// backfill, ranges of journaled report sequences to replay in order
+const int backfill_lookups = 8;  // per pass, skipping send counts that were not journaled
+const int backfill_range_count = 16;  // power of two, requests waiting their turn
+struct BackfillRange {
+  uint32_t next;
+  uint32_t end;
+};
+BackfillRange backfill_ranges[backfill_range_count];
+uint32_t backfill_head = 0;
+uint32_t backfill_tail = 0;
+
+// command variables
+uint8_t last_request_id = 0;
+uint8_t last_command = 0;
+uint8_t last_status = 0;
+uint32_t last_command_stamp = 0;
+bool ack_flag = false;
+
+// the last requests applied, so a late retry of any of them is only
+// acknowledged again, the host has several in flight
+const int recent_request_count = 16;  // power of two, ids are never zero so zeroed slots are empty
+struct RecentRequest {
+  uint8_t request_id;
+  uint8_t command;
+  uint8_t status;
+  uint32_t stamp;  // last_command_stamp after it was applied
+};
+RecentRequest recent_requests[recent_request_count];
+uint32_t recent_request_head = 0;
+
+void ReadStrobe(uint32_t stamp) {
+  StrobeSlot* slot = strobe_ring.Next();
+  if (slot != nullptr) {
+    slot->stamp = stamp;
+    slot->count = strobe_count;
+    strobe_ring.Push();
+  }
+  strobe_count = (strobe_count + 1);
+}
+
+void ReadSof(uint16_t frame, uint32_t stamp) {
+  SofSlot* slot = sof_ring.Next();
+  if (slot != nullptr) {
+    slot->frame = frame;
+    slot->stamp = stamp;
+    sof_ring.Push();
+  }
+}
+
+void PushIMU() {
+  // the sampling side keeps filling the ring while we copy
+  uint32_t count = imu_ring.Count();
+  if (count > Report::imu_slots) {
+    count = Report::imu_slots;
+  }
+  imu_packet_count = count;
+
+  // copy data
+  for (int i = 0; i < imu_packet_count; i++) {
+    report.SetImuPacket(i, imu_ring.Peek(i).data);
+  }
+  imu_ring.Pop(imu_packet_count);
+}
+
+void PushStrobe() {
+  uint32_t count = strobe_ring.Count();
+  if (count > Report::strobe_slots) {
+    count = Report::strobe_slots;
+  }
+  strobe_packet_count = count;
+
+  // copy stamp and count
+  for (int i = 0; i < strobe_packet_count; i++) {
+    const StrobeSlot& slot = strobe_ring.Peek(i);
+    report.SetStrobe(i, slot.stamp, slot.count);
+  }
+  strobe_ring.Pop(strobe_packet_count);
+}
+
+// points the report at a free buffer, false while usb is behind
+bool BeginReport() {
+  // straight into a usb packet when nothing is queued ahead of it
+  if (report_queue_head == report_queue_tail) {
+    report_packet = HalUsbAcquirePacket();
+    if (report_packet != nullptr) {
+      report.SetBuffer(report_packet);
+      report.Clear();
+      return true;
+    }
+  }
+
+  if (report_queue_head - report_queue_tail >= report_queue_size) {
+    return false;
+  }
+
+  report.SetBuffer(report_queue[report_queue_head & (report_queue_size - 1)]);
+  report.Clear();
+  return true;
+}
+
+// checksums the report and transmits or queues it
+void EndReport() {
+  report.Finish();
+  send_count++;
+  SubmitReport();
+}
+
+void SubmitReport() {
+  if (report_packet != nullptr) {
+    HalUsbSendPacket(report_packet);
+    report_packet = nullptr;
+    return;
+  }
+
+  report_queue_head++;
+}
+
+// hands queued reports to usb as far as it has room, never waits
+void FlushReports() {
+  while (report_queue_tail != report_queue_head) {
+    uint8_t* buf = report_queue[report_queue_tail & (report_queue_size - 1)];
+
+    // no host, drop it
+    if (!HalUsbConfigured()) {
+      send_errors++;
+      report_queue_tail++;
+#if defined(USB_SERIAL)
+      serial_tx_length = 0;
+#endif
+      continue;
+    }
+
+#if defined(USB_SERIAL)
+    // frame the report once, leading delimiter isolates any debug text from the frame
+    if (serial_tx_length == 0) {
+      serial_tx_buffer[0] = svis::kCobsDelimiter;
+      serial_tx_length = svis::CobsFrameEncode(buf, send_buffer_size, &serial_tx_buffer[1]) + 1;
+      serial_tx_sent = 0;
+    }
+
+    // write what fits in the free usb packets
+    while (serial_tx_sent < serial_tx_length) {
+      int n = HalUsbWrite(&serial_tx_buffer[serial_tx_sent], serial_tx_length - serial_tx_sent);
+      if (n <= 0) {
+        return;
+      }
+      serial_tx_sent += n;
+    }
+    serial_tx_length = 0;
+#else
+    if (HalUsbWrite(buf, send_buffer_size) != send_buffer_size) {
+      return;
+    }
+#endif
+
+    report_queue_tail++;
+  }
+}
+
+int RecvPacket() {
+#if defined(USB_SERIAL)
+  // accumulate bytes until we see a delimiter
+  uint8_t c = 0;
+  while (HalUsbRead(&c, 1) == 1) {
+    if (c != svis::kCobsDelimiter) {
+      if (serial_rx_count < serial_frame_size) {
+        serial_rx_buffer[serial_rx_count] = c;
+      }
+      serial_rx_count++;
+      continue;
+    }
+
+    // decode and check the frame
+    int len = 0;
+    if (serial_rx_count > 0 && serial_rx_count <= serial_frame_size) {
+      len = svis::CobsFrameDecode(serial_rx_buffer, serial_rx_count);
+    }
+    serial_rx_count = 0;
+
+    if (len == recv_buffer_size) {
+      memcpy(recv_buffer, serial_rx_buffer, recv_buffer_size);
+      return len;
+    }
+  }
+
+  return 0;
+#else
+  return HalUsbRead(recv_buffer, recv_buffer_size);
+#endif
+}
+
+void Send() {
+  // samples stay in the rings until usb catches up, a ring without room for
+  // another report spills to the journal and the host backfills it
+  bool live = BeginReport();
+  bool spill_imu = false;
+  bool spill_strobe = false;
+  if (!live) {
+    spill_imu = imu_ring.Count() + Report::imu_slots > imu_ring.capacity;
+    spill_strobe = strobe_ring.Count() + Report::strobe_slots > strobe_ring.capacity;
+    if (!JournalEnabled() || (!spill_imu && !spill_strobe)) {
+      return;
+    }
+    report.SetBuffer(spill_buffer);
+    report.Clear();
+  }
+
+  // send_count
+  report.SetSendCount(send_count);
+
+  // data, strobes stay live unless their own ring is full
+  if (live || spill_imu) {
+    PushIMU();
+  }
+  if (live || spill_strobe) {
+    PushStrobe();
+  }
+
+  // packet_counts
+  report.SetImuCount(imu_packet_count);
+  report.SetStrobeCount(strobe_packet_count);
+
+  // blink led
+  if (send_count%10 == 0) {
+    report_led = !report_led;
+    HalSetLed(report_led);
+  }
+
+  // journal, checksum and send
+  JournalReport(report.data());
+  if (live) {
+    EndReport();
+  } else {
+    send_count++;  // the host sees the gap
+  }
+
+  // reset
+  imu_packet_count = 0;
+  strobe_packet_count = 0;
+}
+
+void SendClock() {
+  // the pairs wait in the sof ring
+  if (!BeginReport()) {
+    return;
+  }
+
+  // send_count
+  report.SetSendCount(send_count);
+
+  // clock, sof pairs oldest first
+  const int count = protocol::ClockReport::pair_slots;
+  report.SetClockCount(count);
+  for (int i = 0; i < count; i++) {
+    const SofSlot& slot = sof_ring.Peek(i);
+    report.SetClockPair(i, slot.frame, slot.stamp);
+  }
+  sof_ring.Pop(count);
+
+  // checksum and send
+  EndReport();
+}
+
+void SendStatus() {
+  if (!BeginReport()) {
+    return;
+  }
+  status_stamp = HalMillis();
+
+  // send_count
+  report.SetSendCount(send_count);
+
+  // ring overflow and fill counters
+  report.SetStatus(imu_ring.GetOverflowCount(), strobe_ring.GetOverflowCount(), sof_ring.GetOverflowCount(),
+                   imu_ring.capacity, imu_ring.GetHighWater(),
+                   strobe_ring.capacity, strobe_ring.GetHighWater(), send_errors, journal_drops, session_id);
+
+  // checksum and send
+  EndReport();
+}
+
+void SendAck() {
+  // ack_flag stays set until there is room
+  if (!BeginReport()) {
+    return;
+  }
+
+  // send_count
+  report.SetSendCount(send_count);
+
+  // ack
+  report.SetAck(last_request_id, last_command, last_status, last_command_stamp);
+
+  // checksum and send, the host retries if this gets lost
+  EndReport();
+  ack_flag = false;
+}
+
+uint8_t StartBackfill(const uint8_t* payload) {
+  if (!setup_flag) {
+    return protocol::kAckNotSetup;
+  }
+  if (!JournalEnabled()) {
+    return protocol::kAckNoJournal;
+  }
+
+  uint16_t first = 0;
+  uint16_t count = 0;
+  memcpy(&first, &payload[0], sizeof(first));
+  memcpy(&count, &payload[sizeof(first)], sizeof(count));
+  if (count == 0 || uint16_t(send_count - first) < count) {
+    return protocol::kAckBadArgument;
+  }
+  uint32_t next = JournalSequence(first);
+  uint32_t end = next + count;
+
+  // a range touching the newest one extends it, and with the queue full the
+  // newest one grows to cover the request, the host drops the replays of
+  // reports between them that it already has
+  if (backfill_head != backfill_tail) {
+    BackfillRange& last = backfill_ranges[(backfill_head - 1) & (backfill_range_count - 1)];
+    if ((next <= last.end && end >= last.next) || backfill_head - backfill_tail >= backfill_range_count) {
+      last.next = next < last.next ? next : last.next;
+      last.end = end > last.end ? end : last.end;
+      return protocol::kAckOk;
+    }
+  }
+
+  BackfillRange& range = backfill_ranges[backfill_head & (backfill_range_count - 1)];
+  range.next = next;
+  range.end = end;
+  backfill_head++;
+  return protocol::kAckOk;
+}
+
+uint8_t ResumeSession(const uint8_t* payload) {
+  if (!setup_flag) {
+    return protocol::kAckNotSetup;
+  }
+  if (!JournalEnabled()) {
+    return protocol::kAckNoJournal;
+  }
+
+  // the host's send count belongs to this journal, it requests the gap itself
+  uint32_t session = 0;
+  memcpy(&session, &payload[0], sizeof(session));
+  if (session != session_id) {
+    return protocol::kAckBadArgument;
+  }
+  return protocol::kAckOk;
+}
+
+void SendBackfill() {
+  // live reports go first, replays take what is left of usb
+  for (int i = 0; i < backfill_lookups && backfill_head != backfill_tail; i++) {
+    if (report_queue_head != report_queue_tail) {
+      return;
+    }
+
+    BackfillRange& range = backfill_ranges[backfill_tail & (backfill_range_count - 1)];
+    if (range.next == range.end) {
+      backfill_tail++;
+      continue;
+    }
+
+    uint8_t record[journal_record_max];
+    JournalLookup lookup = FindJournal(range.next, record);
+    if (lookup == kJournalPending) {
+      return;
+    }
+    if (lookup == kJournalMissing) {
+      range.next++;
+      continue;
+    }
+
+    if (!BeginReport()) {
+      return;
+    }
+    range.next++;
+
+    // the original report, send count and checksum included
+    ReplayJournal(record, &report);
+    SubmitReport();
+    return;
+  }
+}
+
+void ProcessCommand() {
+  uint8_t request_id = recv_buffer[protocol::kCommandRequestIdIndex];
+  ack_flag = true;
+
+  // retries of a command we already applied are only acknowledged again
+  for (int i = 0; i < recent_request_count; i++) {
+    const RecentRequest& recent = recent_requests[i];
+    if (request_id != 0 && recent.request_id == request_id) {
+      last_request_id = request_id;
+      last_command = recent.command;
+      last_status = recent.status;
+      last_command_stamp = recent.stamp;
+      return;
+    }
+  }
+
+  last_request_id = request_id;
+  last_command = recv_buffer[protocol::kCommandIndex];
+  if (last_command == protocol::kCommandBackfill) {
+    last_status = StartBackfill(&recv_buffer[protocol::kCommandPayloadIndex]);
+  } else if (last_command == protocol::kCommandResume) {
+    last_status = ResumeSession(&recv_buffer[protocol::kCommandPayloadIndex]);
+  } else {
+    last_status = ApplyCommand(last_command, &recv_buffer[protocol::kCommandPayloadIndex]);
+  }
+
+  RecentRequest& recent = recent_requests[recent_request_head & (recent_request_count - 1)];
+  recent.request_id = last_request_id;
+  recent.command = last_command;
+  recent.status = last_status;
+  recent.stamp = last_command_stamp;
+  recent_request_head++;
+}
+
+void ProcessPacket(int num) {
+  // received a packet and it is the right length
+  if (num == recv_buffer_size) {
+    uint8_t header[2] = {0};
+    header[0] = recv_buffer[0];
+    header[1] = recv_buffer[1];
+
+    // got setup header packet
+    if (header[0] == protocol::kSetupHeader && header[1] == protocol::kSetupConfigure) {
+      OnConfigure();
+    }
+
+    // got single trigger packet
+    if (header[0] == protocol::kSetupHeader && header[1] == protocol::kSetupPulse) {
+      OnPulse();
+    }
+
+    // got disable pulse packet
+    if (header[0] == protocol::kSetupHeader && header[1] == protocol::kSetupDisablePulse) {
+      OnDisablePulse();
+    }
+
+    // got pulse burst packet
+    if (header[0] == protocol::kSetupHeader && header[1] == protocol::kSetupBurst) {
+      OnBurst();
+    }
+
+    // got command packet
+    if (header[0] == protocol::kCommandHeader) {
+      ProcessCommand();
+    }
+  }
+}
+
+void ServiceHost() {
+  int num = RecvPacket();
+  ProcessPacket(num);
+
+  // send command acknowledgement
+  if (ack_flag) {
+    SendAck();
+  }
+
+  // send usb clock correlation
+  if (setup_flag && sof_ring.Count() >= protocol::ClockReport::pair_slots) {
+    SendClock();
+  }
+
+  // send ring overflow counters
+  if (setup_flag && HalMillis() - status_stamp > status_period) {
+    SendStatus();
+  }
+}
+
+void ServiceReports() {
+  // send usb data
+  if (imu_ring.Count() >= imu_send_batch) {
+    Send();
+  }
+
+  // program the journal and replay from it
+  ServiceJournal();
+  SendBackfill();
+
+  // hand queued reports to usb
+  FlushReports();
+}
+
+void StartSession() {
+  send_count = 0;
+  StartJournal();
+
+  // micros at the setup differs from boot to boot, zero is never a session
+  session_id = HalMicros() | 1;
+}
+
+void SetCoreParams() {
+  // hid usb
+  setup_flag = false;
+  send_errors = 0;
+  strobe_packet_count = 0;
+  imu_packet_count = 0;
+  report_led = false;
+
+  // rings, nothing produces before setup
+  imu_ring.Clear();
+  strobe_count = 0;
+  strobe_ring.Clear();
+  sof_ring.Clear();
+
+  // journal and session, the log starts over with the send count
+  StartSession();
+  backfill_head = 0;
+  backfill_tail = 0;
+
+  // command variables
+  last_request_id = 0;
+  ack_flag = false;
+  memset(recent_requests, 0, sizeof(recent_requests));
+}
+
+void ResetCoreParams(bool resume) {
+  // hid usb
+  send_errors = 0;
+  strobe_packet_count = 0;
+  imu_packet_count = 0;
+
+  // a new session drops what it has not sent, a resumed one sends it and the
+  // host backfills the rest from the journal, the strobe count belongs to the
+  // producer and runs on, the host only uses its steps
+  if (!resume) {
+    imu_ring.Pop(imu_ring.Count());
+    strobe_ring.Pop(strobe_ring.Count());
+    StartSession();
+  }
+
+  // journal, the host requests its own gaps again
+  backfill_head = 0;
+  backfill_tail = 0;
+
+  // command variables
+  last_request_id = 0;
+  ack_flag = false;
+  memset(recent_requests, 0, sizeof(recent_requests));
+}
@@ -0,0 +1,121 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include "svis/protocol.h"
+#include "spsc_ring.h"
+
+// Hardware agnostic part of the firmware: the sample rings, report assembly
+// and queueing, and host packet handling.  It reaches the hardware through
+// svis_hal.h and the application (svis_teensy.cpp, or the host simulation)
+// through the hooks at the bottom, so it builds for the host as well.
+
+// report layouts and command codes are shared with the host, see svis/protocol.h
+namespace protocol = svis::protocol;
+#if defined(USB_SERIAL)
+typedef protocol::SerialReport Report;  // wide reports carry the imu above 3 kHz
+#else
+typedef protocol::HidReport Report;
+#endif
+typedef protocol::ReportEncoder<Report> ReportEncoder;
+
+// buffer sizes
+const int imu_data_size = Report::imu_packet_size/sizeof(int16_t);  // (int16_t) [ts1, ts2, ax, ay, az, gx, gy, gz]
+const int imu_buffer_size = 256;  // (imu_stamp, imu_data) samples, 256 ms of usb stall at 1 kHz
+const int strobe_buffer_size = 64;  // (strobe_stamp, strobe_count) samples
+const int sof_buffer_size = 4*protocol::ClockReport::pair_slots;  // (frame, stamp) pairs
+const int send_buffer_size = Report::report_size;  // (int8_t) size of USB reports
+const int recv_buffer_size = protocol::HidReport::report_size;  // (int8_t) host packets are hid sized on both transports
+const int report_queue_size = 4;  // power of two
+
+// hid usb
+extern bool setup_flag;
+extern uint8_t recv_buffer[recv_buffer_size];
+extern uint16_t send_count;
+extern uint32_t session_id;  // changes whenever the send count and the journal start over
+extern uint32_t send_errors;
+extern uint8_t strobe_packet_count;
+extern uint8_t imu_packet_count;
+extern ReportEncoder report;
+
+// imu variables
+struct ImuSlot {
+  int16_t data[imu_data_size];  // (int16_t) [ts1, ts2, ax, ay, az, gx, gy, gz]
+};
+extern SpscRing<ImuSlot, imu_buffer_size> imu_ring;  // filled by the sample isr or the fifo drain
+extern uint8_t imu_send_batch;  // samples to collect before sending a report
+
+// strobe variables
+struct StrobeSlot {
+  uint32_t stamp;  // microseconds
+  uint8_t count;
+};
+extern SpscRing<StrobeSlot, strobe_buffer_size> strobe_ring;  // filled by the trigger or capture isr
+// counts dropped strobes too, so the host sees the gap, only the producer
+// writes it once setup is through
+extern uint8_t strobe_count;
+
+// usb start of frame variables, written from the usb isr
+struct SofSlot {
+  uint16_t frame;  // 11 bit usb frame number
+  uint32_t stamp;  // microseconds
+};
+extern SpscRing<SofSlot, sof_buffer_size> sof_ring;
+
+// command variables
+extern uint8_t last_request_id;
+extern uint8_t last_command;
+extern uint8_t last_status;
+extern uint32_t last_command_stamp;
+extern bool ack_flag;
+
+// producers
+void ReadStrobe(uint32_t stamp);
+void ReadSof(uint16_t frame, uint32_t stamp);
+
+// reports
+bool BeginReport();
+void EndReport();
+void SubmitReport();  // queues a finished report without counting it
+void FlushReports();
+void Send();
+void SendClock();
+void SendStatus();
+void SendAck();
+
+// journal replays, one report per pass while nothing else is queued
+uint8_t StartBackfill(const uint8_t* payload);  // returns an ack status
+void SendBackfill();
+
+// a host that reconnects checks that its last send count is still in this
+// session's journal before it requests the gap, returns an ack status
+uint8_t ResumeSession(const uint8_t* payload);
+
+// host packets
+int RecvPacket();
+void ProcessPacket(int num);
+
+// one pass of the main loop around the imu collection
+void ServiceHost();
+void ServiceReports();
+
+// starts the send count, the journal and a new session id over
+void StartSession();
+
+// core state for a fresh setup, nothing produces yet
+void SetCoreParams();
+
+// core state for a repeated setup, the isrs keep producing so only the
+// consumer side of the rings is reset.  A resumed setup keeps the rings, the
+// send count and the journal, so a host that reconnects can backfill the
+// reports it missed.
+void ResetCoreParams(bool resume);
+
+// implemented by the application
+void OnConfigure();  // [0xAB, 0, camera_rate, fs_sel, afs_sel] in recv_buffer
+void OnPulse();
+void OnDisablePulse();
+void OnBurst();  // [0xAB, 4, count, gap[0], ...] in recv_buffer
+uint8_t ApplyCommand(uint8_t command, const uint8_t* payload);  // returns an ack status
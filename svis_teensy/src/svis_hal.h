@@ -0,0 +1,73 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+// Hardware the firmware core needs, implemented for the teensy in
+// svis_hal_teensy.cpp and for the host simulation in sim/svis_hal_sim.cc.
+// None of these wait, except HalImuFinish() and the imu reads on a blocking bus.
+
+// clocks
+uint32_t HalMicros();
+uint32_t HalMillis();
+
+// status led
+void HalSetLed(bool on);
+
+// usb
+bool HalUsbConfigured();
+
+// a report sized buffer inside a usb packet for assembling a report in
+// place, nullptr when none is free or the transport frames its reports
+uint8_t* HalUsbAcquirePacket();
+
+// transmits the packet from HalUsbAcquirePacket
+void HalUsbSendPacket(uint8_t* buf);
+
+// returns the bytes taken, a raw hid report is taken whole or not at all
+int HalUsbWrite(const uint8_t* buf, int length);
+
+// returns the bytes read, a raw hid report is read whole or not at all
+int HalUsbRead(uint8_t* buf, int length);
+
+// imu register reads, a register address transaction and then a data
+// transaction as in i2c_t3's non-blocking calls, a blocking bus finishes each
+// one before returning
+enum HalImuStatus {kHalImuPending, kHalImuOk, kHalImuError};
+
+// starts writing the register address, only while no transaction is pending
+void HalImuSendAddress(uint8_t reg);
+
+// starts reading length bytes from the register address
+void HalImuSendRequest(uint8_t length);
+
+// the last transaction, an error drops the read
+HalImuStatus HalImuBusStatus();
+
+// waits for the pending transaction, before blocking configuration calls
+void HalImuFinish();
+
+// the bytes of a finished data transaction in order
+uint8_t HalImuReadByte();
+int HalImuReadMax();  // bytes one data transaction can return
+
+// falls back to a slower bus clock after repeated errors
+void HalImuSlowBus();
+
+// journal flash, erased bytes read 0xff and programming only clears bits
+// returns the bytes available, 0 without a journal
+uint32_t HalJournalBegin();
+uint32_t HalJournalBlockSize();  // erase granularity
+
+// no program or erase in progress
+bool HalJournalReady();
+
+// starts erasing the block at addr, only while ready
+void HalJournalErase(uint32_t addr);
+
+// starts programming within one 256 byte page, only while ready
+void HalJournalWrite(uint32_t addr, const uint8_t* buf, int length);
+
+// reads are allowed at any time, a program or erase is suspended for them
+void HalJournalRead(uint32_t addr, uint8_t* buf, int length);
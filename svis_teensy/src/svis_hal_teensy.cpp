@@ -0,0 +1,256 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include <stddef.h>
+
+#include "WProgram.h"
+#include "usb_dev.h"
+#include "I2Cdev.h"
+#include "ICM20689.h"
+#if defined(IMU_SPI) || defined(JOURNAL_FLASH)
+#include "SPI.h"
+#endif
+#if defined(I2CDEV_I2C_T3)
+#include "i2c_t3.h"
+#elif !defined(IMU_SPI)
+#include "Wire.h"
+#endif
+#if defined(JOURNAL_FLASH)
+#include "SerialFlash.h"
+#endif
+#include "svis_hal.h"
+#include "svis_core.h"
+
+#define LED_PIN 13  // pin for on-board led
+#define IMU_CS_PIN 10  // spi chip select for the imu
+#define JOURNAL_CS_PIN 15  // spi chip select for the journal flash, pin 6 drives the trigger
+#define JOURNAL_SCK_PIN 14  // alternate spi clock, pin 13 drives the led
+
+#if defined(JOURNAL_FLASH)
+bool journal_begun = false;
+uint32_t journal_capacity = 0;  // bytes, 0 if no flash answered
+#endif
+
+#if defined(I2CDEV_I2C_T3)
+// imu reads on the i2c_t3 dma, the bus is set up by the application
+const uint32_t i2c_fallback_rate = 400000;  // after repeated bus errors
+#else
+// blocking imu reads, the address is kept and the request runs the whole read
+#if defined(IMU_SPI)
+const uint32_t spi_read_rate = 8000000;  // sensor and fifo registers only, configuration runs at 1 MHz
+#endif
+uint8_t imu_reg = 0;
+uint8_t imu_rx_buffer[255];
+int imu_rx_index = 0;
+HalImuStatus imu_status = kHalImuOk;
+#endif
+
+#if !defined(USB_SERIAL)
+const uint32_t rawhid_tx_limit = 4;  // packets queued on the endpoint, as in usb_rawhid_send
+#endif
+
+uint32_t HalMicros() {
+  return micros();
+}
+
+uint32_t HalMillis() {
+  return millis();
+}
+
+void HalSetLed(bool on) {
+  digitalWrite(LED_PIN, on);
+}
+
+bool HalUsbConfigured() {
+  return usb_configuration != 0;
+}
+
+uint8_t* HalUsbAcquirePacket() {
+#if defined(USB_SERIAL)
+  return nullptr;
+#else
+  // usb_rawhid_send spins until a packet frees up, so take one only if it is there
+  if (!usb_configuration || usb_tx_packet_count(RAWHID_TX_ENDPOINT) >= rawhid_tx_limit) {
+    return nullptr;
+  }
+  usb_packet_t* packet = usb_malloc();
+  if (packet == nullptr) {
+    return nullptr;
+  }
+  return packet->buf;
+#endif
+}
+
+void HalUsbSendPacket(uint8_t* buf) {
+#if !defined(USB_SERIAL)
+  // the buffer sits at a fixed offset in its packet
+  usb_packet_t* packet = reinterpret_cast<usb_packet_t*>(buf - offsetof(usb_packet_t, buf));
+  packet->len = send_buffer_size;
+  usb_tx(RAWHID_TX_ENDPOINT, packet);
+#endif
+}
+
+int HalUsbWrite(const uint8_t* buf, int length) {
+#if defined(USB_SERIAL)
+  // what fits in the free usb packets
+  int n = Serial.availableForWrite();
+  if (n <= 0) {
+    return 0;
+  }
+  if (n > length) {
+    n = length;
+  }
+  Serial.write(buf, n);
+  return n;
+#else
+  uint8_t* packet = HalUsbAcquirePacket();
+  if (packet == nullptr) {
+    return 0;
+  }
+  memcpy(packet, buf, length);
+  HalUsbSendPacket(packet);
+  return length;
+#endif
+}
+
+int HalUsbRead(uint8_t* buf, int length) {
+#if defined(USB_SERIAL)
+  int n = 0;
+  while (n < length && Serial.available()) {
+    buf[n++] = Serial.read();
+  }
+  return n;
+#else
+  return RawHID.recv(buf, 0);  // 0 timeout = do not wait
+#endif
+}
+
+#if defined(IMU_SPI)
+void ReadImuRegisters(uint8_t reg, uint8_t* data, int length) {
+  SPI.beginTransaction(SPISettings(spi_read_rate, MSBFIRST, SPI_MODE3));
+  digitalWriteFast(IMU_CS_PIN, LOW);
+  SPI.transfer(reg | 0x80);
+  memset(data, 0, length);
+  SPI.transfer(data, length);
+  digitalWriteFast(IMU_CS_PIN, HIGH);
+  SPI.endTransaction();
+}
+#endif
+
+void HalImuSendAddress(uint8_t reg) {
+#if defined(I2CDEV_I2C_T3)
+  Wire.beginTransmission(ICM20689_DEFAULT_ADDRESS);
+  Wire.write(reg);
+  Wire.sendTransmission(I2C_NOSTOP);
+#else
+  imu_reg = reg;
+  imu_status = kHalImuOk;
+#endif
+}
+
+void HalImuSendRequest(uint8_t length) {
+#if defined(I2CDEV_I2C_T3)
+  Wire.sendRequest(ICM20689_DEFAULT_ADDRESS, length, I2C_STOP);
+#else
+  imu_rx_index = 0;
+#if defined(IMU_SPI)
+  ReadImuRegisters(imu_reg, imu_rx_buffer, length);
+#else
+  if (I2Cdev::readBytes(ICM20689_DEFAULT_ADDRESS, imu_reg, length, imu_rx_buffer) != length) {
+    imu_status = kHalImuError;
+  }
+#endif
+#endif
+}
+
+HalImuStatus HalImuBusStatus() {
+#if defined(I2CDEV_I2C_T3)
+  if (!Wire.done()) {
+    return kHalImuPending;
+  }
+  return Wire.status() == I2C_WAITING ? kHalImuOk : kHalImuError;
+#else
+  return imu_status;
+#endif
+}
+
+void HalImuFinish() {
+#if defined(I2CDEV_I2C_T3)
+  Wire.finish();
+#endif
+}
+
+uint8_t HalImuReadByte() {
+#if defined(I2CDEV_I2C_T3)
+  return Wire.readByte();
+#else
+  return imu_rx_buffer[imu_rx_index++];
+#endif
+}
+
+int HalImuReadMax() {
+#if defined(I2CDEV_I2C_T3)
+  return I2C_RX_BUFFER_LENGTH;
+#elif defined(IMU_SPI)
+  return sizeof(imu_rx_buffer);
+#else
+  return BUFFER_LENGTH;  // the wire buffer
+#endif
+}
+
+void HalImuSlowBus() {
+#if defined(I2CDEV_I2C_T3)
+  Wire.setClock(i2c_fallback_rate);
+#endif
+}
+
+uint32_t HalJournalBegin() {
+#if defined(JOURNAL_FLASH)
+  // the chip is probed once, setups after the first reuse it
+  if (!journal_begun) {
+    journal_begun = true;
+    SPI.setSCK(JOURNAL_SCK_PIN);
+    if (SerialFlash.begin(JOURNAL_CS_PIN)) {
+      uint8_t id[5];
+      SerialFlash.readID(id);
+      journal_capacity = SerialFlash.capacity(id);
+    }
+  }
+  return journal_capacity;
+#else
+  return 0;
+#endif
+}
+
+uint32_t HalJournalBlockSize() {
+#if defined(JOURNAL_FLASH)
+  return SerialFlash.blockSize();
+#else
+  return 0;
+#endif
+}
+
+bool HalJournalReady() {
+#if defined(JOURNAL_FLASH)
+  return SerialFlash.ready();
+#else
+  return false;
+#endif
+}
+
+void HalJournalErase(uint32_t addr) {
+#if defined(JOURNAL_FLASH)
+  SerialFlash.eraseBlock(addr);
+#endif
+}
+
+void HalJournalWrite(uint32_t addr, const uint8_t* buf, int length) {
+#if defined(JOURNAL_FLASH)
+  SerialFlash.write(addr, buf, length);
+#endif
+}
+
+void HalJournalRead(uint32_t addr, uint8_t* buf, int length) {
+#if defined(JOURNAL_FLASH)
+  SerialFlash.read(addr, buf, length);
+#endif
+}
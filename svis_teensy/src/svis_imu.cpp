@@ -0,0 +1,342 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include <string.h>
+
+#include "svis_hal.h"
+#include "svis_imu.h"
+
+// imu variables
+uint32_t imu_period = 1000;  // microseconds
+uint8_t imu_dlpf_mode = 1;
+uint32_t imu_read_errors = 0;
+
+// register reads
+// a read is started from any context and StepImuRead() moves it from the
+// register address to the data phase and collects it, along with its stamp
+// before the read goes idle and the sample timer can start the next one
+const uint32_t imu_error_limit = 10;  // bus errors before the bus slows down
+enum ImuReadState {kImuReadIdle, kImuReadAddress, kImuReadData};
+volatile uint8_t imu_read_state = kImuReadIdle;
+uint8_t imu_read_register = 0;
+uint8_t imu_read_length = 0;
+bool imu_read_retry = false;  // start the read over once on a bus error
+volatile uint32_t imu_read_stamp = 0;  // micros() when the sample timer started the read
+
+#if defined(IMU_FIFO)
+// fifo acquisition
+// the imu samples at its own rate into its fifo and the main loop drains it in
+// bursts, each data ready edge is stamped by the application
+volatile uint32_t imu_drdy_stamp = 0;  // micros() of the last data ready edge
+volatile uint32_t imu_drdy_count = 0;  // data ready edges since the fifo reset
+uint32_t imu_fifo_count = 0;  // samples drained since the fifo reset
+uint8_t imu_fifo_decimation = 1;
+enum ImuFifoState {kImuFifoIdle, kImuFifoCount, kImuFifoData};
+uint8_t imu_fifo_state = kImuFifoIdle;
+uint8_t imu_fifo_data[imu_fifo_read_max*imu_fifo_sample_size];
+uint32_t imu_fifo_pending = 0;  // samples left to read in this drain
+uint32_t imu_fifo_read = 0;  // samples in the data read
+uint32_t imu_fifo_drdy_stamp = 0;  // edge state copied when the drain started
+uint32_t imu_fifo_drdy_count = 0;
+#endif
+
+// internal sample rate of the imu, the divider only applies to the 1 kHz dlpf_cfg 1 to 6
+uint32_t ImuInternalRate(uint32_t rate, uint8_t dlpf) {
+  return (rate > 1000 || dlpf == 0 || dlpf == 7) ? 8000 : 1000;
+}
+
+bool ImuRateValid(uint32_t rate, uint8_t dlpf) {
+  if (rate < 4 || rate > imu_max_rate || rate > Report::imu_slots*protocol::kReportRate) {
+    return false;
+  }
+  uint32_t internal_rate = ImuInternalRate(rate, dlpf);
+  if (internal_rate%rate != 0) {
+    return false;
+  }
+#if defined(IMU_FIFO)
+  // every internal sample crosses the bus when the divider does not apply
+  if (internal_rate > imu_max_rate) {
+    return false;
+  }
+#endif
+  return true;
+}
+
+void ConfigureImuRate() {
+  uint32_t rate = 1000000/imu_period;
+  uint32_t internal_rate = ImuInternalRate(rate, imu_dlpf_mode);
+
+  // above 1 kHz the 8 kHz gyro odr of dlpf_cfg 7, with the accel at its 4 kHz
+  // odr and its dlpf bypassed, dlpf_cfg 0 and 7 run at 8 kHz and ignore the
+  // divider, so those rates are decimated after reading instead
+  uint8_t divider = internal_rate == 1000 ? internal_rate/rate - 1 : 0;
+  if (rate > 1000) {
+    OnImuRate(7, true, divider);
+  } else {
+    OnImuRate(imu_dlpf_mode, false, divider);
+  }
+
+#if defined(IMU_FIFO)
+  imu_fifo_decimation = internal_rate > 1000 ? internal_rate/rate : 1;
+#endif
+
+  // at most one report per usb frame
+  uint32_t batch = (rate + protocol::kReportRate - 1)/protocol::kReportRate;
+  imu_send_batch = batch < imu_min_batch ? imu_min_batch : batch;
+}
+
+void StartImuRead(uint8_t reg, uint8_t length) {
+  imu_read_register = reg;
+  imu_read_length = length;
+  imu_read_state = kImuReadAddress;
+  HalImuSendAddress(reg);
+}
+
+// returns true and copies the data and stamp once the read in flight completes
+bool StepImuRead(uint8_t* data, uint32_t* stamp) {
+  if (imu_read_state == kImuReadIdle) {
+    return false;
+  }
+
+  HalImuStatus status = HalImuBusStatus();
+  if (status == kHalImuPending) {
+    return false;
+  }
+
+  // a nak, timeout or lost arbitration drops the read
+  if (status == kHalImuError) {
+    imu_read_errors++;
+    if (imu_read_errors == imu_error_limit) {
+      HalImuSlowBus();
+    }
+    if (imu_read_retry) {
+      imu_read_retry = false;
+      StartImuRead(imu_read_register, imu_read_length);
+      return false;
+    }
+    imu_read_state = kImuReadIdle;
+    return false;
+  }
+
+  // register address sent, repeated start for the data
+  if (imu_read_state == kImuReadAddress) {
+    imu_read_state = kImuReadData;
+    HalImuSendRequest(imu_read_length);
+    return false;
+  }
+
+  for (int i = 0; i < imu_read_length; i++) {
+    data[i] = HalImuReadByte();
+  }
+  *stamp = imu_read_stamp;
+  imu_read_state = kImuReadIdle;
+  return true;
+}
+
+// steps the read in flight until it waits on the bus, so a blocking bus
+// finishes it in one call
+bool ServiceImuRead(uint8_t* data, uint32_t* stamp) {
+  while (imu_read_state != kImuReadIdle) {
+    uint8_t state = imu_read_state;
+    if (StepImuRead(data, stamp)) {
+      return true;
+    }
+    if (imu_read_state == state) {
+      return false;
+    }
+  }
+  return false;
+}
+
+// let the read in flight finish before blocking bus calls
+void WaitImuRead() {
+  uint8_t data[imu_fifo_read_max*imu_fifo_sample_size];
+  uint32_t stamp = 0;
+  while (imu_read_state != kImuReadIdle) {
+    HalImuFinish();
+    StepImuRead(data, &stamp);
+  }
+}
+
+// stores one sample of six big endian axes
+void StoreImu(uint32_t timestamp, const uint8_t* axes, int stride) {
+  ImuSlot* next = imu_ring.Next();
+  if (next == nullptr) {
+    return;
+  }
+
+  int16_t* slot = next->data;
+  memcpy(slot, &timestamp, sizeof(uint32_t));
+  for (int j = 0; j < 6; j++) {
+    const uint8_t* b = &axes[j < 3 ? 2*j : 2*j + stride];
+    slot[2 + j] = int16_t((uint16_t(b[0]) << 8) | b[1]);
+  }
+  imu_ring.Push();
+}
+
+#if !defined(IMU_FIFO)
+void CollectImu() {
+  uint8_t data[imu_sample_size];
+  uint32_t stamp = 0;
+  if (!ServiceImuRead(data, &stamp)) {
+    return;
+  }
+
+  // skip the temperature
+  StoreImu(stamp, data, 2);
+}
+#endif
+
+void ReadImu() {
+#if !defined(IMU_FIFO)
+  // the previous read is still in flight, skip this sample
+  if (imu_read_state != kImuReadIdle) {
+    return;
+  }
+
+  // a blocking bus reads the sample here, otherwise the main loop collects it,
+  // the data registers hold the sample until the next one so a read that
+  // fails on the bus is started over once, the fifo drain just waits for its
+  // next pass instead
+  imu_read_stamp = HalMicros();
+  imu_read_retry = true;
+  StartImuRead(imu_accel_register, imu_sample_size);
+  CollectImu();
+#endif
+}
+
+void ReadImuDrdy(uint32_t stamp) {
+#if defined(IMU_FIFO)
+  imu_drdy_stamp = stamp;
+  imu_drdy_count++;
+#endif
+}
+
+void StartImu() {
+#if defined(IMU_FIFO)
+  // count edges from here, DrainImuFifo drops any before the fifo is enabled
+  imu_drdy_count = 0;
+  imu_fifo_count = 0;
+  imu_fifo_pending = 0;
+#endif
+  OnImuStart();
+}
+
+void StopImu() {
+  OnImuStop();
+  WaitImuRead();
+#if defined(IMU_FIFO)
+  imu_fifo_state = kImuFifoIdle;
+#endif
+}
+
+#if defined(IMU_FIFO)
+// consistent copy of the last edge without masking the capture isr, which
+// runs to completion, so an unchanged count means the stamp is its pair
+void CopyImuDrdy(uint32_t* stamp, uint32_t* count) {
+  do {
+    *count = imu_drdy_count;
+    *stamp = imu_drdy_stamp;
+  } while (*count != imu_drdy_count);
+}
+
+// samples to read at this fifo level, restarts on overflow
+uint32_t ImuFifoReadCount(uint32_t available, uint32_t drdy_count) {
+  if (available >= imu_fifo_capacity - 1) {
+    // overflowed, the fifo no longer lines up with the edges
+    imu_ring.Drop(available/imu_fifo_decimation);
+    StopImu();
+    StartImu();
+    return 0;
+  }
+
+  // edges counted before the fifo was enabled have no sample, an edge after
+  // the count was copied leaves its sample for the next drain
+  uint32_t pending = drdy_count - imu_fifo_count;
+  if (pending > available) {
+    imu_fifo_count = drdy_count - available;
+    pending = available;
+  }
+
+  // leave what doesn't fit in the imu ring for the next drain
+  uint32_t space = (imu_ring.capacity - imu_ring.Count())*imu_fifo_decimation;
+  if (pending > space) {
+    pending = space;
+  }
+
+  return pending;
+}
+
+void StoreImuFifo(const uint8_t* data, int n, uint32_t drdy_stamp, uint32_t drdy_count) {
+  uint32_t odr_period = imu_period/imu_fifo_decimation;
+  for (int i = 0; i < n; i++) {
+    // keep every imu_fifo_decimation'th sample
+    imu_fifo_count++;
+    if (imu_fifo_count%imu_fifo_decimation != 0) {
+      continue;
+    }
+
+    // sample k was written on edge k + 1, the edges are one odr period apart
+    uint32_t timestamp = drdy_stamp - (drdy_count - imu_fifo_count)*odr_period;
+    StoreImu(timestamp, &data[i*imu_fifo_sample_size], 0);
+  }
+}
+
+// reads the fifo count and then the pending samples in reads that fit the
+// bus, as far as the bus gets without waiting
+void DrainImuFifo() {
+  while (true) {
+    if (imu_fifo_state == kImuFifoIdle) {
+      CopyImuDrdy(&imu_fifo_drdy_stamp, &imu_fifo_drdy_count);
+      if (imu_fifo_drdy_count - imu_fifo_count < imu_fifo_burst) {
+        return;
+      }
+      imu_fifo_state = kImuFifoCount;
+      StartImuRead(imu_fifo_count_register, 2);
+    }
+
+    // finish the count or data read in flight
+    uint32_t stamp = 0;  // the drain stamps samples by their data ready edges
+    if (!ServiceImuRead(imu_fifo_data, &stamp)) {
+      if (imu_read_state == kImuReadIdle) {
+        imu_fifo_state = kImuFifoIdle;  // dropped on a bus error
+      }
+      return;
+    }
+
+    if (imu_fifo_state == kImuFifoCount) {
+      uint16_t available = (uint16_t(imu_fifo_data[0]) << 8) | imu_fifo_data[1];
+      imu_fifo_pending = ImuFifoReadCount(available/imu_fifo_sample_size, imu_fifo_drdy_count);
+    } else {
+      StoreImuFifo(imu_fifo_data, imu_fifo_read, imu_fifo_drdy_stamp, imu_fifo_drdy_count);
+      imu_fifo_pending -= imu_fifo_read;
+    }
+
+    if (imu_fifo_pending == 0) {
+      imu_fifo_state = kImuFifoIdle;
+      return;
+    }
+
+    // the rest of the drain in reads the bus can return
+    uint32_t read_max = HalImuReadMax()/imu_fifo_sample_size;
+    if (read_max > imu_fifo_read_max) {
+      read_max = imu_fifo_read_max;
+    }
+    imu_fifo_read = imu_fifo_pending < read_max ? imu_fifo_pending : read_max;
+    imu_fifo_state = kImuFifoData;
+    StartImuRead(imu_fifo_data_register, imu_fifo_read*imu_fifo_sample_size);
+  }
+}
+#endif
+
+void ServiceImu() {
+  if (!setup_flag) {
+    return;
+  }
+
+#if defined(IMU_FIFO)
+  DrainImuFifo();
+#else
+  // collect the sample read started by the timer
+  CollectImu();
+#endif
+}
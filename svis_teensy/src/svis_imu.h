@@ -0,0 +1,68 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include "svis_core.h"
+
+// Sample acquisition from the icm20689 into imu_ring.  Register reads are
+// split into the address and data transactions of svis_hal.h, which i2c_t3
+// runs on the dma and a blocking bus finishes as they are started, so one
+// state machine serves every bus and the host simulation runs it against a
+// fake device.
+//
+// With IMU_FIFO the imu samples at its own rate into its fifo, the
+// application stamps each data ready edge with ReadImuDrdy() and the main
+// loop drains the fifo in bursts.  Otherwise a timer calls ReadImu() once per
+// sample period and a blocking bus reads the sample right there.
+
+// icm20689 registers
+const uint8_t imu_accel_register = 0x3B;  // ICM20689_RA_ACCEL_XOUT_H
+const uint8_t imu_fifo_count_register = 0x72;  // ICM20689_RA_FIFO_COUNTH
+const uint8_t imu_fifo_data_register = 0x74;  // ICM20689_RA_FIFO_R_W
+
+// fifo acquisition
+const int imu_sample_size = 14;  // (uint8_t) [ax, ay, az, temp, gx, gy, gz] big endian
+const int imu_fifo_sample_size = 12;  // (uint8_t) [ax, ay, az, gx, gy, gz] big endian
+const int imu_fifo_read_max = 16;  // samples per read, fits the i2c_t3 rx buffer and a uint8_t length
+const int imu_fifo_burst = 4;  // samples to collect before draining
+const int imu_fifo_capacity = 4096/imu_fifo_sample_size;  // samples
+
+// sample rates
+const int imu_min_batch = 3;  // samples per report at rates up to 3 kHz
+#if defined(IMU_SPI)
+const uint32_t imu_max_rate = 8000;  // Hz, gyro odr with the dlpf bypassed
+#else
+const uint32_t imu_max_rate = 1000;  // Hz, limited by the i2c bus
+#endif
+
+extern uint32_t imu_period;  // microseconds
+extern uint8_t imu_dlpf_mode;  // dlpf_cfg requested by the host
+extern uint32_t imu_read_errors;  // reads dropped on bus errors
+#if defined(IMU_FIFO)
+extern uint8_t imu_fifo_decimation;  // fifo samples per stored sample, the fifo runs at 8 kHz above 1 kHz or with dlpf_cfg 0 or 7
+#endif
+
+// the output rate has to divide the internal rate of the dlpf mode
+bool ImuRateValid(uint32_t rate, uint8_t dlpf);
+
+// sets up the sample rate for imu_period and imu_dlpf_mode, stop the imu first
+void ConfigureImuRate();
+
+// producers, from the sample timer or the data ready edge
+void ReadImu();
+void ReadImuDrdy(uint32_t stamp);
+
+// stop before the application configures the imu on the bus, and start
+// again after, the counts start over with the fifo
+void StartImu();
+void StopImu();
+
+// collects the reads in flight and drains the fifo from the main loop
+void ServiceImu();
+
+// implemented by the application
+void OnImuStart();  // resets and enables the fifo and the edges, or starts the timer
+void OnImuStop();
+void OnImuRate(uint8_t dlpf_cfg, bool accel_dlpf_bypass, uint8_t divider);  // writes the rate registers
@@ -0,0 +1,220 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#include "svis_journal.h"
+
+#include <string.h>
+
+#include "svis_hal.h"
+
+uint32_t journal_drops = 0;
+
+// flash layout
+uint32_t journal_pages = 0;  // pages in the log, 0 without a journal
+uint32_t journal_block_pages = 0;  // pages per erase block
+uint32_t journal_page = 0;  // next page to program, counts up past the wrap
+uint32_t journal_erased_page = 0;  // pages before this one have been erased
+
+// ram pages
+uint8_t journal_open[journal_page_size];  // page collecting records
+int journal_open_length = 0;  // (uint8_t)
+int journal_open_records = 0;
+uint8_t journal_stage[journal_stage_pages][journal_page_size];
+uint32_t journal_stage_head = 0;
+uint32_t journal_stage_tail = 0;
+uint32_t journal_seq = 0;  // sequence of the last record
+
+namespace {
+
+int RecordLength(const uint8_t* record) {
+  return journal_record_header + record[4]*Report::imu_packet_size + record[5]*Report::strobe_packet_size;
+}
+
+uint32_t JournalAddress(uint32_t page) {
+  return (page % journal_pages)*journal_page_size;
+}
+
+uint32_t ReadPageSequence(uint32_t page) {
+  uint8_t buf[sizeof(uint32_t)];
+  HalJournalRead(JournalAddress(page), buf, sizeof(buf));
+  return protocol::Load<uint32_t>(buf, 0);
+}
+
+// moves the open page to the stage, or drops it if the flash is too far behind
+void CloseJournalPage() {
+  if (journal_open_length == 0) {
+    return;
+  }
+
+  if (journal_stage_head - journal_stage_tail >= journal_stage_pages) {
+    journal_drops += journal_open_records;
+  } else {
+    memset(&journal_open[journal_open_length], 0xFF, journal_page_size - journal_open_length);
+    memcpy(journal_stage[journal_stage_head & (journal_stage_pages - 1)], journal_open, journal_page_size);
+    journal_stage_head++;
+  }
+
+  journal_open_length = 0;
+  journal_open_records = 0;
+}
+
+}  // namespace
+
+void StartJournal() {
+  uint32_t size = HalJournalBegin();
+  uint32_t block = HalJournalBlockSize();
+  journal_pages = 0;
+  if (size > 0 && block >= journal_page_size) {
+    // whole blocks, and one of them is always being erased ahead
+    journal_block_pages = block/journal_page_size;
+    journal_pages = (size/block)*journal_block_pages;
+    if (journal_pages < 2*journal_block_pages) {
+      journal_pages = 0;
+    }
+  }
+
+  journal_drops = 0;
+  journal_page = 0;
+  journal_erased_page = 0;
+  journal_open_length = 0;
+  journal_open_records = 0;
+  journal_stage_head = 0;
+  journal_stage_tail = 0;
+  journal_seq = 0;
+}
+
+bool JournalEnabled() {
+  return journal_pages > 0;
+}
+
+void JournalReport(const uint8_t* buf) {
+  if (journal_pages == 0) {
+    return;
+  }
+
+  // extend the send count
+  uint16_t send_count = protocol::Load<uint16_t>(buf, Report::send_count_index);
+  journal_seq += uint16_t(send_count - uint16_t(journal_seq));
+
+  uint8_t imu_count = buf[Report::imu_count_index];
+  uint8_t strobe_count = buf[Report::strobe_count_index];
+  int length = journal_record_header + imu_count*Report::imu_packet_size + strobe_count*Report::strobe_packet_size;
+  if (journal_open_length + length > journal_page_size) {
+    CloseJournalPage();
+  }
+
+  // header, then the packets as they are laid out in the report
+  uint8_t* record = &journal_open[journal_open_length];
+  protocol::Store<uint32_t>(record, 0, journal_seq);
+  record[4] = imu_count;
+  record[5] = strobe_count;
+  int offset = journal_record_header;
+  memcpy(&record[offset], &buf[Report::ImuIndex(0)], imu_count*Report::imu_packet_size);
+  offset += imu_count*Report::imu_packet_size;
+  memcpy(&record[offset], &buf[Report::StrobeIndex(0)], strobe_count*Report::strobe_packet_size);
+
+  journal_open_length += length;
+  journal_open_records++;
+}
+
+void ServiceJournal() {
+  if (journal_pages == 0 || !HalJournalReady()) {
+    return;
+  }
+
+  // program the oldest staged page into erased flash
+  bool staged = journal_stage_head != journal_stage_tail;
+  if (staged && journal_page < journal_erased_page) {
+    HalJournalWrite(JournalAddress(journal_page),
+                    journal_stage[journal_stage_tail & (journal_stage_pages - 1)], journal_page_size);
+    journal_stage_tail++;
+    journal_page++;
+    return;
+  }
+
+  // erase the next block when the log needs it, or ahead of it while idle
+  if ((staged && journal_page == journal_erased_page) ||
+      (!staged && journal_erased_page - journal_page < journal_block_pages)) {
+    HalJournalErase(JournalAddress(journal_erased_page));
+    journal_erased_page += journal_block_pages;
+  }
+}
+
+uint32_t JournalSequence(uint16_t value) {
+  // the next sequence follows the send count
+  uint32_t next = journal_seq + uint16_t(send_count - uint16_t(journal_seq));
+  return next - uint16_t(uint16_t(next) - value);
+}
+
+JournalLookup FindJournal(uint32_t seq, uint8_t* record) {
+  if (journal_pages == 0) {
+    return kJournalMissing;
+  }
+
+  // records still in ram, the open page is closed so the next pass can program it
+  if (journal_stage_head != journal_stage_tail) {
+    if (seq >= protocol::Load<uint32_t>(journal_stage[journal_stage_tail & (journal_stage_pages - 1)], 0)) {
+      return kJournalPending;
+    }
+  } else if (journal_open_length > 0 && seq >= protocol::Load<uint32_t>(journal_open, 0)) {
+    CloseJournalPage();
+    return kJournalPending;
+  }
+
+  // programmed pages that have not been erased again
+  uint32_t lo = journal_erased_page > journal_pages ? journal_erased_page - journal_pages : 0;
+  uint32_t hi = journal_page;
+  if (lo >= hi || ReadPageSequence(lo) > seq) {
+    return kJournalMissing;
+  }
+
+  // last page starting at or before seq
+  while (hi - lo > 1) {
+    uint32_t mid = lo + (hi - lo)/2;
+    if (ReadPageSequence(mid) <= seq) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  uint8_t page[journal_page_size];
+  HalJournalRead(JournalAddress(lo), page, journal_page_size);
+  int offset = 0;
+  while (offset + journal_record_header <= journal_page_size) {
+    uint32_t record_seq = protocol::Load<uint32_t>(page, offset);
+    if (record_seq > seq) {
+      break;  // includes the erased tail of the page
+    }
+    int length = RecordLength(&page[offset]);
+    if (record_seq == seq) {
+      memcpy(record, &page[offset], length);
+      return kJournalFound;
+    }
+    offset += length;
+  }
+
+  // not a data report, or it was dropped
+  return kJournalMissing;
+}
+
+void ReplayJournal(const uint8_t* record, ReportEncoder* encoder) {
+  uint8_t imu_count = record[4];
+  uint8_t strobe_count = record[5];
+
+  encoder->Clear();
+  encoder->SetSendCount(uint16_t(protocol::Load<uint32_t>(record, 0)));
+  encoder->SetImuCount(imu_count);
+  encoder->SetStrobeCount(strobe_count);
+
+  int offset = journal_record_header;
+  for (int i = 0; i < imu_count; i++) {
+    encoder->SetImuPacket(i, &record[offset]);
+    offset += Report::imu_packet_size;
+  }
+  for (int i = 0; i < strobe_count; i++) {
+    encoder->SetStrobe(i, protocol::Load<uint32_t>(record, offset), record[offset + sizeof(uint32_t)]);
+    offset += Report::strobe_packet_size;
+  }
+
+  encoder->Finish();
+}
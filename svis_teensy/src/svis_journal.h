@@ -0,0 +1,53 @@
+// Copyright 2017 Massachusetts Institute of Technology
+
+#pragma once
+
+#include <stdint.h>
+
+#include "svis_core.h"
+
+// Append only log of the data reports on the journal flash, so reports that
+// usb lost or never had room for can be replayed to the host by send count.
+//
+// A record is the report's sequence (its send count extended past the 16 bit
+// wrap), its imu and strobe counts and then their packets, so 6 + 16*imu +
+// 5*strobe bytes.  Records never straddle a 256 byte page and every page
+// starts with one, so pages are binary searched by their first sequence.
+// Full pages wait in ram until the flash is ready, and the log erases the
+// block ahead of it while it has nothing to program.
+
+enum JournalLookup {kJournalFound, kJournalMissing, kJournalPending};
+
+const int journal_page_size = 256;  // (uint8_t) flash program page
+// power of two, full pages waiting on the flash, enough for a 150 ms block
+// erase at 2 kHz on raw hid and at 4 kHz on serial
+#if defined(USB_SERIAL)
+const int journal_stage_pages = 64;
+#else
+const int journal_stage_pages = 32;
+#endif
+const int journal_record_header = 6;  // (uint8_t) [seq[0-3], imu_count, strobe_count]
+const int journal_record_max = journal_record_header + Report::imu_slots*Report::imu_packet_size +
+  Report::strobe_slots*Report::strobe_packet_size;
+static_assert(journal_record_max <= journal_page_size, "journal record does not fit a page");
+
+extern uint32_t journal_drops;  // data reports the journal could not keep
+
+// the log starts over with the send count, without a journal flash it stays off
+void StartJournal();
+bool JournalEnabled();
+
+// records a data report before it goes to usb, its send count set
+void JournalReport(const uint8_t* buf);
+
+// programs a staged page or erases ahead, never waits
+void ServiceJournal();
+
+// the sequence of a send count within the last 65536 reports
+uint32_t JournalSequence(uint16_t send_count);
+
+// copies the record of seq into record, pending while it is still in ram
+JournalLookup FindJournal(uint32_t seq, uint8_t* record);
+
+// rebuilds the original report from a record
+void ReplayJournal(const uint8_t* record, ReportEncoder* encoder);
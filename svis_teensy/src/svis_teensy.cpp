@@ -2,25 +2,24 @@
 #include "I2Cdev.h"
 #include "MPU6050.h"
 #include "ICM20689.h"
+#if defined(IMU_SPI)
+#include "SPI.h"
+#elif defined(I2CDEV_I2C_T3)
+#include "i2c_t3.h"
+#else
 #include "Wire.h"
+#endif
+#include "svis_core.h"
+#include "svis_imu.h"
 
 // hardware
 #define LED_PIN 13  // pin for on-board led
 #define STROBE_PIN 5  // pin for camera strobe
 #define TRIGGER_PIN 2  // pin for camera trigger
+#define TRIGGER_COMPARE_PIN 6  // ftm0 channel 4, camera trigger driven by output compare
 #define IMU_INT_PIN 20  // pin for imu interrupt
-
-/* packet structure
-[0-1]: send_count
-[2]: imu_count
-[3]: strobe_count
-[4-19]: imu packet 1
-[20-35]: imu packet 2
-[36-51]: imu packet 3
-[52-56]: strobe packet 1
-[57-61]: strobe packet 2
-[62-63]: checksum
-*/
+#define IMU_CS_PIN 10  // spi chip select for the imu
+#define IMU_SCK_PIN 14  // alternate spi clock, pin 13 drives the led
 
 /**
  * FS_SEL | Full Scale Range   | LSB Sensitivity
@@ -38,53 +37,42 @@
  * 3       | +/- 16g          | 2048 LSB/mg
  **/
 
-// hid usb packet sizes
-const int imu_data_size = 8;  // (int16_t) [ts1, ts2, ax, ay, az, gx, gy, gz]
-const int imu_buffer_size = 10;  // store 10 samples (imu_stamp, imu_data) in circular buffers
-const int imu_packet_size = 16;  // (int8_t) [imu_stamp[0], ... , imu_stamp[3], imu_data[0], ... , imu_data[11]]
-const int strobe_buffer_size = 10;  // store 10 samples (strobe_stamp, strobe_count) in circular buffers
-const int strobe_packet_size = 5;  // (int8_t) [strobe_stamp[0], ... , strobe_stamp[3], strobe_count]
-const int send_buffer_size = 64;  // (int8_t) size of HID USB packets
-const int send_header_size = 4;  // (int8_t) [send_count[0], send_count[1], imu_count, strobe_count];
-
-// hid usb packet indices
-const int send_count_index = 0;
-const int imu_count_index = 2;
-const int strobe_count_index = 3;
-const int imu_index[3] = {4, 20, 36};
-const int strobe_index[2] = {52, 57};
-const int checksum_index = 62;
-
-// hid usb
-bool setup_flag = false;
-uint8_t send_buffer[send_buffer_size];
-uint8_t recv_buffer[send_buffer_size];
-uint16_t send_count = 0;
-uint8_t send_errors = 0;
-uint8_t strobe_packet_count = 0;
-uint8_t imu_packet_count = 0;
-
 // imu variables
 IntervalTimer imu_timer;
 MPU6050 mpu6050;
 ICM20689 icm20689;
-int16_t imu_data_buffer[imu_data_size*imu_buffer_size];
-uint8_t imu_buffer_head = 0;
-uint8_t imu_buffer_tail = 0;
-uint8_t imu_buffer_count = 0;
 uint8_t fs_sel = 0;  // gyro range selection
 uint8_t afs_sel = 0;  // accelerometer range selection
 
-// strobe variables
-uint32_t strobe_stamp_buffer[strobe_buffer_size];
-uint8_t strobe_count = 0;
-uint8_t strobe_count_buffer[strobe_buffer_size];
-uint8_t strobe_buffer_head = 0;
-uint8_t strobe_buffer_tail = 0;
-uint8_t strobe_buffer_count = 0;
+#if defined(IMU_SPI)
+#if defined(I2CDEV_I2C_T3)
+#error "IMU_SPI and I2CDEV_I2C_T3 are exclusive"
+#endif
+#if defined(JOURNAL_FLASH) && !defined(IMU_FIFO)
+#error "JOURNAL_FLASH shares spi with the imu, whose timer reads would interrupt the flash, use IMU_FIFO"
+#endif
+// the driver's configuration calls run at 1 MHz, the hal reads samples at 8 MHz
+const uint32_t spi_config_rate = 1000000;
+#endif
+
+// ftm0 input capture
+// ftm0 free runs off the bus clock and latches its count in hardware on a
+// capture edge, overflows extend it to 48 bits, and since the bus clock and
+// micros() share the crystal a capture maps to micros() by a fixed offset, so
+// interrupt latency drops out of the stamps
+const uint32_t ftm_prescale = 4;  // bus clock/16, 3 MHz and wraps every 21.8 ms at 48 MHz
+volatile uint32_t ftm_overflow_count = 0;
+uint32_t ftm_start_stamp = 0;  // micros() when the counter started
+
+#if defined(I2CDEV_I2C_T3)
+// the sample reads run on the dma, see svis_hal_teensy.cpp
+const uint32_t i2c_rate = 1000000;  // fast mode plus, above the icm20689's 400 kHz rating
+#endif
 
 // trigger variables
+#if !defined(TRIGGER_COMPARE)
 IntervalTimer trigger_timer;
+#endif
 bool trigger_flag = false;
 bool triggered_once = true;
 bool pulse_trigger = true;
@@ -93,6 +81,25 @@ float trigger_rate = 60.0;  // Hz
 uint32_t trigger_period = uint32_t(1.0/trigger_rate * 1000000.0);  // microseconds
 uint32_t trigger_duration = 1000;  // microseconds
 
+#if defined(TRIGGER_COMPARE)
+// trigger output compare
+// ftm0 channel 4 sets and clears its pin in hardware when the counter reaches
+// a scheduled edge, so the edges and their stamps land on a counter tick and
+// the isr only runs once per edge, plus once per wrap on waits past a wrap
+const uint32_t ftm_tick_rate = F_BUS >> ftm_prescale;  // Hz
+const uint32_t ftm_min_lead = 32;  // ticks, a late edge is moved this far past now
+enum TriggerState {kTriggerIdle, kTriggerRise, kTriggerFall};
+volatile uint8_t trigger_state = kTriggerIdle;
+uint64_t trigger_edge_tick = 0;  // extended ftm0 count of the pending edge
+uint64_t trigger_rise_tick = 0;  // extended ftm0 count of the last rising edge
+bool trigger_armed = false;  // the pending edge is within a wrap and drives the pin
+#endif
+
+// pulse burst for the offset bootstrap
+uint8_t burst_gaps[protocol::kBurstMaxCount] = {0};  // trigger periods before each pulse
+uint8_t burst_count = 0;
+uint8_t burst_index = 0;
+
 // debug
 elapsedMillis since_print;
 elapsedMillis since_blink;
@@ -102,176 +109,240 @@ bool strobe_debug_flag = false;
 bool send_debug_flag = false;
 
 void PrintIMUDataBuffer() {
-  Serial.println("imu_data_buffer:");
-  Serial.println("Sample:\tAx:\tAy:\tAz:\tGx:\tGy:\tGz:");
-  for (int i = 0; i < imu_buffer_size; i++) {
+  Serial.println("imu_ring:");
+  Serial.println("Sample:\tTs1:\tTs2:\tAx:\tAy:\tAz:\tGx:\tGy:\tGz:");
+  uint32_t count = imu_ring.Count();
+  for (uint32_t i = 0; i < count; i++) {
     Serial.print(i);
     Serial.print(":\t");
     for (int j = 0; j < imu_data_size; j++) {
-      Serial.print(imu_data_buffer[i*imu_data_size + j]);
+      Serial.print(imu_ring.Peek(i).data[j]);
       Serial.print("\t");
     }
-
-    // mark head location
-    if (i == imu_buffer_head) {
-      Serial.print("\tH");
-    }
-
-    // mark tail location
-    if (i == imu_buffer_tail) {
-      Serial.print("\tT");
-    }
-
     Serial.println();
   }
 }
 
 void PrintIMUDebug() {
   PrintIMUDataBuffer();
-  Serial.print("imu_buffer_head: ");
-  Serial.println(imu_buffer_head);
-  Serial.print("imu_buffer_tail: ");
-  Serial.println(imu_buffer_tail);
-  Serial.print("imu_buffer_count: ");
-  Serial.println(imu_buffer_count);
-}
-
-void ReadIMU() {
-  // imu timestamp
-  uint32_t timestamp = micros();
-  memcpy(&imu_data_buffer[imu_buffer_head * imu_data_size], &timestamp, sizeof(uint32_t));
-
-  // imu data
-  // mpu6050.getMotion6(&imu_data_buffer[imu_buffer_head*imu_data_size],
-  //                    &imu_data_buffer[imu_buffer_head*imu_data_size + 1],
-  //                    &imu_data_buffer[imu_buffer_head*imu_data_size + 2],
-  //                    &imu_data_buffer[imu_buffer_head*imu_data_size + 3],
-  //                    &imu_data_buffer[imu_buffer_head*imu_data_size + 4],
-  //                    &imu_data_buffer[imu_buffer_head*imu_data_size + 5]);
-  icm20689.getMotion6(&imu_data_buffer[imu_buffer_head*imu_data_size + 2],
-                      &imu_data_buffer[imu_buffer_head*imu_data_size + 3],
-                      &imu_data_buffer[imu_buffer_head*imu_data_size + 4],
-                      &imu_data_buffer[imu_buffer_head*imu_data_size + 5],
-                      &imu_data_buffer[imu_buffer_head*imu_data_size + 6],
-                      &imu_data_buffer[imu_buffer_head*imu_data_size + 7]);
-
-  // set counts and flags
-  imu_buffer_head = (imu_buffer_head + 1)%imu_buffer_size;
-
-  // check tail
-  if (imu_buffer_head == imu_buffer_tail) {
-    imu_buffer_tail = (imu_buffer_tail + 1)%imu_buffer_size;
-  }
+  Serial.print("imu_ring count: ");
+  Serial.println(imu_ring.Count());
+  Serial.print("imu_ring overflow: ");
+  Serial.println(imu_ring.GetOverflowCount());
+}
 
-  // increment count
-  imu_buffer_count++;
-  if (imu_buffer_count > imu_buffer_size) {
-    imu_buffer_count = imu_buffer_size;
+// extends a ftm0 count read within the last half wrap to 48 bits, call from
+// the ftm0 isr before it counts the overflow or with interrupts off
+uint64_t ExtendTicks(uint16_t count) {
+  // a low count with the overflow still pending came after the overflow
+  uint32_t overflows = ftm_overflow_count;
+  if ((FTM0_SC & FTM_SC_TOF) && count < 0x8000) {
+    overflows++;
   }
 
-  if (imu_debug_flag) {
-    PrintIMUDebug();
-  }
+  return (uint64_t(overflows) << 16) | count;
+}
+
+// micros() at an extended ftm0 count
+uint32_t TicksToMicros(uint64_t ticks) {
+  return ftm_start_stamp + uint32_t((ticks << ftm_prescale)/(F_BUS/1000000));
+}
+
+// micros() at a captured ftm0 count
+uint32_t CaptureToMicros(uint16_t capture) {
+  return TicksToMicros(ExtendTicks(capture));
 }
 
 void PrintStrobeStampBuffer() {
-  Serial.println("strobe_stamp_buffer:");
-  for (int i = 0; i < strobe_buffer_size; i++) {
+  Serial.println("strobe_ring:");
+  uint32_t count = strobe_ring.Count();
+  for (uint32_t i = 0; i < count; i++) {
     Serial.print(i);
     Serial.print(":\t");
-    Serial.print(strobe_stamp_buffer[i]);
-
-    // mark head location
-    if (i == strobe_buffer_head) {
-      Serial.print("\tH");
-    }
-
-    // mark tail location
-    if (i == strobe_buffer_tail) {
-      Serial.print("\tT");
-    }
-
+    Serial.print(strobe_ring.Peek(i).stamp);
+    Serial.print("\t");
+    Serial.print(strobe_ring.Peek(i).count);
     Serial.println();
   }
 }
 
 void PrintStrobeDebug() {
   PrintStrobeStampBuffer();
-  Serial.print("strobe_buffer_head: ");
-  Serial.println(strobe_buffer_head);
-  Serial.print("strobe_buffer_tail: ");
-  Serial.println(strobe_buffer_tail);
-  Serial.print("strobe_buffer_count: ");
-  Serial.println(strobe_buffer_count);
+  Serial.print("strobe_ring count: ");
+  Serial.println(strobe_ring.Count());
+  Serial.print("strobe_ring overflow: ");
+  Serial.println(strobe_ring.GetOverflowCount());
 }
 
-void ReadStrobe() {
-  // strobe timestamp
-  strobe_stamp_buffer[strobe_buffer_head] = micros();
+#if defined(TRIGGER_COMPARE)
+// points channel 4 at trigger_edge_tick, the pin action is only armed once the
+// edge is less than a wrap away, before that matches hold the current level
+void ArmTriggerEdge() {
+  uint64_t now = ExtendTicks(FTM0_CNT);
+  if (trigger_edge_tick < now + ftm_min_lead) {
+    trigger_edge_tick = now + ftm_min_lead;
+  }
 
-  // strobe count
-  strobe_count_buffer[strobe_buffer_head] = strobe_count;
-  strobe_count = (strobe_count + 1);
+  // output compare, elsb clears and elsb|elsa sets the pin on a match
+  bool rise = (trigger_state == kTriggerRise);
+  if (trigger_edge_tick - now < 0x10000) {
+    FTM0_C4V = uint16_t(trigger_edge_tick);
+    FTM0_C4SC = FTM_CSC_MSA | FTM_CSC_ELSB | (rise ? FTM_CSC_ELSA : 0) | FTM_CSC_CHIE;
+    trigger_armed = true;
+  } else {
+    // wake up half a wrap before the edge, some wraps early
+    FTM0_C4V = uint16_t(trigger_edge_tick - 0x8000);
+    FTM0_C4SC = FTM_CSC_MSA | FTM_CSC_ELSB | (rise ? 0 : FTM_CSC_ELSA) | FTM_CSC_CHIE;
+    trigger_armed = false;
+  }
+}
 
-  // set counts and flags
-  strobe_buffer_head = (strobe_buffer_head + 1)%strobe_buffer_size;
+// schedules the next rising edge after the last one, or idles with the pin low
+void ScheduleTrigger() {
+  bool due = false;
+  uint32_t gap = 1;  // trigger periods after the last rising edge
+  if (pulse_trigger && burst_index < burst_count) {
+    due = true;
+    gap = burst_gaps[burst_index];
+    burst_index++;
+  } else if (!pulse_trigger || !triggered_once) {
+    due = true;
+    triggered_once = true;
+  }
 
-  // check tail
-  if (strobe_buffer_head == strobe_buffer_tail) {
-    strobe_buffer_tail = (strobe_buffer_tail + 1)%strobe_buffer_size;
+  if (!due) {
+    trigger_state = kTriggerIdle;
+    trigger_armed = false;
+    FTM0_C4SC = FTM_CSC_MSA | FTM_CSC_ELSB;
+    return;
   }
 
-  // increment count
-  strobe_buffer_count++;
-  if (strobe_buffer_count > strobe_buffer_size) {
-    strobe_buffer_count = strobe_buffer_size;
+  uint32_t period = uint32_t(float(ftm_tick_rate)/trigger_rate);  // ticks
+  trigger_state = kTriggerRise;
+  trigger_edge_tick = trigger_rise_tick + uint64_t(gap)*period;
+  ArmTriggerEdge();
+}
+
+// called by the ftm0 isr on a channel 4 match
+void TriggerEdge() {
+  if (!trigger_armed) {
+    ArmTriggerEdge();
+    return;
   }
 
-  if (strobe_debug_flag) {
-    PrintStrobeDebug();
+  if (trigger_state == kTriggerRise) {
+    // the pin went high in hardware at the compare, mirror it for existing wiring
+    digitalWriteFast(TRIGGER_PIN, HIGH);
+    trigger_rise_tick = trigger_edge_tick;
+#if !defined(STROBE_CAPTURE)
+    ReadStrobe(TicksToMicros(trigger_edge_tick));
+#endif
+
+    trigger_state = kTriggerFall;
+    trigger_edge_tick += uint64_t(trigger_duration)*ftm_tick_rate/1000000;
+    ArmTriggerEdge();
+  } else {
+    digitalWriteFast(TRIGGER_PIN, LOW);
+    ScheduleTrigger();
   }
 }
 
-void SetTrigger() {
-  if ((since_trigger > trigger_period) && !trigger_flag && ((pulse_trigger && !triggered_once) || !pulse_trigger)) {
-    digitalWriteFast(TRIGGER_PIN, HIGH);
-    since_trigger = 0;
-    trigger_flag = true;
-    triggered_once = true;
+// starts a pulse, burst or continuous triggering requested from the main loop
+void StartTrigger() {
+  // requests before setup wait for it
+  if (!setup_flag) {
+    return;
+  }
 
-    // strobe timestamp
-    strobe_stamp_buffer[strobe_buffer_head] = micros();
+  noInterrupts();
+  if (trigger_state == kTriggerIdle) {
+    ScheduleTrigger();
+  }
+  interrupts();
+}
+#endif
+
+extern "C" void ftm0_isr(void) {
+#if defined(IMU_FIFO)
+  // imu data ready
+  if (FTM0_C5SC & FTM_CSC_CHF) {
+    uint16_t capture = FTM0_C5V;
+    FTM0_C5SC &= ~FTM_CSC_CHF;
+    ReadImuDrdy(CaptureToMicros(capture));
+  }
+#endif
+
+#if defined(STROBE_CAPTURE)
+  // camera exposure strobe
+  if (FTM0_C7SC & FTM_CSC_CHF) {
+    uint16_t capture = FTM0_C7V;
+    FTM0_C7SC &= ~FTM_CSC_CHF;
+    ReadStrobe(CaptureToMicros(capture));
+  }
+#endif
 
-    // strobe count
-    strobe_count_buffer[strobe_buffer_head] = strobe_count;
-    strobe_count = (strobe_count + 1);
+#if defined(TRIGGER_COMPARE)
+  // camera trigger edge
+  if (FTM0_C4SC & FTM_CSC_CHF) {
+    FTM0_C4SC &= ~FTM_CSC_CHF;
+    TriggerEdge();
+  }
+#endif
 
-    // set counts and flags
-    strobe_buffer_head = (strobe_buffer_head + 1)%strobe_buffer_size;
+  // count the overflow after the captures that may precede it
+  if (FTM0_SC & FTM_SC_TOF) {
+    FTM0_SC &= ~FTM_SC_TOF;
+    ftm_overflow_count++;
+  }
+}
 
-    // check tail
-    if (strobe_buffer_head == strobe_buffer_tail) {
-      strobe_buffer_tail = (strobe_buffer_tail + 1)%strobe_buffer_size;
-    }
+// called by the usb isr on every start of frame token (1 kHz)
+// pairs the 11 bit usb frame number with the local clock so the host can
+// estimate skew and offset against the shared bus clock
+extern "C" void usb_sof_callback(void) {
+  uint32_t stamp = micros();
+  uint16_t frame = USB0_FRMNUML | ((USB0_FRMNUMH & 0x07) << 8);
 
-    // increment count
-    strobe_buffer_count++;
-    if (strobe_buffer_count > strobe_buffer_size) {
-      strobe_buffer_count = strobe_buffer_size;
-    }
+  // clock reports only go out after setup
+  if (!setup_flag) {
+    return;
+  }
+
+  ReadSof(frame, stamp);
+}
 
-    if (strobe_debug_flag) {
-      PrintStrobeDebug();
+#if !defined(TRIGGER_COMPARE)
+void SetTrigger() {
+  bool burst_due = pulse_trigger && (burst_index < burst_count) &&
+    (since_trigger > burst_gaps[burst_index]*trigger_period);
+  if (!trigger_flag && (burst_due ||
+      ((since_trigger > trigger_period) && ((pulse_trigger && !triggered_once) || !pulse_trigger)))) {
+    digitalWriteFast(TRIGGER_PIN, HIGH);
+    since_trigger = 0;
+    trigger_flag = true;
+    triggered_once = true;
+    if (burst_due) {
+      burst_index++;
     }
+
+#if !defined(STROBE_CAPTURE)
+    ReadStrobe(micros());
+#endif
   } else if ((since_trigger > trigger_duration) && trigger_flag) {
     digitalWriteFast(TRIGGER_PIN, LOW);
     trigger_flag = false;
   }
 }
+#endif
 
 void InitICM20689() {
   // initialize device
+#if defined(IMU_SPI)
+  Serial.println("Initializing SPI devices...");
+  icm20689.switchSPIEnabled(true);  // keep the interface from falling back to i2c
+#else
   Serial.println("Initializing I2C devices...");
+#endif
   icm20689.initialize();
 
   // verify connection
@@ -291,6 +362,10 @@ void InitICM20689() {
   icm20689.setFullScaleAccelRange(afs_sel);
   Serial.println(icm20689.getFullScaleAccelRange());
 
+  Serial.print("DLPF Mode: ");
+  ConfigureImuRate();
+  Serial.println(icm20689.getDLPFMode());
+
   // Serial.print("Interrupt Mode: ");
   // icm20689.setInterruptMode(0);
   // Serial.println(mpu6050.getInterruptMode());
@@ -330,9 +405,22 @@ void InitMPU6050() {
 }
 
 void InitComms() {
+#if defined(IMU_SPI)
+  // initialize spi communication
+  pinMode(IMU_CS_PIN, OUTPUT);
+  digitalWriteFast(IMU_CS_PIN, HIGH);
+  SPI.setSCK(IMU_SCK_PIN);
+  SPI.begin();
+  I2Cdev::spiChipSelect = IMU_CS_PIN;
+  I2Cdev::spiClock = spi_config_rate;
+#elif defined(I2CDEV_I2C_T3)
+  // initialize i2c communication
+  Wire.begin(I2C_MASTER, 0x00, I2C_PINS_18_19, I2C_PULLUP_EXT, i2c_rate, I2C_OP_MODE_DMA);
+#else
   // initialize i2c communication
   Wire.begin();
   Wire.setClock(400000);
+#endif
 
   delay(500);
 }
@@ -346,25 +434,99 @@ void InitGPIO() {
 
 void InitImuTimer() {
   // setup interrupt timers
-  imu_timer.begin(ReadIMU, 1000);  // microseconds
+  imu_timer.begin(ReadImu, imu_period);  // microseconds
   imu_timer.priority(0);  // [0,255] with 0 as highest
 }
 
+void InitCaptureTimer() {
+  // free running 16 bit counter, the core sets ftm0 up for pwm
+  FTM0_SC = 0;
+  FTM0_CNT = 0;
+  FTM0_MOD = 0xFFFF;
+  ftm_overflow_count = 0;
+  noInterrupts();
+  FTM0_SC = FTM_SC_CLKS(1) | FTM_SC_PS(ftm_prescale) | FTM_SC_TOIE;
+  ftm_start_stamp = micros();
+  interrupts();
+  NVIC_SET_PRIORITY(IRQ_FTM0, 0);  // stamp ahead of usb
+  NVIC_ENABLE_IRQ(IRQ_FTM0);
+}
+
 void InitImuInterrupt() {
-  // setup pin interrupt
-  // TODO(jakeware): What is the priority of this?
-  // attachInterrupt(IMU_INT_PIN, ReadIMU, RISING);  // read imu
+  // capture rising edges, pin 20 is ftm0 channel 5 on alt 4
+  FTM0_C5SC = 0;
+  FTM0_C5SC = FTM_CSC_ELSA | FTM_CSC_CHIE;
+  CORE_PIN20_CONFIG = PORT_PCR_MUX(4);
 }
 
+void StopImuInterrupt() {
+  FTM0_C5SC = 0;
+  CORE_PIN20_CONFIG = PORT_PCR_MUX(1);
+}
+
+#if defined(IMU_FIFO)
+void InitImuFifo() {
+  // accel and gyro go to the fifo, data ready pulses the int pin at the odr
+  icm20689.setFIFOEnabled(false);
+  icm20689.setAccelFIFOEnabled(true);
+  icm20689.setXGyroFIFOEnabled(true);
+  icm20689.setYGyroFIFOEnabled(true);
+  icm20689.setZGyroFIFOEnabled(true);
+  I2Cdev::writeByte(ICM20689_DEFAULT_ADDRESS, ICM20689_RA_INT_ENABLE, 1 << ICM20689_DATA_RDY_INT_EN_BIT);
+  icm20689.resetFIFO();
+
+  // the core counts edges from here
+  InitImuInterrupt();
+  icm20689.setFIFOEnabled(true);
+}
+#endif
+
+// called by StartImu(), StopImu() and ConfigureImuRate() in svis_imu.cpp
+void OnImuStart() {
+#if defined(IMU_FIFO)
+  InitImuFifo();
+#else
+  InitImuTimer();
+#endif
+}
+
+void OnImuStop() {
+#if defined(IMU_FIFO)
+  StopImuInterrupt();
+#else
+  imu_timer.end();
+#endif
+}
+
+void OnImuRate(uint8_t dlpf_cfg, bool accel_dlpf_bypass, uint8_t divider) {
+  icm20689.setDLPFMode(dlpf_cfg);
+  I2Cdev::writeBit(ICM20689_DEFAULT_ADDRESS, ICM20689_RA_ACCEL_CONFIG_2, ICM20689_ACONFIG_ACCEL_FCHOICE_B_SET_BIT, accel_dlpf_bypass);
+  icm20689.setRate(divider);
+}
+
+#if defined(TRIGGER_COMPARE)
+void InitTriggerCompare() {
+  // pin 6 is ftm0 channel 4 on alt 4, cleared on matches until the first edge
+  trigger_state = kTriggerIdle;
+  trigger_armed = false;
+  FTM0_C4SC = 0;
+  FTM0_C4V = 0;
+  FTM0_C4SC = FTM_CSC_MSA | FTM_CSC_ELSB;
+  CORE_PIN6_CONFIG = PORT_PCR_MUX(4) | PORT_PCR_DSE | PORT_PCR_SRE;
+}
+#else
 void InitTriggerTimer() {
   trigger_timer.begin(SetTrigger, 100);  // microseconds
   trigger_timer.priority(1);  // [0,255] with 0 as highest
 }
+#endif
 
 void InitStrobeInterrupt() {
-  // setup pin interrupt
-  // TODO(jakeware): What is the priority of this?
-  // attachInterrupt(STROBE_PIN, ReadStrobe, FALLING);  // read camera strobe
+  // capture falling edges, pin 5 is ftm0 channel 7 on alt 4
+  // the internal pullup is not strong enough, the strobe needs an external one
+  FTM0_C7SC = 0;
+  FTM0_C7SC = FTM_CSC_ELSB | FTM_CSC_CHIE;
+  CORE_PIN5_CONFIG = PORT_PCR_MUX(4);
 }
 
 void BlinkInit() {
@@ -444,9 +606,20 @@ void Setup() {
   InitGPIO();
   // InitMPU6050();
   InitICM20689();
-  InitImuTimer();
+  InitCaptureTimer();
+  StartImu();
+#if defined(STROBE_CAPTURE)
+  InitStrobeInterrupt();
+#endif
+#if defined(TRIGGER_COMPARE)
+  InitTriggerCompare();
+#else
   InitTriggerTimer();
+#endif
   setup_flag = true;
+#if defined(TRIGGER_COMPARE)
+  StartTrigger();
+#endif
 }
 
 void PrintSendBuffer() {
@@ -454,218 +627,85 @@ void PrintSendBuffer() {
   for (int i = 0; i < send_buffer_size; i++) {
     Serial.print(i);
     Serial.print("\t");
-    Serial.print(send_buffer[i]);
+    Serial.print(report.data()[i]);
     Serial.println();
   }
 }
 
-void PushIMU() {
-  // interrupt safe copy
-  noInterrupts();
-
-  // calculate number of packets
-  if (imu_buffer_count >= 0 && imu_buffer_count <= 3) {
-    imu_packet_count = imu_buffer_count;
-  } else if (imu_buffer_count > 3) {
-    imu_packet_count = 3;
-  } else {
-    // totally fucked
-    // Serial.println("num_packets < 0");
-    imu_packet_count = 0;
+uint8_t ApplyCommand(uint8_t command, const uint8_t* payload) {
+  // the imu and trigger timers only exist after setup
+  if (!setup_flag) {
+    return protocol::kAckNotSetup;
   }
 
-  // copy data
-  for (int i = 0; i < imu_packet_count; i++) {
-    // copy data
-    memcpy(&send_buffer[imu_index[i]],
-           &imu_data_buffer[imu_buffer_tail*imu_data_size],
-           imu_data_size*sizeof(imu_data_buffer[imu_buffer_tail*imu_data_size]));
-
-    imu_buffer_count--;
-    // check count
-    if (imu_buffer_count < 0) {
-      imu_buffer_count = 0;
-    }
+  bool imu_stopped = false;
 
-    imu_buffer_tail++;
-    // check tail
-    if (imu_buffer_tail >= imu_buffer_size) {
-      imu_buffer_tail = imu_buffer_tail%imu_buffer_size;
+  if (command == protocol::kCommandCameraRate) {
+    uint16_t rate = 0;
+    memcpy(&rate, payload, sizeof(rate));
+    if (rate == 0 || 1000000/rate <= trigger_duration) {
+      return protocol::kAckBadArgument;
     }
-  }
-
-  // enable interrupts
-  interrupts();
-}
-
-void PushStrobe() {
-  // interrupt safe copy
-  noInterrupts();
-
-  // calculate number of packets
-  if (strobe_buffer_count >= 0 && strobe_buffer_count <= 2) {
-    strobe_packet_count = strobe_buffer_count;
-  } else if (strobe_buffer_count > 2) {
-    strobe_packet_count = 2;
-  } else {
-    // totally fucked
-    // Serial.println("num_packets < 0");
-    strobe_packet_count = 0;
-  }
-
-  // copy data
-  for (int i = 0; i < strobe_packet_count; i++) {
-    // copy stamp
-    memcpy(&send_buffer[strobe_index[i]],
-                &strobe_stamp_buffer[strobe_buffer_tail],
-                sizeof(strobe_stamp_buffer[strobe_buffer_tail]));
-
-    // copy count
-    send_buffer[strobe_index[i] + 4] = strobe_count_buffer[strobe_buffer_tail];
-
-    strobe_buffer_count--;
-    // check count
-    if (strobe_buffer_count < 0) {
-      strobe_buffer_count = 0;
+    trigger_rate = float(rate);  // Hz
+    trigger_period = uint32_t(1.0/trigger_rate * 1000000.0);  // microseconds
+  } else if (command == protocol::kCommandImuRange) {
+    if (payload[0] > 3 || payload[1] > 3) {
+      return protocol::kAckBadArgument;
     }
-
-    strobe_buffer_tail++;
-    // check tail
-    if (strobe_buffer_tail >= strobe_buffer_size) {
-      strobe_buffer_tail = strobe_buffer_tail%strobe_buffer_size;
+    // stop sampling while we share the i2c bus with the timer
+    StopImu();
+    imu_stopped = true;
+    fs_sel = payload[0];
+    afs_sel = payload[1];
+    icm20689.setFullScaleGyroRange(fs_sel);
+    icm20689.setFullScaleAccelRange(afs_sel);
+  } else if (command == protocol::kCommandImuRate) {
+    uint16_t rate = 0;
+    memcpy(&rate, payload, sizeof(rate));
+    if (!ImuRateValid(rate, imu_dlpf_mode)) {
+      return protocol::kAckBadArgument;
     }
-  }
-
-  // enable interrupts
-  interrupts();
-}
-
-void TestPushIMU() {
-  uint32_t imu_stamp0 = 1000;
-  memcpy(&send_buffer[imu_index[0]], &imu_stamp0, sizeof(imu_stamp0));
-  int16_t acc0 = 5;
-  memcpy(&send_buffer[imu_index[0] + 4], &acc0, sizeof(acc0));
-  int16_t acc1 = -5;
-  memcpy(&send_buffer[imu_index[0] + 6], &acc1, sizeof(acc1));
-  int16_t acc2 = 0;
-  memcpy(&send_buffer[imu_index[0] + 8], &acc2, sizeof(acc2));
-  int16_t gyro0 = 10;
-  memcpy(&send_buffer[imu_index[0] + 10], &gyro0, sizeof(gyro0));
-  int16_t gyro1 = -10;
-  memcpy(&send_buffer[imu_index[0] + 12], &gyro1, sizeof(gyro1));
-  int16_t gyro2 = 0;
-  memcpy(&send_buffer[imu_index[0] + 14], &gyro2, sizeof(gyro2));
-
-  imu_stamp0 = 2000;
-  memcpy(&send_buffer[imu_index[1]], &imu_stamp0, sizeof(imu_stamp0));
-  acc0 = 50;
-  memcpy(&send_buffer[imu_index[1] + 4], &acc0, sizeof(acc0));
-  acc1 = -50;
-  memcpy(&send_buffer[imu_index[1] + 6], &acc1, sizeof(acc1));
-  acc2 = 1;
-  memcpy(&send_buffer[imu_index[1] + 8], &acc2, sizeof(acc2));
-  gyro0 = 100;
-  memcpy(&send_buffer[imu_index[1] + 10], &gyro0, sizeof(gyro0));
-  gyro1 = -100;
-  memcpy(&send_buffer[imu_index[1] + 12], &gyro1, sizeof(gyro1));
-  gyro2 = 1;
-  memcpy(&send_buffer[imu_index[1] + 14], &gyro2, sizeof(gyro2));
-
-  imu_stamp0 = 3000;
-  memcpy(&send_buffer[imu_index[2]], &imu_stamp0, sizeof(imu_stamp0));
-  acc0 = 500;
-  memcpy(&send_buffer[imu_index[2] + 4], &acc0, sizeof(acc0));
-  acc1 = -500;
-  memcpy(&send_buffer[imu_index[2] + 6], &acc1, sizeof(acc1));
-  acc2 = 2;
-  memcpy(&send_buffer[imu_index[2] + 8], &acc2, sizeof(acc2));
-  gyro0 = 1000;
-  memcpy(&send_buffer[imu_index[2] + 10], &gyro0, sizeof(gyro0));
-  gyro1 = -1000;
-  memcpy(&send_buffer[imu_index[2] + 12], &gyro1, sizeof(gyro1));
-  gyro2 = 2;
-  memcpy(&send_buffer[imu_index[2] + 14], &gyro2, sizeof(gyro2));
-}
-
-void TestPushStrobe() {
-  uint32_t strobe_stamp0 = 4000;
-  memcpy(&send_buffer[strobe_index[0]], &strobe_stamp0, sizeof(strobe_stamp0));
-  uint8_t count = 5;
-  memcpy(&send_buffer[strobe_index[0] + 4], &count, sizeof(count));
-
-  strobe_stamp0 = 5000;
-  memcpy(&send_buffer[strobe_index[1]], &strobe_stamp0, sizeof(strobe_stamp0));
-  count = 10;
-  memcpy(&send_buffer[strobe_index[1] + 4], &count, sizeof(count));
-}
-
-void Send() {
-  // send_count
-  memcpy(&send_buffer[send_count_index], &send_count, sizeof(send_count));
-
-  // data
-  PushIMU();
-  // TestPushIMU();
-  PushStrobe();
-  // TestPushStrobe();
-
-  // packet_counts
-  send_buffer[imu_count_index] = imu_packet_count;
-  send_buffer[strobe_count_index] = strobe_packet_count;
-
-  // checksum
-  uint16_t checksum = 0;
-  for (int i = 0; i < send_buffer_size; i++) {
-    checksum += send_buffer[i];
-  }
-  memcpy(&send_buffer[checksum_index], &checksum, sizeof(checksum));
-
-  // send packet
-  if (RawHID.send(send_buffer, send_buffer_size)) {
-    // blink led
-    if (send_count%10 == 0) {
-      led_state = !led_state;
-      digitalWrite(LED_PIN, led_state);
+    StopImu();
+    imu_stopped = true;
+    imu_period = 1000000/rate;
+    ConfigureImuRate();
+  } else if (command == protocol::kCommandImuDlpf) {
+    // the divider follows the internal rate of the new mode
+    if (payload[0] > 7 || !ImuRateValid(1000000/imu_period, payload[0])) {
+      return protocol::kAckBadArgument;
     }
+    StopImu();
+    imu_stopped = true;
+    imu_dlpf_mode = payload[0];
+    ConfigureImuRate();
+  } else if (command == protocol::kCommandTriggerDuration) {
+    uint32_t duration = 0;
+    memcpy(&duration, payload, sizeof(duration));
+    if (duration == 0 || duration >= trigger_period) {
+      return protocol::kAckBadArgument;
+    }
+    trigger_duration = duration;
   } else {
-    send_errors++;
+    return protocol::kAckBadCommand;
   }
 
-  // debug print
-  if (send_debug_flag) {
-    PrintSendBuffer();
+  // samples stamped at or after this time use the new configuration
+  last_command_stamp = micros();
+  if (imu_stopped) {
+    StartImu();
   }
 
-  // reset
-  send_count++;
-  imu_packet_count = 0;
-  strobe_packet_count = 0;
-  for (int i = 0; i < send_buffer_size; i++) {
-    send_buffer[i] = 0;
-  }
+  return protocol::kAckOk;
 }
 
 void SetParams() {
-  // hid usb
-  setup_flag = false;
-  send_count = 0;
-  send_errors = 0;
-  strobe_packet_count = 0;
-  imu_packet_count = 0;
+  // hid usb, rings and command variables, nothing samples before setup
+  SetCoreParams();
 
   // imu variables
-  imu_buffer_head = 0;
-  imu_buffer_tail = 0;
-  imu_buffer_count = 0;
   fs_sel = recv_buffer[3];
   afs_sel = recv_buffer[4];
 
-  // strobe variables
-  strobe_count = 0;
-  strobe_buffer_head = 0;
-  strobe_buffer_tail = 0;
-  strobe_buffer_count = 0;
-
   // trigger variables
   pulse_trigger = true;
   trigger_flag = false;
@@ -673,6 +713,8 @@ void SetParams() {
   trigger_rate = float(recv_buffer[2]);  // Hz
   trigger_period = uint32_t(1.0/trigger_rate * 1000000.0);  // microseconds
   trigger_duration = 1000;  // microseconds
+  burst_count = 0;
+  burst_index = 0;
 
   // debug
   since_print = 0;
@@ -684,25 +726,20 @@ void SetParams() {
 }
 
 void ResetParams() {
-  // hid usb
-  // setup_flag = false;
-  send_count = 0;
-  send_errors = 0;
-  strobe_packet_count = 0;
-  imu_packet_count = 0;
-
   // imu variables
-  imu_buffer_head = 0;
-  imu_buffer_tail = 0;
-  imu_buffer_count = 0;
-  // fs_sel = recv_buffer[2];  // can't update this on restart
-  // afs_sel = recv_buffer[3];  //  can't update this on restart
-
-  // strobe variables
-  strobe_count = 0;
-  strobe_buffer_head = 0;
-  strobe_buffer_tail = 0;
-  strobe_buffer_count = 0;
+  // the same ranges resume the session, a reconnecting host backfills from it
+  if (recv_buffer[3] == fs_sel && recv_buffer[4] == afs_sel) {
+    ResetCoreParams(true);
+  } else {
+    // stop sampling while we share the i2c bus with the timer
+    StopImu();
+    ResetCoreParams(false);
+    fs_sel = recv_buffer[3];
+    afs_sel = recv_buffer[4];
+    icm20689.setFullScaleGyroRange(fs_sel);
+    icm20689.setFullScaleAccelRange(afs_sel);
+    StartImu();
+  }
 
   // trigger variables
   pulse_trigger = true;
@@ -711,6 +748,8 @@ void ResetParams() {
   trigger_rate = float(recv_buffer[2]);  // Hz
   trigger_period = uint32_t(1.0/trigger_rate * 1000000.0);  // microseconds
   trigger_duration = 1000;  // microseconds
+  burst_count = 0;
+  burst_index = 0;
 
   // debug
   since_print = 0;
@@ -721,63 +760,90 @@ void ResetParams() {
   send_debug_flag = false;
 }
 
-void ProcessPacket(int num) {
-  // received a packet and it is the right length
-  if (num == 64) {
-    uint8_t header[2] = {0};
-    header[0] = recv_buffer[0];
-    header[1] = recv_buffer[1];
-
-    // got setup header packet
-    if (header[0] == 0xAB && header[1] == 0) {
-      // check whether or not we have setup the device
-      if (!setup_flag) {
-        // we have not setup the device and need to configure it
-        BlinkSetup();
-        SetParams();
-        Setup();
-      } else {
-        // reset state if we have already setup the device
-        BlinkReset();
-        ResetParams();
-      }
-    }
+void StartBurst() {
+  uint8_t count = recv_buffer[protocol::kBurstCountIndex];
+  if (count > protocol::kBurstMaxCount) {
+    count = protocol::kBurstMaxCount;
+  }
 
-    // got single trigger packet
-    if (header[0] == 0xAB && header[1] == 2) {
-      triggered_once = false;
-    }
+  // the trigger isr reads the schedule
+  noInterrupts();
+  burst_gaps[0] = 1;
+  for (int i = 1; i < count; i++) {
+    burst_gaps[i] = recv_buffer[protocol::kBurstGapIndex + i - 1];
+  }
+  burst_count = count;
+  burst_index = 0;
+  interrupts();
+}
 
-    // got disable pulse packet
-    if (header[0] == 0xAB && header[1] == 3) {
-      pulse_trigger = false;  // this is true on startup
-    }
+void OnConfigure() {
+  // check whether or not we have setup the device
+  if (!setup_flag) {
+    // we have not setup the device and need to configure it
+    BlinkSetup();
+    SetParams();
+    Setup();
+  } else {
+    // reset state if we have already setup the device
+    BlinkReset();
+    ResetParams();
   }
 }
 
+void OnPulse() {
+  triggered_once = false;
+#if defined(TRIGGER_COMPARE)
+  StartTrigger();
+#endif
+}
+
+void OnDisablePulse() {
+  pulse_trigger = false;  // this is true on startup
+#if defined(TRIGGER_COMPARE)
+  StartTrigger();
+#endif
+}
+
+void OnBurst() {
+  StartBurst();
+#if defined(TRIGGER_COMPARE)
+  StartTrigger();
+#endif
+}
+
 extern "C" int main() {
   Initialize();
 
   // loop while collecting and sending data
-  int num = 0;
   while (true) {
-    num = RawHID.recv(recv_buffer, 0); // 0 timeout = do not wait
-    ProcessPacket(num);
+    // host packets, acks, clock and status reports
+    ServiceHost();
 
-    // send usb data
-    if (imu_buffer_count >= 3) {
-      Send();
-    }
+    // collect imu samples
+    ServiceImu();
+
+    // send usb data and hand queued reports to usb
+    ServiceReports();
 
     // indicate idle
     if (!setup_flag) {
       Heartbeat();
     }
 
-    // debug print statement
+    // debug print statement, kept out of the isrs and the report path
     if (since_print > 1000) {
       since_print = 0;
       // Serial.println("check");
+      if (imu_debug_flag) {
+        PrintIMUDebug();
+      }
+      if (strobe_debug_flag) {
+        PrintStrobeDebug();
+      }
+      if (send_debug_flag) {
+        PrintSendBuffer();
+      }
     }
 
     yield();  // yield() is mandatory!